@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSaveFile>
+
+#include <utility>
+
+#include "activitytotals.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeTotals, "wakatime-totals")
+
+namespace {
+QJsonObject hashToJson(const QHash<QString, qint64> &hash) {
+    QJsonObject object;
+    for (auto it = hash.cbegin(); it != hash.cend(); ++it) {
+        object.insert(it.key(), it.value());
+    }
+    return object;
+}
+
+QHash<QString, qint64> hashFromJson(const QJsonObject &object) {
+    QHash<QString, qint64> hash;
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        hash.insert(it.key(), it.value().toInteger());
+    }
+    return hash;
+}
+} // namespace
+
+ActivityTotals::ActivityTotals(qint64 timeoutMs) : timeoutMs_(timeoutMs) {
+}
+
+QString ActivityTotals::defaultPath() {
+    return QDir::homePath() + QStringLiteral("/.wakatime/kate-wakatime-totals.json");
+}
+
+void ActivityTotals::record(const Heartbeat &heartbeat) {
+    const auto timeMs = heartbeat.timeMs;
+    if (timeMs < lastTimeMs_) {
+        return;
+    }
+    const auto durationMs = timeMs - lastTimeMs_;
+    if (lastTimeMs_ > 0 && durationMs > 0 && durationMs <= timeoutMs_) {
+        durations_.add(lastTimeMs_, timeMs, lastProject_, lastLanguage_);
+        unsaved_.add(lastTimeMs_, timeMs, lastProject_, lastLanguage_);
+    }
+    lastTimeMs_ = timeMs;
+    lastProject_ = heartbeat.project;
+    lastLanguage_ = heartbeat.language;
+    modified_ = true;
+}
+
+void ActivityTotals::Durations::add(qint64 startMs,
+                                     qint64 endMs,
+                                     const QString &project,
+                                     const QString &language) {
+    projects[project] += endMs - startMs;
+    languages[language] += endMs - startMs;
+    total += endMs - startMs;
+    while (startMs < endMs) {
+        const auto date = QDateTime::fromMSecsSinceEpoch(startMs).date();
+        const auto midnight = QDateTime(date.addDays(1), QTime(0, 0)).toMSecsSinceEpoch();
+        // Guards against a time zone transition moving midnight backwards.
+        const auto sliceEndMs = midnight > startMs ? qMin(endMs, midnight) : endMs;
+        days[date.toJulianDay()] += sliceEndMs - startMs;
+        startMs = sliceEndMs;
+    }
+}
+
+void ActivityTotals::Durations::add(const Durations &other) {
+    for (auto it = other.projects.cbegin(); it != other.projects.cend(); ++it) {
+        projects[it.key()] += it.value();
+    }
+    for (auto it = other.languages.cbegin(); it != other.languages.cend(); ++it) {
+        languages[it.key()] += it.value();
+    }
+    for (auto it = other.days.cbegin(); it != other.days.cend(); ++it) {
+        days[it.key()] += it.value();
+    }
+    total += other.total;
+}
+
+qint64 ActivityTotals::project(const QString &project) const {
+    return durations_.projects.value(project);
+}
+
+qint64 ActivityTotals::language(const QString &language) const {
+    return durations_.languages.value(language);
+}
+
+qint64 ActivityTotals::day(QDate date) const {
+    return durations_.days.value(date.toJulianDay());
+}
+
+qint64 ActivityTotals::total() const {
+    return durations_.total;
+}
+
+const QHash<QString, qint64> &ActivityTotals::projects() const {
+    return durations_.projects;
+}
+
+const QHash<QString, qint64> &ActivityTotals::languages() const {
+    return durations_.languages;
+}
+
+qint64 ActivityTotals::timeout() const {
+    return timeoutMs_;
+}
+
+void ActivityTotals::setTimeout(qint64 timeoutMs) {
+    timeoutMs_ = timeoutMs;
+}
+
+bool ActivityTotals::isModified() const {
+    return modified_;
+}
+
+void ActivityTotals::clear() {
+    durations_ = Durations();
+    unsaved_ = Durations();
+    lastTimeMs_ = 0;
+    lastProject_.clear();
+    lastLanguage_.clear();
+    modified_ = true;
+    cleared_ = true;
+}
+
+bool ActivityTotals::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonParseError error;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        qCWarning(gLogWakaTimeTotals) << "Cannot read totals" << path << error.errorString();
+        return false;
+    }
+    const auto object = document.object();
+    durations_ = Durations();
+    durations_.projects = hashFromJson(object.value(QStringLiteral("projects")).toObject());
+    durations_.languages = hashFromJson(object.value(QStringLiteral("languages")).toObject());
+    const auto days = object.value(QStringLiteral("days")).toObject();
+    for (auto it = days.constBegin(); it != days.constEnd(); ++it) {
+        const auto date = QDate::fromString(it.key(), Qt::ISODate);
+        if (date.isValid()) {
+            durations_.days.insert(date.toJulianDay(), it.value().toInteger());
+            durations_.total += it.value().toInteger();
+        }
+    }
+    unsaved_ = Durations();
+    const auto last = object.value(QStringLiteral("last")).toObject();
+    lastTimeMs_ = last.value(QStringLiteral("time")).toInteger();
+    lastProject_ = last.value(QStringLiteral("project")).toString();
+    lastLanguage_ = last.value(QStringLiteral("language")).toString();
+    modified_ = false;
+    cleared_ = false;
+    return true;
+}
+
+bool ActivityTotals::save(const QString &path) {
+    // Another Kate instance may have saved since, so the unsaved time is added to the file's
+    // totals. This instance is only updated once they are written, so a failed save keeps the
+    // unsaved time for the next one.
+    auto saved = *this;
+    ActivityTotals onDisk(timeoutMs_);
+    if (!cleared_ && onDisk.load(path)) {
+        saved.durations_ = std::move(onDisk.durations_);
+        saved.durations_.add(unsaved_);
+    }
+    saved.unsaved_ = Durations();
+    saved.modified_ = false;
+    saved.cleared_ = false;
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(gLogWakaTimeTotals) << "Cannot save totals" << path << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(saved.toJson()).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qCWarning(gLogWakaTimeTotals) << "Cannot save totals" << path << file.errorString();
+        return false;
+    }
+    *this = std::move(saved);
+    return true;
+}
+
+QJsonObject ActivityTotals::toJson() const {
+    QJsonObject days;
+    for (auto it = durations_.days.cbegin(); it != durations_.days.cend(); ++it) {
+        days.insert(QDate::fromJulianDay(it.key()).toString(Qt::ISODate), it.value());
+    }
+    return {
+        {QStringLiteral("projects"), hashToJson(durations_.projects)},
+        {QStringLiteral("languages"), hashToJson(durations_.languages)},
+        {QStringLiteral("days"), days},
+        {QStringLiteral("last"),
+         QJsonObject{
+             {QStringLiteral("time"), lastTimeMs_},
+             {QStringLiteral("project"), lastProject_},
+             {QStringLiteral("language"), lastLanguage_},
+         }},
+    };
+}
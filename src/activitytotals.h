@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDate>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QString>
+
+#include "heartbeat.h"
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeTotals)
+
+/**
+ * Coding time per project, per language and per day, kept up to date from heartbeats as they
+ * happen. Durations are counted the way WakaTime does: the time between two consecutive
+ * heartbeats is added to the project and language of the first one, unless the gap is longer
+ * than the timeout, in which case a new session starts. Only the last heartbeat is kept, so
+ * recording and every query take constant time however long the history is.
+ *
+ * The time recorded since the totals were loaded is also kept apart, so saving adds it to the
+ * file as it is then rather than overwriting what another Kate instance saved in the meantime.
+ */
+class ActivityTotals {
+public:
+    /**
+     * Constructor.
+     *
+     * @param timeoutMs Longest gap in milliseconds between heartbeats of the same session.
+     */
+    explicit ActivityTotals(qint64 timeoutMs);
+    /**
+     * Default location of the saved totals in `~/.wakatime`.
+     *
+     * @return File path.
+     */
+    static QString defaultPath();
+    /**
+     * Add a heartbeat. Heartbeats older than the last one recorded are ignored.
+     *
+     * @param heartbeat Heartbeat. Its project and language may be empty.
+     */
+    void record(const Heartbeat &heartbeat);
+    /**
+     * Get the time spent in a project.
+     *
+     * @param project Project name. Empty for files outside of any project.
+     * @return Time in milliseconds.
+     */
+    qint64 project(const QString &project) const;
+    /**
+     * Get the time spent in a language.
+     *
+     * @param language Language mode.
+     * @return Time in milliseconds.
+     */
+    qint64 language(const QString &language) const;
+    /**
+     * Get the time spent on a day, in local time.
+     *
+     * @param date Day.
+     * @return Time in milliseconds.
+     */
+    qint64 day(QDate date) const;
+    /**
+     * Get the time spent overall.
+     *
+     * @return Time in milliseconds.
+     */
+    qint64 total() const;
+    /**
+     * Get the time spent in each project.
+     *
+     * @return Project name to time in milliseconds.
+     */
+    const QHash<QString, qint64> &projects() const;
+    /**
+     * Get the time spent in each language.
+     *
+     * @return Language mode to time in milliseconds.
+     */
+    const QHash<QString, qint64> &languages() const;
+    /**
+     * Get the session timeout.
+     *
+     * @return Timeout in milliseconds.
+     */
+    qint64 timeout() const;
+    /**
+     * Set the session timeout for heartbeats recorded from now on.
+     *
+     * @param timeoutMs Timeout in milliseconds.
+     */
+    void setTimeout(qint64 timeoutMs);
+    /**
+     * Check if anything was recorded since the totals were last loaded or saved.
+     *
+     * @return `true` if modified.
+     */
+    bool isModified() const;
+    /** Forget all totals and the last heartbeat. */
+    void clear();
+    /**
+     * Replace the totals with those saved in a file. Nothing is changed if the file cannot be read.
+     *
+     * @param path File path.
+     * @return `true` if the file was read.
+     */
+    bool load(const QString &path);
+    /**
+     * Save the totals to a file. The time recorded since the last load() or save() is added to
+     * the totals in the file, which are then used from now on. After clear() the file is replaced
+     * instead.
+     *
+     * @param path File path. The parent directory is created if needed.
+     * @return `true` on success.
+     */
+    bool save(const QString &path);
+    /**
+     * Get the totals as JSON.
+     *
+     * @return JSON object with `projects`, `languages` and `days` objects of times in
+     * milliseconds, `days` keyed by ISO date, and the `last` heartbeat.
+     */
+    QJsonObject toJson() const;
+
+private:
+    struct Durations {
+        QHash<QString, qint64> projects;
+        QHash<QString, qint64> languages;
+        // Julian day number to time.
+        QHash<qint64, qint64> days;
+        qint64 total = 0;
+
+        /** Add the time between @p startMs and @p endMs. */
+        void add(qint64 startMs, qint64 endMs, const QString &project, const QString &language);
+        /** Add all of @p other. */
+        void add(const Durations &other);
+    };
+
+    qint64 timeoutMs_;
+    Durations durations_;
+    // Recorded since the last load() or save().
+    Durations unsaved_;
+    // Last heartbeat, the start of the next duration.
+    qint64 lastTimeMs_ = 0;
+    QString lastProject_;
+    QString lastLanguage_;
+    bool modified_ = false;
+    // The file is replaced rather than added to by the next save().
+    bool cleared_ = false;
+};
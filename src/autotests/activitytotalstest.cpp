@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+
+#include "activitytotals.h"
+
+constexpr qint64 kMinuteMs = 60 * 1000;
+constexpr qint64 kTimeoutMs = 15 * kMinuteMs;
+
+class ActivityTotalsTest : public QObject {
+    Q_OBJECT
+
+public:
+    ActivityTotalsTest(QObject *parent = nullptr);
+    ~ActivityTotalsTest() override;
+
+private Q_SLOTS:
+    void testSession();
+    void testTimeout();
+    void testAttributedToPreviousHeartbeat();
+    void testOutOfOrderIgnored();
+    void testSplitAtMidnight();
+    void testSaveLoad();
+    void testSaveMerges();
+    void testLoadMissing();
+    void testClear();
+
+private:
+    /**
+     * Create a heartbeat.
+     *
+     * @param timeMs Time in milliseconds since the epoch.
+     * @param project Project name.
+     * @param language Language mode.
+     * @return The heartbeat.
+     */
+    Heartbeat heartbeat(qint64 timeMs,
+                        const QString &project = QStringLiteral("project"),
+                        const QString &language = QStringLiteral("C++"));
+
+    // Noon local time, so that sessions do not cross midnight unless intended.
+    const qint64 noonMs = QDateTime(QDate(2026, 3, 10), QTime(12, 0)).toMSecsSinceEpoch();
+};
+
+ActivityTotalsTest::ActivityTotalsTest(QObject *parent) : QObject(parent) {
+}
+
+ActivityTotalsTest::~ActivityTotalsTest() {
+}
+
+Heartbeat ActivityTotalsTest::heartbeat(qint64 timeMs,
+                                        const QString &project,
+                                        const QString &language) {
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/project/main.cpp");
+    heartbeat.project = project;
+    heartbeat.language = language;
+    heartbeat.timeMs = timeMs;
+    return heartbeat;
+}
+
+void ActivityTotalsTest::testSession() {
+    ActivityTotals totals(kTimeoutMs);
+    // A single heartbeat is not time spent.
+    totals.record(heartbeat(noonMs));
+    QCOMPARE(totals.total(), 0);
+    totals.record(heartbeat(noonMs + 2 * kMinuteMs));
+    totals.record(heartbeat(noonMs + 5 * kMinuteMs));
+    QCOMPARE(totals.total(), 5 * kMinuteMs);
+    QCOMPARE(totals.project(QStringLiteral("project")), 5 * kMinuteMs);
+    QCOMPARE(totals.language(QStringLiteral("C++")), 5 * kMinuteMs);
+    QCOMPARE(totals.day(QDate(2026, 3, 10)), 5 * kMinuteMs);
+    QCOMPARE(totals.day(QDate(2026, 3, 11)), 0);
+    QVERIFY(totals.isModified());
+}
+
+void ActivityTotalsTest::testTimeout() {
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs));
+    totals.record(heartbeat(noonMs + kTimeoutMs));
+    QCOMPARE(totals.total(), kTimeoutMs);
+    // A longer gap starts a new session and is not counted.
+    totals.record(heartbeat(noonMs + 2 * kTimeoutMs + 1));
+    QCOMPARE(totals.total(), kTimeoutMs);
+    totals.record(heartbeat(noonMs + 2 * kTimeoutMs + 1 + kMinuteMs));
+    QCOMPARE(totals.total(), kTimeoutMs + kMinuteMs);
+    totals.setTimeout(kMinuteMs);
+    QCOMPARE(totals.timeout(), kMinuteMs);
+}
+
+void ActivityTotalsTest::testAttributedToPreviousHeartbeat() {
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs, QStringLiteral("a"), QStringLiteral("C++")));
+    totals.record(heartbeat(noonMs + kMinuteMs, QStringLiteral("b"), QStringLiteral("Python")));
+    totals.record(heartbeat(noonMs + 3 * kMinuteMs, QStringLiteral("a"), QStringLiteral("C++")));
+    QCOMPARE(totals.project(QStringLiteral("a")), kMinuteMs);
+    QCOMPARE(totals.project(QStringLiteral("b")), 2 * kMinuteMs);
+    QCOMPARE(totals.language(QStringLiteral("C++")), kMinuteMs);
+    QCOMPARE(totals.language(QStringLiteral("Python")), 2 * kMinuteMs);
+    QCOMPARE(totals.projects().size(), 2);
+    QCOMPARE(totals.languages().size(), 2);
+}
+
+void ActivityTotalsTest::testOutOfOrderIgnored() {
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs + kMinuteMs));
+    totals.record(heartbeat(noonMs));
+    QCOMPARE(totals.total(), 0);
+    totals.record(heartbeat(noonMs + 2 * kMinuteMs));
+    QCOMPARE(totals.total(), kMinuteMs);
+}
+
+void ActivityTotalsTest::testSplitAtMidnight() {
+    ActivityTotals totals(kTimeoutMs);
+    const auto midnightMs = QDateTime(QDate(2026, 3, 11), QTime(0, 0)).toMSecsSinceEpoch();
+    totals.record(heartbeat(midnightMs - 4 * kMinuteMs));
+    totals.record(heartbeat(midnightMs + 6 * kMinuteMs));
+    QCOMPARE(totals.day(QDate(2026, 3, 10)), 4 * kMinuteMs);
+    QCOMPARE(totals.day(QDate(2026, 3, 11)), 6 * kMinuteMs);
+    QCOMPARE(totals.total(), 10 * kMinuteMs);
+}
+
+void ActivityTotalsTest::testSaveLoad() {
+    QTemporaryDir tempDir;
+    const auto path = tempDir.filePath(QStringLiteral("sub/totals.json"));
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs, QStringLiteral("a"), QStringLiteral("C++")));
+    totals.record(heartbeat(noonMs + kMinuteMs, QStringLiteral("b"), QStringLiteral("Python")));
+    QVERIFY(totals.save(path));
+    QVERIFY(!totals.isModified());
+
+    ActivityTotals loaded(kTimeoutMs);
+    QVERIFY(loaded.load(path));
+    QVERIFY(!loaded.isModified());
+    QCOMPARE(loaded.toJson(), totals.toJson());
+    QCOMPARE(loaded.total(), kMinuteMs);
+    QCOMPARE(loaded.day(QDate(2026, 3, 10)), kMinuteMs);
+    // The session continues from the last saved heartbeat.
+    loaded.record(heartbeat(noonMs + 2 * kMinuteMs));
+    QCOMPARE(loaded.project(QStringLiteral("b")), kMinuteMs);
+    QCOMPARE(loaded.total(), 2 * kMinuteMs);
+}
+
+void ActivityTotalsTest::testSaveMerges() {
+    QTemporaryDir tempDir;
+    const auto path = tempDir.filePath(QStringLiteral("totals.json"));
+    // Two Kate instances saving to the same file.
+    ActivityTotals first(kTimeoutMs);
+    ActivityTotals second(kTimeoutMs);
+    first.record(heartbeat(noonMs, QStringLiteral("a")));
+    first.record(heartbeat(noonMs + kMinuteMs, QStringLiteral("a")));
+    second.record(heartbeat(noonMs, QStringLiteral("b")));
+    second.record(heartbeat(noonMs + 2 * kMinuteMs, QStringLiteral("b")));
+    QVERIFY(first.save(path));
+    QVERIFY(second.save(path));
+    QCOMPARE(second.total(), 3 * kMinuteMs);
+    QCOMPARE(second.project(QStringLiteral("a")), kMinuteMs);
+    // Time already saved is not added again.
+    first.record(heartbeat(noonMs + 3 * kMinuteMs, QStringLiteral("a")));
+    QVERIFY(first.save(path));
+    ActivityTotals loaded(kTimeoutMs);
+    QVERIFY(loaded.load(path));
+    QCOMPARE(loaded.total(), 5 * kMinuteMs);
+    QCOMPARE(loaded.project(QStringLiteral("a")), 3 * kMinuteMs);
+    QCOMPARE(loaded.day(QDate(2026, 3, 10)), 5 * kMinuteMs);
+
+    // Cleared totals replace the file.
+    loaded.clear();
+    QVERIFY(loaded.save(path));
+    QVERIFY(loaded.load(path));
+    QCOMPARE(loaded.total(), 0);
+}
+
+void ActivityTotalsTest::testLoadMissing() {
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs));
+    totals.record(heartbeat(noonMs + kMinuteMs));
+    QVERIFY(!totals.load(QStringLiteral("/non/existent/totals.json")));
+    QCOMPARE(totals.total(), kMinuteMs);
+}
+
+void ActivityTotalsTest::testClear() {
+    ActivityTotals totals(kTimeoutMs);
+    totals.record(heartbeat(noonMs));
+    totals.record(heartbeat(noonMs + kMinuteMs));
+    totals.clear();
+    QCOMPARE(totals.total(), 0);
+    QVERIFY(totals.projects().isEmpty());
+    QCOMPARE(totals.day(QDate(2026, 3, 10)), 0);
+    // The last heartbeat is forgotten too.
+    totals.record(heartbeat(noonMs + 2 * kMinuteMs));
+    QCOMPARE(totals.total(), 0);
+}
+
+QTEST_MAIN(ActivityTotalsTest)
+
+#include "activitytotalstest.moc"
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+
+#include "branchresolver.h"
+
+class BranchResolverTest : public QObject {
+    Q_OBJECT
+
+public:
+    BranchResolverTest(QObject *parent = nullptr);
+    ~BranchResolverTest() override;
+
+private Q_SLOTS:
+    void testBranch();
+    void testDetached();
+    void testNotGit();
+    void testCachedUntilHeadChanges();
+    void testWorktree();
+    void testSubmodule();
+    void testInvalidate();
+
+private:
+    /**
+     * Write a file, creating its directory, with a modification time @p ageSecs in the past. An
+     * older first version makes a rewrite visible whatever the file system time resolution.
+     *
+     * @param path File path.
+     * @param contents File contents.
+     * @param ageSecs Age of the file.
+     */
+    void writeFile(const QString &path, const QByteArray &contents, int ageSecs = 0);
+
+    QTemporaryDir tempDir;
+};
+
+BranchResolverTest::BranchResolverTest(QObject *parent) : QObject(parent) {
+}
+
+BranchResolverTest::~BranchResolverTest() {
+}
+
+void BranchResolverTest::writeFile(const QString &path, const QByteArray &contents, int ageSecs) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(contents);
+    QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(-ageSecs),
+                             QFileDevice::FileModificationTime));
+}
+
+void BranchResolverTest::testBranch() {
+    const auto root = tempDir.filePath(QStringLiteral("branch"));
+    writeFile(root + QStringLiteral("/.git/HEAD"), "ref: refs/heads/feature/login\n");
+    BranchResolver resolver;
+    QCOMPARE(resolver.branch(root), QStringLiteral("feature/login"));
+    QVERIFY(resolver.branch(QString()).isEmpty());
+}
+
+void BranchResolverTest::testDetached() {
+    const auto root = tempDir.filePath(QStringLiteral("detached"));
+    writeFile(root + QStringLiteral("/.git/HEAD"), "3f786850e387550fdab836ed7e6dc881de23001b\n");
+    BranchResolver resolver;
+    QVERIFY(resolver.branch(root).isEmpty());
+}
+
+void BranchResolverTest::testNotGit() {
+    const auto root = tempDir.filePath(QStringLiteral("hg"));
+    QDir().mkpath(root + QStringLiteral("/.hg"));
+    BranchResolver resolver;
+    QVERIFY(resolver.branch(root).isEmpty());
+    QVERIFY(resolver.branch(root).isEmpty());
+    QCOMPARE(resolver.stats().misses, 1U);
+    QCOMPARE(resolver.stats().hits, 1U);
+}
+
+void BranchResolverTest::testCachedUntilHeadChanges() {
+    const auto root = tempDir.filePath(QStringLiteral("cached"));
+    const auto head = root + QStringLiteral("/.git/HEAD");
+    writeFile(head, "ref: refs/heads/main\n", 60);
+    BranchResolver resolver;
+    QCOMPARE(resolver.branch(root), QStringLiteral("main"));
+    QCOMPARE(resolver.branch(root), QStringLiteral("main"));
+    auto stats = resolver.stats();
+    QCOMPARE(stats.misses, 1U);
+    QCOMPARE(stats.hits, 1U);
+    QCOMPARE(stats.entries, 1);
+
+    writeFile(head, "ref: refs/heads/next\n");
+    QCOMPARE(resolver.branch(root), QStringLiteral("next"));
+    QCOMPARE(resolver.stats().misses, 2U);
+
+    resolver.resetStats();
+    QCOMPARE(resolver.stats().misses, 0U);
+    QCOMPARE(resolver.stats().entries, 1);
+    resolver.clear();
+    QCOMPARE(resolver.stats().entries, 0);
+}
+
+void BranchResolverTest::testWorktree() {
+    const auto gitDir = tempDir.filePath(QStringLiteral("main/.git/worktrees/topic"));
+    writeFile(gitDir + QStringLiteral("/HEAD"), "ref: refs/heads/topic\n", 60);
+    const auto root = tempDir.filePath(QStringLiteral("topic"));
+    writeFile(root + QStringLiteral("/.git"), "gitdir: " + gitDir.toUtf8() + '\n');
+    BranchResolver resolver;
+    QCOMPARE(resolver.branch(root), QStringLiteral("topic"));
+
+    // The HEAD of the worktree is watched, not the .git file.
+    writeFile(gitDir + QStringLiteral("/HEAD"), "ref: refs/heads/topic-2\n");
+    QCOMPARE(resolver.branch(root), QStringLiteral("topic-2"));
+}
+
+void BranchResolverTest::testSubmodule() {
+    const auto super = tempDir.filePath(QStringLiteral("super"));
+    writeFile(super + QStringLiteral("/.git/modules/lib/HEAD"), "ref: refs/heads/stable\n");
+    const auto root = super + QStringLiteral("/lib");
+    writeFile(root + QStringLiteral("/.git"), "gitdir: ../.git/modules/lib\n");
+    BranchResolver resolver;
+    QCOMPARE(resolver.branch(root), QStringLiteral("stable"));
+    QVERIFY(resolver.branch(super).isEmpty());
+}
+
+void BranchResolverTest::testInvalidate() {
+    const auto parent = tempDir.filePath(QStringLiteral("invalidate"));
+    const auto root = parent + QStringLiteral("/project");
+    QDir().mkpath(root);
+    BranchResolver resolver;
+    QVERIFY(resolver.branch(root).isEmpty());
+
+    // A repository created later is only found once its root is invalidated.
+    writeFile(root + QStringLiteral("/.git/HEAD"), "ref: refs/heads/main\n");
+    QVERIFY(resolver.branch(root).isEmpty());
+    resolver.invalidate(tempDir.filePath(QStringLiteral("invalid")));
+    QCOMPARE(resolver.stats().entries, 1);
+    resolver.invalidate(parent);
+    QCOMPARE(resolver.stats().entries, 0);
+    QCOMPARE(resolver.branch(root), QStringLiteral("main"));
+}
+
+QTEST_MAIN(BranchResolverTest)
+
+#include "branchresolvertest.moc"
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include "circuitbreaker.h"
+
+class CircuitBreakerTest : public QObject {
+    Q_OBJECT
+
+public:
+    CircuitBreakerTest(QObject *parent = nullptr);
+    ~CircuitBreakerTest() override;
+
+private Q_SLOTS:
+    void testOpensAfterThreshold();
+    void testSuccessResetsFailures();
+    void testSingleProbe();
+    void testProbeFailureDoublesDelay();
+    void testMaxDelay();
+    void testJitter();
+    void testLateFailureWhileOpen();
+};
+
+CircuitBreakerTest::CircuitBreakerTest(QObject *parent) : QObject(parent) {
+}
+
+CircuitBreakerTest::~CircuitBreakerTest() {
+}
+
+void CircuitBreakerTest::testOpensAfterThreshold() {
+    CircuitBreaker breaker(3, 1000, 10000);
+    breaker.setJitter(0);
+    QVERIFY(breaker.allowRequest(0));
+    breaker.recordFailure(0);
+    breaker.recordFailure(0);
+    QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+    QVERIFY(breaker.allowRequest(0));
+    breaker.recordFailure(0);
+    QCOMPARE(breaker.state(), CircuitBreaker::Open);
+    QCOMPARE(breaker.consecutiveFailures(), 3);
+    QCOMPARE(breaker.retryAt(), 1000);
+    QVERIFY(!breaker.allowRequest(999));
+}
+
+void CircuitBreakerTest::testSuccessResetsFailures() {
+    CircuitBreaker breaker(2, 1000, 10000);
+    breaker.recordFailure(0);
+    breaker.recordSuccess();
+    breaker.recordFailure(0);
+    QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+    QCOMPARE(breaker.consecutiveFailures(), 1);
+}
+
+void CircuitBreakerTest::testSingleProbe() {
+    CircuitBreaker breaker(1, 1000, 10000);
+    breaker.setJitter(0);
+    breaker.recordFailure(0);
+    QVERIFY(breaker.allowRequest(1000));
+    QCOMPARE(breaker.state(), CircuitBreaker::HalfOpen);
+    // Only one probe at a time.
+    QVERIFY(!breaker.allowRequest(1000));
+    breaker.recordSuccess();
+    QCOMPARE(breaker.state(), CircuitBreaker::Closed);
+    QVERIFY(breaker.allowRequest(1000));
+}
+
+void CircuitBreakerTest::testProbeFailureDoublesDelay() {
+    CircuitBreaker breaker(2, 1000, 10000);
+    breaker.setJitter(0);
+    breaker.recordFailure(0);
+    breaker.recordFailure(0);
+    QCOMPARE(breaker.retryAt(), 1000);
+    QVERIFY(breaker.allowRequest(1000));
+    // A failed probe opens the breaker straight away.
+    breaker.recordFailure(1000);
+    QCOMPARE(breaker.state(), CircuitBreaker::Open);
+    QCOMPARE(breaker.retryAt(), 3000);
+    QVERIFY(breaker.allowRequest(3000));
+    breaker.recordFailure(3000);
+    QCOMPARE(breaker.retryAt(), 7000);
+    // Back to the base delay after a success.
+    QVERIFY(breaker.allowRequest(7000));
+    breaker.recordSuccess();
+    breaker.recordFailure(7000);
+    breaker.recordFailure(7000);
+    QCOMPARE(breaker.retryAt(), 8000);
+}
+
+void CircuitBreakerTest::testMaxDelay() {
+    CircuitBreaker breaker(1, 1000, 2500);
+    breaker.setJitter(0);
+    qint64 nowMs = 0;
+    for (int i = 0; i < 40; ++i) {
+        breaker.recordFailure(nowMs);
+        QVERIFY(breaker.retryAt() - nowMs <= 2500);
+        nowMs = breaker.retryAt();
+        QVERIFY(breaker.allowRequest(nowMs));
+    }
+    breaker.recordFailure(nowMs);
+    QCOMPARE(breaker.retryAt() - nowMs, 2500);
+}
+
+void CircuitBreakerTest::testJitter() {
+    CircuitBreaker breaker(1, 1000, 10000);
+    breaker.setJitter(0.5);
+    breaker.recordFailure(0);
+    QVERIFY(breaker.retryAt() >= 500);
+    QVERIFY(breaker.retryAt() <= 1000);
+}
+
+void CircuitBreakerTest::testLateFailureWhileOpen() {
+    CircuitBreaker breaker(1, 1000, 10000);
+    breaker.setJitter(0);
+    breaker.recordFailure(0);
+    // A request started before the breaker opened fails later.
+    breaker.recordFailure(500);
+    QCOMPARE(breaker.retryAt(), 1000);
+    QCOMPARE(breaker.consecutiveFailures(), 2);
+}
+
+QTEST_MAIN(CircuitBreakerTest)
+
+#include "circuitbreakertest.moc"
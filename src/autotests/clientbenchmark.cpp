@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+
+#include "wakatime.h"
+
+/**
+ * Benchmarks for the per-keystroke cost of the client. Run with `-o results.xml,xml` or
+ * `-o results.csv,csv` for machine-readable results; the test target writes XML next to the
+ * binary.
+ */
+class WakaTimeClientBenchmark : public QObject {
+    Q_OBJECT
+
+public:
+    WakaTimeClientBenchmark(QObject *parent = nullptr);
+    ~WakaTimeClientBenchmark() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkGetBinPathCached();
+    void benchmarkGetBinPathUncached();
+    void benchmarkGetProjectDirectoryCached_data();
+    void benchmarkGetProjectDirectoryCached();
+    void benchmarkGetProjectDirectoryUncached_data();
+    void benchmarkGetProjectDirectoryUncached();
+    void benchmarkSendThrottled();
+    void benchmarkSendUnthrottled();
+
+private:
+    /**
+     * Create a project with a file nested @p depth directories below its root.
+     *
+     * @return The file.
+     */
+    QFileInfo createDeepTree(int depth);
+
+    QTemporaryDir tempDir;
+    QByteArray oldHome;
+    QByteArray oldPath;
+};
+
+WakaTimeClientBenchmark::WakaTimeClientBenchmark(QObject *parent)
+    : QObject(parent), oldHome(qgetenv("HOME")), oldPath(qgetenv("PATH")) {
+}
+
+WakaTimeClientBenchmark::~WakaTimeClientBenchmark() {
+}
+
+void WakaTimeClientBenchmark::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    QDir root(tempDir.path());
+    // A few directories without the binary so the uncached lookup has to search.
+    QStringList path;
+    for (const auto &name :
+         {QStringLiteral("bin1"), QStringLiteral("bin2"), QStringLiteral("cli")}) {
+        root.mkdir(name);
+        path << root.filePath(name);
+    }
+    QFile cli(root.filePath(QStringLiteral("cli/wakatime")));
+    QVERIFY(cli.open(QIODevice::WriteOnly));
+    cli.write("#!/bin/sh\nexit 0\n");
+    cli.close();
+    cli.setPermissions(QFileDevice::ExeUser | QFileDevice::ReadUser | QFileDevice::WriteUser);
+    qputenv("HOME", tempDir.path().toUtf8());
+    qputenv("PATH", path.join(QLatin1Char(':')).toUtf8());
+}
+
+void WakaTimeClientBenchmark::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+    qputenv("PATH", oldPath);
+}
+
+QFileInfo WakaTimeClientBenchmark::createDeepTree(int depth) {
+    QDir root(tempDir.path());
+    const auto project = QStringLiteral("project-%1").arg(depth);
+    root.mkpath(project + QStringLiteral("/.git"));
+    auto directory = project;
+    for (auto i = 0; i < depth; i++) {
+        directory += QStringLiteral("/d");
+    }
+    root.mkpath(directory);
+    QFile file(root.filePath(directory + QStringLiteral("/file.cpp")));
+    file.open(QIODevice::WriteOnly);
+    file.close();
+    return QFileInfo(file.fileName());
+}
+
+void WakaTimeClientBenchmark::benchmarkGetBinPathCached() {
+    WakaTime wakatime;
+    const QStringList names{QStringLiteral("wakatime-cli"), QStringLiteral("wakatime")};
+    QVERIFY(!wakatime.getBinPath(names).isEmpty());
+    QBENCHMARK {
+        wakatime.getBinPath(names);
+    }
+}
+
+void WakaTimeClientBenchmark::benchmarkGetBinPathUncached() {
+    WakaTime wakatime;
+    const QStringList names{QStringLiteral("wakatime-cli"), QStringLiteral("wakatime")};
+    QBENCHMARK {
+        wakatime.binPathCache.clear();
+        wakatime.binPathDirectories.clear();
+        wakatime.getBinPath(names);
+    }
+}
+
+void WakaTimeClientBenchmark::benchmarkGetProjectDirectoryCached_data() {
+    QTest::addColumn<int>("depth");
+    QTest::newRow("depth 4") << 4;
+    QTest::newRow("depth 16") << 16;
+    QTest::newRow("depth 64") << 64;
+}
+
+void WakaTimeClientBenchmark::benchmarkGetProjectDirectoryCached() {
+    QFETCH(int, depth);
+    const auto fileInfo = createDeepTree(depth);
+    WakaTime wakatime;
+    QVERIFY(!wakatime.getProjectDirectory(fileInfo).isEmpty());
+    QBENCHMARK {
+        wakatime.getProjectDirectory(fileInfo);
+    }
+}
+
+void WakaTimeClientBenchmark::benchmarkGetProjectDirectoryUncached_data() {
+    benchmarkGetProjectDirectoryCached_data();
+}
+
+void WakaTimeClientBenchmark::benchmarkGetProjectDirectoryUncached() {
+    QFETCH(int, depth);
+    const auto fileInfo = createDeepTree(depth);
+    WakaTime wakatime;
+    QBENCHMARK {
+        wakatime.projectResolver.clear();
+        wakatime.getProjectDirectory(fileInfo);
+    }
+}
+
+void WakaTimeClientBenchmark::benchmarkSendThrottled() {
+    const auto fileInfo = createDeepTree(8);
+    WakaTime wakatime;
+    QCOMPARE(wakatime.send(fileInfo.filePath(), QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::SentSuccessfully);
+    // The common case: a keystroke shortly after the last heartbeat for the same file.
+    QBENCHMARK {
+        wakatime.send(fileInfo.filePath(), QStringLiteral("cpp"), 1, 1, 1, false);
+    }
+}
+
+void WakaTimeClientBenchmark::benchmarkSendUnthrottled() {
+    const auto fileInfo = createDeepTree(8);
+    WakaTime wakatime;
+    // Write events are never throttled so each iteration runs the stub wakatime-cli.
+    QBENCHMARK {
+        wakatime.send(fileInfo.filePath(), QStringLiteral("cpp"), 1, 1, 1, true);
+    }
+}
+
+QTEST_MAIN(WakaTimeClientBenchmark)
+
+#include "clientbenchmark.moc"
@@ -1,13 +1,35 @@
 // SPDX-License-Identifier: MIT
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QSignalSpy>
 #include <QtTest/QTest>
 
+#include <memory>
+#include <utility>
+
 #include "wakatime.h"
 
 Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeClientTest)
 Q_LOGGING_CATEGORY(gLogWakaTimeClientTest, "wakatime-config-test")
 
+/** Delivers the first batch and fails the rest, to stop a replay part way through. */
+class PartialTransport : public RecordingTransport {
+public:
+    void start(const QList<Heartbeat> &heartbeats,
+               std::function<void(Result)> onFinished) override {
+        if (!batches().isEmpty()) {
+            setResult(Failed);
+        }
+        RecordingTransport::start(heartbeats, std::move(onFinished));
+    }
+};
+
 class WakaTimeClientTest : public QObject {
     Q_OBJECT
 
@@ -16,29 +38,106 @@ public:
     ~WakaTimeClientTest() override;
 
 private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
     void testGetBinPathNotFound();
     void testGetBinPathFound();
+    void testGetBinPathInvalidated();
+    void testGetBinPathUnrelatedChange();
     void testGetProjectDirectoryNotFound();
     void testGetProjectDirectoryFound();
+    void testGetProjectDirectoryCached();
+    void testGetProjectDirectoryCachedMiss();
+    void testGetProjectDirectoryInvalidated();
+    void testGetProjectDirectoryKeptOnSave();
+    void testGetProjectDirectoryWatchLimit();
+    void testGetProjectDirectoryMarkers_data();
+    void testGetProjectDirectoryMarkers();
+    void testGetProjectDirectoryProjectFile();
+    void testCanonicalFilePathCached();
     void testSendWakaTimeCliNotInPath();
+    void testSendWakaTimeCliNotInPathJournalled();
     void testSendEmptyFilePath();
     void testSendSuccessful();
     void testSendErrorSending();
     void testSendTooSoon();
+    void testSendTooSoonPerFile();
+    void testSendAsyncSuccessful();
+    void testSendAsyncErrorSending();
+    void testSendOffline();
+    void testSendAsyncInFlight();
+    void testSendAsyncWakaTimeCliNotInPath();
+    void testSendTimedOut();
+    void testSendAsyncTimedOut();
+    void testCircuitBreaker();
+    void testCircuitBreakerProbeQueued();
+    void testQueueHeartbeatBatchSize();
+    void testQueueHeartbeatFlushInterval();
+    void testQueueHeartbeatPending();
+    void testQueueHeartbeatBackpressure();
+    void testJournalReplay();
+    void testJournalCliNotInPath();
+    void testJournalCompactsTornLine();
+    void testJournalMaxEntries();
+    void testJournalDiscardAfterCompaction();
+    void testJournalReplayOffset();
+    void testJournalReplayAfterRestart();
+    void testJournalShared();
+    void testReplayStoppedOnShutdown();
+    void testMetrics();
+    void testMetricsDump();
+    void testActivityTotals();
+    void testActivityTotalsAccepted();
+    void testTransport();
+    void testTransportUnavailable();
+    void testTransportFromEnvironment_data();
+    void testTransportFromEnvironment();
+    void testTransportJournal();
+    void testSendBranch();
 
 private:
-    char *oldHome;
+    /**
+     * Write a stub `wakatime` script into the test directory and point `PATH` at it. `HOME` is set
+     * to the test directory with an empty `.wakatime` directory.
+     *
+     * @param body Shell script body, without the shebang line.
+     * @return The test directory.
+     */
+    QDir createStubCli(const QByteArray &body);
+    /**
+     * Create an empty file.
+     *
+     * @param dir Directory to create the file in.
+     * @param name File name.
+     * @return The full path of the file.
+     */
+    QString createFile(const QDir &dir, const QString &name);
+
+    // Every test runs with HOME here so the user's journal and totals are never touched.
+    QTemporaryDir homeDir;
+    QByteArray testHome;
+    QByteArray oldHome;
     char *oldPath;
 };
 
 WakaTimeClientTest::WakaTimeClientTest(QObject *parent)
-    : QObject(parent), oldHome(getenv("HOME")), oldPath(getenv("PATH")) {
+    : QObject(parent), oldHome(qgetenv("HOME")), oldPath(getenv("PATH")) {
     Q_UNUSED(parent);
 }
 
 WakaTimeClientTest::~WakaTimeClientTest() {
 }
 
+void WakaTimeClientTest::initTestCase() {
+    QVERIFY(homeDir.isValid());
+    testHome = homeDir.path().toUtf8();
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+}
+
 void WakaTimeClientTest::testGetBinPathNotFound() {
     qputenv("PATH", QByteArrayLiteral(""));
     WakaTime wakatime;
@@ -73,6 +172,58 @@ void WakaTimeClientTest::testGetBinPathFound() {
     qputenv("PATH", QByteArray(oldPath));
 }
 
+void WakaTimeClientTest::testGetBinPathInvalidated() {
+    QTemporaryDir tempDir;
+    QDir first(tempDir.filePath(QStringLiteral("first")));
+    QDir second(tempDir.filePath(QStringLiteral("second")));
+    QDir(tempDir.path()).mkpath(QStringLiteral("first"));
+    QDir(tempDir.path()).mkpath(QStringLiteral("second"));
+    qputenv("PATH", (first.absolutePath() + QLatin1Char(':') + second.absolutePath()).toUtf8());
+    auto exec = createFile(second, QStringLiteral("some-executable"));
+    QFile::setPermissions(exec, QFileDevice::ExeUser | QFileDevice::ReadUser);
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getBinPath({QStringLiteral("some-executable")}), exec);
+    QVERIFY(wakatime.cacheWatcher.isWatching(first.absolutePath()));
+    QVERIFY(wakatime.cacheWatcher.isWatching(second.absolutePath()));
+
+    // A new binary earlier in PATH takes over once the cache entry is dropped.
+    auto newExec = createFile(first, QStringLiteral("some-executable"));
+    QFile::setPermissions(newExec, QFileDevice::ExeUser | QFileDevice::ReadUser);
+    QTRY_VERIFY(!wakatime.binPathCache.contains(QStringLiteral("some-executable")));
+    QCOMPARE(wakatime.getBinPath({QStringLiteral("some-executable")}), newExec);
+
+    qputenv("PATH", QByteArray(oldPath));
+}
+
+void WakaTimeClientTest::testGetBinPathUnrelatedChange() {
+    QTemporaryDir tempDir;
+    QDir first(tempDir.filePath(QStringLiteral("first")));
+    QDir second(tempDir.filePath(QStringLiteral("second")));
+    QDir(tempDir.path()).mkpath(QStringLiteral("first"));
+    QDir(tempDir.path()).mkpath(QStringLiteral("second"));
+    qputenv("PATH", (first.absolutePath() + QLatin1Char(':') + second.absolutePath()).toUtf8());
+    auto exec = createFile(second, QStringLiteral("some-executable"));
+    QFile::setPermissions(exec, QFileDevice::ExeUser | QFileDevice::ReadUser);
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getBinPath({QStringLiteral("some-executable")}), exec);
+    QSignalSpy spy(&wakatime.cacheWatcher, &CacheWatcher::directoryChanged);
+
+    // Like the logs and databases written to ~/.wakatime.
+    createFile(first, QStringLiteral("wakatime.log"));
+    createFile(second, QStringLiteral("wakatime.log"));
+    QTRY_VERIFY(spy.count() >= 2);
+    QVERIFY(wakatime.binPathCache.contains(QStringLiteral("some-executable")));
+    QVERIFY(wakatime.cacheWatcher.isWatching(first.absolutePath()));
+
+    // Removing the binary still drops the entry.
+    QFile::remove(exec);
+    QTRY_VERIFY(!wakatime.binPathCache.contains(QStringLiteral("some-executable")));
+
+    qputenv("PATH", QByteArray(oldPath));
+}
+
 void WakaTimeClientTest::testGetProjectDirectoryNotFound() {
     WakaTime wakatime;
     QFileInfo fileInfo(QStringLiteral("/"));
@@ -94,6 +245,227 @@ void WakaTimeClientTest::testGetProjectDirectoryFound() {
     QVERIFY(projectDir.endsWith(QStringLiteral("kate-wakatime-client-test")));
 }
 
+void WakaTimeClientTest::testGetProjectDirectoryCached() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("project/.git"));
+    root.mkpath(QStringLiteral("project/a/b/c"));
+    root.mkpath(QStringLiteral("project/a/d"));
+    QDir c(root.filePath(QStringLiteral("project/a/b/c")));
+    QDir d(root.filePath(QStringLiteral("project/a/d")));
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(createFile(c, QStringLiteral("file.cpp")))),
+             QStringLiteral("project"));
+    auto stats = wakatime.projectResolver.stats();
+    QCOMPARE(stats.hits, 0U);
+    QCOMPARE(stats.misses, 1U);
+    // c, b, a and project are cached.
+    QCOMPARE(stats.entries, 4);
+    const auto probes = stats.probes;
+
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(createFile(c, QStringLiteral("other.cpp")))),
+             QStringLiteral("project"));
+    stats = wakatime.projectResolver.stats();
+    QCOMPARE(stats.hits, 1U);
+    QCOMPARE(stats.probes, probes);
+
+    // A sibling directory only probes itself before reaching the cached parent.
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(createFile(d, QStringLiteral("file.cpp")))),
+             QStringLiteral("project"));
+    stats = wakatime.projectResolver.stats();
+    QCOMPARE(stats.misses, 2U);
+    QCOMPARE(stats.probes, probes + ProjectResolver::markers().size());
+    QCOMPARE(stats.entries, 5);
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryCachedMiss() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("a/b"));
+    WakaTime wakatime;
+    QFileInfo fileInfo(
+        createFile(QDir(root.filePath(QStringLiteral("a/b"))), QStringLiteral("file.cpp")));
+    QVERIFY(wakatime.getProjectDirectory(fileInfo).isEmpty());
+    const auto probes = wakatime.projectResolver.stats().probes;
+    QVERIFY(wakatime.getProjectDirectory(fileInfo).isEmpty());
+    QCOMPARE(wakatime.projectResolver.stats().hits, 1U);
+    QCOMPARE(wakatime.projectResolver.stats().probes, probes);
+    wakatime.projectResolver.clear();
+    QCOMPARE(wakatime.projectResolver.stats().entries, 0);
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryInvalidated() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("outer/.git"));
+    root.mkpath(QStringLiteral("outer/inner/src"));
+    QFileInfo fileInfo(
+        createFile(QDir(root.filePath(QStringLiteral("outer/inner/src"))), QStringLiteral("a.c")));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getProjectDirectory(fileInfo), QStringLiteral("outer"));
+    QCOMPARE(wakatime.projectResolver.stats().entries, 3);
+
+    // Only the entries at or below the new repository are dropped.
+    root.mkpath(QStringLiteral("outer/inner/.git"));
+    QTRY_COMPARE(wakatime.projectResolver.stats().entries, 1);
+    QCOMPARE(wakatime.getProjectDirectory(fileInfo), QStringLiteral("inner"));
+    QCOMPARE(wakatime.projectResolver.stats().misses, 2U);
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryKeptOnSave() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("project/.git"));
+    root.mkpath(QStringLiteral("project/src"));
+    QDir project(root.filePath(QStringLiteral("project")));
+    QDir src(project.filePath(QStringLiteral("src")));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(createFile(src, QStringLiteral("a.c")))),
+             QStringLiteral("project"));
+    QCOMPARE(wakatime.projectResolver.stats().entries, 2);
+
+    // Saving files changes their directories, but neither stops or starts being a project root.
+    QSignalSpy spy(&wakatime.cacheWatcher, &CacheWatcher::directoryChanged);
+    createFile(src, QStringLiteral("b.c"));
+    createFile(project, QStringLiteral("README.md"));
+    QTRY_VERIFY(spy.count() >= 2);
+    QCOMPARE(wakatime.projectResolver.stats().entries, 2);
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(src.filePath(QStringLiteral("b.c")))),
+             QStringLiteral("project"));
+    QCOMPARE(wakatime.projectResolver.stats().misses, 1U);
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryWatchLimit() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    WakaTime wakatime;
+    wakatime.cacheWatcher.setMaxDirectories(8);
+    for (auto i = 0; i < 10; ++i) {
+        const auto name = QStringLiteral("project%1").arg(i);
+        root.mkpath(name + QStringLiteral("/.git"));
+        root.mkpath(name + QStringLiteral("/src"));
+        const QFileInfo fileInfo(createFile(QDir(root.filePath(name + QStringLiteral("/src"))),
+                                            QStringLiteral("a.c")));
+        QCOMPARE(wakatime.getProjectDirectory(fileInfo), name);
+        // Still cached after more directories than can be watched have been looked up.
+        const auto hits = wakatime.projectResolver.stats().hits;
+        QCOMPARE(wakatime.getProjectDirectory(fileInfo), name);
+        QCOMPARE(wakatime.projectResolver.stats().hits, hits + 1);
+        QVERIFY(wakatime.cacheWatcher.size() <= 8);
+    }
+    // Watches are released with the entries.
+    wakatime.projectResolver.clear();
+    QCOMPARE(wakatime.cacheWatcher.size(), 0);
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryMarkers_data() {
+    QTest::addColumn<QString>("marker");
+    QTest::addColumn<bool>("isDirectory");
+    QTest::newRow("git") << QStringLiteral(".git") << true;
+    QTest::newRow("git worktree") << QStringLiteral(".git") << false;
+    QTest::newRow("hg") << QStringLiteral(".hg") << true;
+    QTest::newRow("svn") << QStringLiteral(".svn") << true;
+    QTest::newRow("bzr") << QStringLiteral(".bzr") << true;
+    QTest::newRow("wakatime-project") << QStringLiteral(".wakatime-project") << false;
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryMarkers() {
+    QFETCH(QString, marker);
+    QFETCH(bool, isDirectory);
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("project/src"));
+    QDir project(root.filePath(QStringLiteral("project")));
+    if (isDirectory) {
+        project.mkdir(marker);
+    } else {
+        createFile(project, marker);
+    }
+    QFileInfo fileInfo(
+        createFile(QDir(project.filePath(QStringLiteral("src"))), QStringLiteral("a.c")));
+    WakaTime wakatime;
+    QCOMPARE(wakatime.getProjectDirectory(fileInfo), QStringLiteral("project"));
+}
+
+void WakaTimeClientTest::testGetProjectDirectoryProjectFile() {
+    QTemporaryDir tempDir;
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("checkout/.git"));
+    root.mkpath(QStringLiteral("checkout/src"));
+    QDir project(root.filePath(QStringLiteral("checkout")));
+    const auto write = [&project](const QString &name, const QByteArray &contents) {
+        QFile file(project.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(contents);
+    };
+    write(QStringLiteral(".git/HEAD"), "ref: refs/heads/main\n");
+    write(QStringLiteral(".wakatime-project"), "my-project\nrelease\n");
+    auto transport = std::make_unique<RecordingTransport>();
+    auto *recording = transport.get();
+
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    const auto file =
+        createFile(QDir(project.filePath(QStringLiteral("src"))), QStringLiteral("a.c"));
+    QCOMPARE(wakatime.getProjectDirectory(QFileInfo(file)), QStringLiteral("my-project"));
+    QCOMPARE(wakatime.getProjectBranch(QFileInfo(file)), QStringLiteral("release"));
+    QCOMPARE(wakatime.send(file, QStringLiteral("c"), 1, 1, 1, true), WakaTime::SentSuccessfully);
+    QCOMPARE(recording->heartbeats().last().project, QStringLiteral("my-project"));
+    QCOMPARE(recording->heartbeats().last().branch, QStringLiteral("release"));
+
+    // Edited in place, which is seen from the size. Without a second line the branch comes from
+    // Git.
+    write(QStringLiteral(".wakatime-project"), "renamed\n");
+    QCOMPARE(wakatime.send(file, QStringLiteral("c"), 2, 1, 1, true), WakaTime::SentSuccessfully);
+    QCOMPARE(recording->heartbeats().last().project, QStringLiteral("renamed"));
+    QCOMPARE(recording->heartbeats().last().branch, QStringLiteral("main"));
+}
+
+void WakaTimeClientTest::testCanonicalFilePathCached() {
+    auto tempDir = createStubCli("exit 0\n");
+    const auto target = createFile(tempDir, QStringLiteral("target.cpp"));
+    const auto link = tempDir.filePath(QStringLiteral("link.cpp"));
+    QFile::remove(link);
+    QVERIFY(QFile::link(target, link));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.canonicalFilePath(link), QFileInfo(target).canonicalFilePath());
+    QCOMPARE(wakatime.canonicalPathMisses, 1U);
+    QCOMPARE(wakatime.send(link, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(wakatime.canonicalPathHits, 1U);
+
+    // A throttled heartbeat is refused without resolving anything again.
+    const auto probes = wakatime.projectResolver.stats().probes;
+    const auto projectHits = wakatime.projectResolver.stats().hits;
+    QCOMPARE(wakatime.send(link, QStringLiteral("cpp"), 2, 1, 1, false), WakaTime::TooSoon);
+    QCOMPARE(wakatime.canonicalPathHits, 2U);
+    QCOMPARE(wakatime.canonicalPathMisses, 1U);
+    QCOMPARE(wakatime.projectResolver.stats().probes, probes);
+    QCOMPARE(wakatime.projectResolver.stats().hits, projectHits);
+
+    // The link now points elsewhere, as after a rename.
+    const auto other = createFile(tempDir, QStringLiteral("other.cpp"));
+    QFile::remove(link);
+    QVERIFY(QFile::link(other, link));
+    QCOMPARE(wakatime.canonicalFilePath(link), QFileInfo(target).canonicalFilePath());
+    wakatime.forgetCanonicalPath(link);
+    QCOMPARE(wakatime.canonicalFilePath(link), QFileInfo(other).canonicalFilePath());
+    QCOMPARE(wakatime.canonicalPathMisses, 2U);
+
+    // Files that do not exist are not cached.
+    const auto missing = tempDir.filePath(QStringLiteral("missing.cpp"));
+    QVERIFY(wakatime.canonicalFilePath(missing).isEmpty());
+    QVERIFY(wakatime.canonicalFilePath(missing).isEmpty());
+    QCOMPARE(wakatime.canonicalPathMisses, 4U);
+
+    QFile::remove(link);
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
 void WakaTimeClientTest::testSendWakaTimeCliNotInPath() {
     qputenv("HOME", QByteArrayLiteral("/non/existent/path"));
     qputenv("PATH", QByteArrayLiteral(""));
@@ -102,7 +474,28 @@ void WakaTimeClientTest::testSendWakaTimeCliNotInPath() {
         QStringLiteral("/path/to/some/file.cpp"), QStringLiteral("cpp"), 10, 5, 100, false);
     QVERIFY(state == WakaTime::WakaTimeCliNotInPath);
     qputenv("PATH", QByteArray(oldPath));
-    qputenv("HOME", QByteArray(oldHome));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendWakaTimeCliNotInPathJournalled() {
+    QTemporaryDir tempDir;
+    const auto file = createFile(QDir(tempDir.path()), QStringLiteral("offline.cpp"));
+    QFile::remove(HeartbeatJournal::defaultPath());
+    qputenv("PATH", QByteArrayLiteral(""));
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::activityTotalsChanged);
+    // Nothing to send is reported before the missing wakatime-cli.
+    QCOMPARE(wakatime.send(QString(), QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::NothingToSend);
+    // Kept for when wakatime-cli is installed, and counted as coding time.
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::WakaTimeCliNotInPath);
+    QCOMPARE(wakatime.journal.size(), 1);
+    QCOMPARE(spy.count(), 1);
+    // Throttled like a sent heartbeat, so the journal does not get one per keystroke.
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 2, 1, 1, false), WakaTime::TooSoon);
+    QCOMPARE(wakatime.journal.size(), 1);
+    qputenv("PATH", QByteArray(oldPath));
 }
 
 void WakaTimeClientTest::testSendEmptyFilePath() {
@@ -126,7 +519,7 @@ void WakaTimeClientTest::testSendEmptyFilePath() {
     QVERIFY(state == WakaTime::NothingToSend);
 
     qputenv("PATH", QByteArray(oldPath));
-    qputenv("HOME", QByteArray(oldHome));
+    qputenv("HOME", testHome);
 }
 
 void WakaTimeClientTest::testSendSuccessful() {
@@ -151,7 +544,7 @@ void WakaTimeClientTest::testSendSuccessful() {
     QVERIFY(state == WakaTime::SentSuccessfully);
 
     qputenv("PATH", QByteArray(oldPath));
-    qputenv("HOME", QByteArray(oldHome));
+    qputenv("HOME", testHome);
 }
 
 void WakaTimeClientTest::testSendErrorSending() {
@@ -176,7 +569,7 @@ void WakaTimeClientTest::testSendErrorSending() {
     QVERIFY(state == WakaTime::ErrorSending);
 
     qputenv("PATH", QByteArray(oldPath));
-    qputenv("HOME", QByteArray(oldHome));
+    qputenv("HOME", testHome);
 }
 
 void WakaTimeClientTest::testSendTooSoon() {
@@ -214,7 +607,910 @@ void WakaTimeClientTest::testSendTooSoon() {
     QVERIFY(state == WakaTime::TooSoon);
 
     qputenv("PATH", QByteArray(oldPath));
-    qputenv("HOME", QByteArray(oldHome));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendTooSoonPerFile() {
+    auto tempDir = createStubCli("exit 0\n");
+    auto header = createFile(tempDir, QStringLiteral("a.h"));
+    auto source = createFile(tempDir, QStringLiteral("a.cpp"));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.send(header, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(wakatime.send(source, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::SentSuccessfully);
+    // Switching back to the header does not defeat the throttle.
+    QCOMPARE(wakatime.send(header, QStringLiteral("cpp"), 2, 1, 1, false), WakaTime::TooSoon);
+    QCOMPARE(wakatime.send(source, QStringLiteral("cpp"), 2, 1, 1, false), WakaTime::TooSoon);
+
+    wakatime.setThrottleInterval(0);
+    QTest::qWait(5);
+    QCOMPARE(wakatime.send(header, QStringLiteral("cpp"), 3, 1, 1, false),
+             WakaTime::SentSuccessfully);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+QDir WakaTimeClientTest::createStubCli(const QByteArray &body) {
+    QDir tempDir(QDir::tempPath() + QDir::separator() +
+                 QStringLiteral("kate-wakatime-client-test"));
+    qputenv("HOME", tempDir.absolutePath().toUtf8());
+    qputenv("PATH", tempDir.absolutePath().toUtf8());
+    QDir(tempDir.filePath(QStringLiteral(".wakatime"))).removeRecursively();
+
+    QDir::temp().mkdir(QStringLiteral("kate-wakatime-client-test"));
+    QFile someExec(tempDir.filePath(QStringLiteral("wakatime")));
+    someExec.open(QIODevice::WriteOnly);
+    someExec.write("#!/bin/sh\n");
+    someExec.write(body);
+    someExec.close();
+    someExec.setPermissions(QFileDevice::ExeUser | QFileDevice::ReadUser | QFileDevice::WriteUser |
+                            QFileDevice::ReadGroup | QFileDevice::ReadOther);
+    return tempDir;
+}
+
+void WakaTimeClientTest::testSendAsyncSuccessful() {
+    auto tempDir = createStubCli("exit 0\n");
+
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(
+        tempDir.filePath(QStringLiteral("some-file.cpp")), QStringLiteral("cpp"), 10, 5, 100, true);
+    QCOMPARE(wakatime.throttle.size(), 0);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::SentSuccessfully);
+    QVERIFY(wakatime.inFlight.isEmpty());
+    QVERIFY(wakatime.throttle.contains(spy.at(0).at(1).toString()));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendAsyncErrorSending() {
+    auto tempDir = createStubCli("exit 1\n");
+
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(
+        tempDir.filePath(QStringLiteral("some-file.cpp")), QStringLiteral("cpp"), 10, 5, 100, true);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::ErrorSending);
+    // Failed heartbeats are journalled and count for throttling.
+    QVERIFY(wakatime.throttle.contains(spy.at(0).at(1).toString()));
+    QVERIFY(wakatime.inFlight.isEmpty());
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendOffline() {
+    // wakatime-cli saved the heartbeats to its own offline queue.
+    auto tempDir = createStubCli("exit 102\n");
+    QFile::remove(HeartbeatJournal::defaultPath());
+    const auto file = createFile(tempDir, QStringLiteral("offline.cpp"));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 1, 1, 1, false), WakaTime::SentOffline);
+    QVERIFY(wakatime.journal.isEmpty());
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 2, 1, 1, false), WakaTime::TooSoon);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(file, QStringLiteral("cpp"), 3, 1, 1, true);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::SentOffline);
+    QVERIFY(wakatime.journal.isEmpty());
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendAsyncInFlight() {
+    auto tempDir = createStubCli("sleep 1\n");
+
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    auto filePath = tempDir.filePath(QStringLiteral("some-file.cpp"));
+    wakatime.sendAsync(filePath, QStringLiteral("cpp"), 10, 5, 100, false);
+    // Second call while the first process is still running.
+    wakatime.sendAsync(filePath, QStringLiteral("cpp"), 10, 5, 100, false);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::TooSoon);
+    QVERIFY(spy.wait(5000));
+    QCOMPARE(spy.at(1).at(0).value<WakaTime::State>(), WakaTime::SentSuccessfully);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendAsyncWakaTimeCliNotInPath() {
+    qputenv("HOME", QByteArrayLiteral("/non/existent/path"));
+    qputenv("PATH", QByteArrayLiteral(""));
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(
+        QStringLiteral("/path/to/some/file.cpp"), QStringLiteral("cpp"), 10, 5, 100, false);
+    // Reported synchronously since no process is started.
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::WakaTimeCliNotInPath);
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+QString WakaTimeClientTest::createFile(const QDir &dir, const QString &name) {
+    QFile file(dir.filePath(name));
+    file.open(QIODevice::WriteOnly);
+    file.close();
+    return file.fileName();
+}
+
+void WakaTimeClientTest::testQueueHeartbeatBatchSize() {
+    auto tempDir = createStubCli("echo \"$@\" > \"$(dirname \"$0\")/args.txt\"\n"
+                                 "cat > \"$(dirname \"$0\")/stdin.txt\"\n");
+
+    WakaTime wakatime;
+    wakatime.setBatchSize(3);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    for (const auto &name :
+         {QStringLiteral("a.cpp"), QStringLiteral("b.cpp"), QStringLiteral("c.cpp")}) {
+        wakatime.queueHeartbeat(createFile(tempDir, name), QStringLiteral("cpp"), 1, 1, 1, false);
+    }
+    QVERIFY(wakatime.scheduler.isEmpty());
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 3);
+    for (const auto &args : spy) {
+        QCOMPARE(args.at(0).value<WakaTime::State>(), WakaTime::SentSuccessfully);
+    }
+    QVERIFY(wakatime.inFlight.isEmpty());
+
+    QFile argsFile(tempDir.filePath(QStringLiteral("args.txt")));
+    QVERIFY(argsFile.open(QIODevice::ReadOnly));
+    QVERIFY(argsFile.readAll().contains("--extra-heartbeats"));
+    QFile stdinFile(tempDir.filePath(QStringLiteral("stdin.txt")));
+    QVERIFY(stdinFile.open(QIODevice::ReadOnly));
+    auto extraHeartbeats = QJsonDocument::fromJson(stdinFile.readAll()).array();
+    QCOMPARE(extraHeartbeats.size(), 2);
+    QVERIFY(extraHeartbeats.at(0).toObject().value(QStringLiteral("entity")).toString().endsWith(
+        QStringLiteral("b.cpp")));
+    QCOMPARE(extraHeartbeats.at(1).toObject().value(QStringLiteral("language")).toString(),
+             QStringLiteral("cpp"));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testQueueHeartbeatFlushInterval() {
+    auto tempDir = createStubCli("echo \"$@\" > \"$(dirname \"$0\")/args.txt\"\n"
+                                 "cat > \"$(dirname \"$0\")/stdin.txt\"\n");
+
+    WakaTime wakatime;
+    wakatime.setFlushInterval(50);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.queueHeartbeat(
+        createFile(tempDir, QStringLiteral("a.cpp")), QStringLiteral("cpp"), 1, 1, 1, false);
+    QCOMPARE(wakatime.scheduler.size(), 1);
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::SentSuccessfully);
+
+    QFile argsFile(tempDir.filePath(QStringLiteral("args.txt")));
+    QVERIFY(argsFile.open(QIODevice::ReadOnly));
+    QVERIFY(!argsFile.readAll().contains("--extra-heartbeats"));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testQueueHeartbeatPending() {
+    auto tempDir = createStubCli("exit 0\n");
+
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    auto filePath = createFile(tempDir, QStringLiteral("a.cpp"));
+    wakatime.queueHeartbeat(filePath, QStringLiteral("cpp"), 1, 1, 1, false);
+    wakatime.queueHeartbeat(filePath, QStringLiteral("cpp"), 2, 1, 1, false);
+    QCOMPARE(wakatime.scheduler.size(), 1);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::TooSoon);
+    // Write events are never throttled and flush the queue straight away.
+    wakatime.queueHeartbeat(filePath, QStringLiteral("cpp"), 3, 1, 1, true);
+    QVERIFY(wakatime.scheduler.isEmpty());
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 3);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testQueueHeartbeatBackpressure() {
+    auto tempDir = createStubCli("sleep 1\n"
+                                 "echo \"$@\" >> \"$(dirname \"$0\")/args.txt\"\n");
+    QFile::remove(tempDir.filePath(QStringLiteral("args.txt")));
+
+    WakaTime wakatime;
+    wakatime.setMaxProcesses(2);
+    wakatime.setQueueCapacity(2);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    // Use every process slot.
+    for (const auto &name : {QStringLiteral("a.cpp"), QStringLiteral("b.cpp")}) {
+        wakatime.sendAsync(createFile(tempDir, name), QStringLiteral("cpp"), 1, 1, 1, true);
+    }
+    QCOMPARE(wakatime.processRunner.running(), 2);
+    for (const auto &name :
+         {QStringLiteral("c.cpp"), QStringLiteral("d.cpp"), QStringLiteral("e.cpp")}) {
+        wakatime.queueHeartbeat(createFile(tempDir, name), QStringLiteral("cpp"), 1, 1, 1, false);
+    }
+    // The queue is full so the oldest heartbeat is dropped.
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::Dropped);
+    QVERIFY(spy.at(0).at(1).toString().endsWith(QStringLiteral("c.cpp")));
+    // A write is queued rather than starting a third process, and pushes out a plain heartbeat.
+    wakatime.sendAsync(
+        createFile(tempDir, QStringLiteral("f.cpp")), QStringLiteral("cpp"), 1, 1, 1, true);
+    QCOMPARE(spy.count(), 2);
+    QVERIFY(spy.at(1).at(1).toString().endsWith(QStringLiteral("d.cpp")));
+    QCOMPARE(wakatime.processRunner.running(), 2);
+    QCOMPARE(wakatime.scheduler.size(), 2);
+    QVERIFY(wakatime.flushDeferred);
+    const auto metrics = wakatime.metrics();
+    QCOMPARE(metrics.value(QStringLiteral("processes")).toInteger(), 2);
+    QCOMPARE(metrics.value(QStringLiteral("queued")).toInteger(), 2);
+    QCOMPARE(metrics.value(QStringLiteral("states"))
+                 .toObject()
+                 .value(QStringLiteral("Dropped"))
+                 .toInteger(),
+             2);
+
+    // The queue is sent as soon as a process finishes, with the write first.
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 6, 10000);
+    QVERIFY(wakatime.scheduler.isEmpty());
+    QFile argsFile(tempDir.filePath(QStringLiteral("args.txt")));
+    QVERIFY(argsFile.open(QIODevice::ReadOnly));
+    const auto lines = argsFile.readAll().trimmed().split('\n');
+    QCOMPARE(lines.size(), 3);
+    QVERIFY(lines.last().contains("f.cpp --time"));
+    QVERIFY(lines.last().contains("--extra-heartbeats"));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testJournalReplay() {
+    auto tempDir = createStubCli("test -f \"$(dirname \"$0\")/fail\" && exit 1\n"
+                                 "cat > \"$(dirname \"$0\")/stdin.txt\"\n");
+    auto failFile = createFile(tempDir, QStringLiteral("fail"));
+
+    WakaTime wakatime;
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(
+        createFile(tempDir, QStringLiteral("a.cpp")), QStringLiteral("cpp"), 1, 1, 1, true);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::ErrorSending);
+    QCOMPARE(wakatime.journal.size(), 1);
+    QVERIFY(QFile::exists(wakatime.journal.path()));
+    QVERIFY(wakatime.journal.path().startsWith(tempDir.absolutePath()));
+
+    // The next successful send replays the journal in one invocation.
+    QFile::remove(failFile);
+    wakatime.sendAsync(
+        createFile(tempDir, QStringLiteral("b.cpp")), QStringLiteral("cpp"), 1, 1, 1, true);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.at(1).at(0).value<WakaTime::State>(), WakaTime::SentSuccessfully);
+    QTRY_VERIFY(wakatime.journal.isEmpty());
+    QVERIFY(!wakatime.replaying);
+    QVERIFY(!QFile::exists(wakatime.journal.path()));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testJournalCliNotInPath() {
+    auto tempDir = createStubCli("exit 0\n");
+    qputenv("PATH", QByteArrayLiteral(""));
+    QFile::remove(tempDir.filePath(QStringLiteral("wakatime")));
+
+    WakaTime wakatime;
+    auto filePath = createFile(tempDir, QStringLiteral("a.cpp"));
+    auto state = wakatime.send(filePath, QStringLiteral("cpp"), 1, 1, 1, false);
+    QCOMPARE(state, WakaTime::WakaTimeCliNotInPath);
+    QCOMPARE(wakatime.journal.size(), 1);
+    // Journalled heartbeats are throttled like sent ones.
+    state = wakatime.send(filePath, QStringLiteral("cpp"), 1, 1, 1, false);
+    QCOMPARE(state, WakaTime::TooSoon);
+    QCOMPARE(wakatime.journal.size(), 1);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testJournalCompactsTornLine() {
+    QDir tempDir(QDir::tempPath() + QDir::separator() +
+                 QStringLiteral("kate-wakatime-client-test"));
+    QDir::temp().mkdir(QStringLiteral("kate-wakatime-client-test"));
+    auto path = tempDir.filePath(QStringLiteral("torn.jsonl"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("{\"entity\":\"/a.cpp\",\"time\":1.5,\"lineno\":3}\n");
+    // Left behind by a crash in the middle of a write.
+    file.write("{\"entity\":\"/b.c");
+    file.close();
+
+    HeartbeatJournal journal(path);
+    QCOMPARE(journal.size(), 1);
+    auto heartbeats = journal.read(10).heartbeats;
+    QCOMPARE(heartbeats.size(), 1);
+    QCOMPARE(heartbeats.at(0).entity, QStringLiteral("/a.cpp"));
+    QCOMPARE(heartbeats.at(0).timeMs, 1500);
+    QCOMPARE(heartbeats.at(0).lineNumber, 3);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll().count('\n'), 1);
+    file.close();
+
+    // Appending after compaction must not merge with the removed partial line.
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/c.cpp");
+    journal.append({heartbeat});
+    journal.sync();
+    QCOMPARE(HeartbeatJournal(path).size(), 2);
+    QFile::remove(path);
+}
+
+void WakaTimeClientTest::testJournalMaxEntries() {
+    QDir tempDir(QDir::tempPath() + QDir::separator() +
+                 QStringLiteral("kate-wakatime-client-test"));
+    QDir::temp().mkdir(QStringLiteral("kate-wakatime-client-test"));
+    auto path = tempDir.filePath(QStringLiteral("max.jsonl"));
+    QFile::remove(path);
+
+    HeartbeatJournal journal(path);
+    journal.setMaxEntries(2);
+    QList<Heartbeat> heartbeats;
+    for (const auto &name :
+         {QStringLiteral("/a.cpp"), QStringLiteral("/b.cpp"), QStringLiteral("/c.cpp")}) {
+        Heartbeat heartbeat;
+        heartbeat.entity = name;
+        heartbeats << heartbeat;
+    }
+    journal.append(heartbeats);
+    QCOMPARE(journal.size(), 2);
+    auto batch = journal.read(1);
+    QCOMPARE(batch.heartbeats.at(0).entity, QStringLiteral("/b.cpp"));
+    journal.discard(batch);
+    QCOMPARE(journal.size(), 1);
+    batch = journal.read(10);
+    QCOMPARE(batch.heartbeats.at(0).entity, QStringLiteral("/c.cpp"));
+    journal.discard(batch);
+    QVERIFY(journal.isEmpty());
+    QVERIFY(!QFile::exists(path));
+
+    // Compaction leaves a tenth of the cap free instead of rewriting on every append.
+    journal.setMaxEntries(10);
+    for (auto i = 0; i < 11; ++i) {
+        Heartbeat heartbeat;
+        heartbeat.entity = QStringLiteral("/%1.cpp").arg(i);
+        journal.append({heartbeat});
+    }
+    QCOMPARE(journal.size(), 9);
+    QCOMPARE(journal.read(1).heartbeats.at(0).entity, QStringLiteral("/2.cpp"));
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/11.cpp");
+    journal.append({heartbeat});
+    QCOMPARE(journal.size(), 10);
+    QCOMPARE(journal.read(1).heartbeats.at(0).entity, QStringLiteral("/2.cpp"));
+    QFile::remove(path);
+}
+
+void WakaTimeClientTest::testJournalDiscardAfterCompaction() {
+    QTemporaryDir tempDir;
+    const auto path = tempDir.filePath(QStringLiteral("replay.jsonl"));
+    HeartbeatJournal journal(path);
+    journal.setMaxEntries(4);
+    const auto append = [&journal](const QString &entity) {
+        Heartbeat heartbeat;
+        heartbeat.entity = entity;
+        journal.append({heartbeat});
+    };
+    for (const auto &name :
+         {QStringLiteral("/a.cpp"), QStringLiteral("/b.cpp"), QStringLiteral("/c.cpp")}) {
+        append(name);
+    }
+    // Read for replay, then compacted while the replay runs.
+    const auto batch = journal.read(2);
+    QCOMPARE(batch.heartbeats.size(), 2);
+    append(QStringLiteral("/d.cpp"));
+    append(QStringLiteral("/e.cpp"));
+    QCOMPARE(journal.size(), 4);
+
+    // a.cpp was dropped by compaction, and only b.cpp is removed for the replay.
+    journal.discard(batch);
+    QCOMPARE(journal.size(), 3);
+    const auto rest = journal.read(10).heartbeats;
+    QCOMPARE(rest.at(0).entity, QStringLiteral("/c.cpp"));
+    QCOMPARE(rest.at(2).entity, QStringLiteral("/e.cpp"));
+}
+
+void WakaTimeClientTest::testJournalReplayOffset() {
+    QTemporaryDir tempDir;
+    const auto path = tempDir.filePath(QStringLiteral("offset.jsonl"));
+    HeartbeatJournal journal(path);
+    QList<Heartbeat> heartbeats;
+    for (auto i = 0; i < 10; ++i) {
+        Heartbeat heartbeat;
+        heartbeat.entity = QStringLiteral("/%1.cpp").arg(i);
+        heartbeats << heartbeat;
+    }
+    journal.append(heartbeats);
+    const auto fileSize = QFileInfo(path).size();
+
+    // The first batches only move the offset, the file is left alone.
+    auto batch = journal.read(3);
+    journal.discard(batch);
+    QCOMPARE(journal.size(), 7);
+    QCOMPARE(QFileInfo(path).size(), fileSize);
+    QCOMPARE(journal.read(1).heartbeats.at(0).entity, QStringLiteral("/3.cpp"));
+    // Once more than half has been replayed the rest is rewritten.
+    batch = journal.read(3);
+    journal.discard(batch);
+    QCOMPARE(journal.size(), 4);
+    QVERIFY(QFileInfo(path).size() < fileSize / 2);
+    QCOMPARE(HeartbeatJournal(path).size(), 4);
+    QCOMPARE(journal.read(10).heartbeats.at(0).entity, QStringLiteral("/6.cpp"));
+}
+
+void WakaTimeClientTest::testJournalReplayAfterRestart() {
+    QFile::remove(HeartbeatJournal::defaultPath());
+    {
+        auto transport = std::make_unique<PartialTransport>();
+        transport->setMaxBatchSize(3);
+        WakaTime wakatime;
+        wakatime.setTransport(std::move(transport));
+        QList<Heartbeat> heartbeats;
+        for (auto i = 0; i < 10; ++i) {
+            Heartbeat heartbeat;
+            heartbeat.entity = QStringLiteral("/%1.cpp").arg(i);
+            heartbeats << heartbeat;
+        }
+        wakatime.journal.append(heartbeats);
+        // Too little is replayed for the journal to be rewritten straight away.
+        wakatime.replayJournal();
+        QCOMPARE(wakatime.journal.size(), 7);
+    }
+    auto transport = std::make_unique<RecordingTransport>();
+    auto *recording = transport.get();
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    QCOMPARE(wakatime.journal.size(), 7);
+    wakatime.replayJournal();
+    const auto replayed = recording->heartbeats();
+    QCOMPARE(replayed.size(), 7);
+    QCOMPARE(replayed.first().entity, QStringLiteral("/3.cpp"));
+    QVERIFY(wakatime.journal.isEmpty());
+}
+
+void WakaTimeClientTest::testJournalShared() {
+    QTemporaryDir tempDir;
+    const auto path = tempDir.filePath(QStringLiteral("shared.jsonl"));
+    // As used by two Kate instances.
+    HeartbeatJournal first(path);
+    HeartbeatJournal second(path);
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/a.cpp");
+    first.append({heartbeat});
+    heartbeat.entity = QStringLiteral("/b.cpp");
+    second.append({heartbeat});
+    QCOMPARE(second.size(), 2);
+    // Replaces the file that the first journal has open.
+    second.compact();
+    heartbeat.entity = QStringLiteral("/c.cpp");
+    first.append({heartbeat});
+    QCOMPARE(first.size(), 3);
+    QCOMPARE(HeartbeatJournal(path).size(), 3);
+
+    // Heartbeats replayed by one are not read again by the other.
+    const auto batch = first.read(2);
+    first.discard(batch);
+    const auto rest = second.read(10).heartbeats;
+    QCOMPARE(rest.size(), 1);
+    QCOMPARE(rest.first().entity, QStringLiteral("/c.cpp"));
+    QVERIFY(!QFile::exists(path + QStringLiteral(".lock")));
+}
+
+void WakaTimeClientTest::testReplayStoppedOnShutdown() {
+    QFile::remove(HeartbeatJournal::defaultPath());
+    auto transport = std::make_unique<RecordingTransport>();
+    auto *recording = transport.get();
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/a.cpp");
+    wakatime.journal.append({heartbeat});
+    // As when a replay finishes while the destructor waits for running processes.
+    wakatime.shuttingDown = true;
+    wakatime.replayJournal();
+    QVERIFY(recording->batches().isEmpty());
+    QCOMPARE(wakatime.journal.size(), 1);
+}
+
+void WakaTimeClientTest::testSendTimedOut() {
+    auto tempDir = createStubCli("exec sleep 10\n");
+
+    WakaTime wakatime;
+    wakatime.setProcessTimeout(200);
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(wakatime.send(createFile(tempDir, QStringLiteral("some-file.cpp")),
+                           QStringLiteral("cpp"),
+                           10,
+                           5,
+                           100,
+                           true),
+             WakaTime::TimedOut);
+    QVERIFY(timer.elapsed() < 5000);
+    // Kept for replay.
+    QCOMPARE(wakatime.journal.size(), 1);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendAsyncTimedOut() {
+    auto tempDir = createStubCli("exec sleep 10\n");
+
+    WakaTime wakatime;
+    wakatime.setProcessTimeout(200);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(createFile(tempDir, QStringLiteral("some-file.cpp")),
+                       QStringLiteral("cpp"),
+                       10,
+                       5,
+                       100,
+                       true);
+    QVERIFY(spy.wait(5000));
+    QCOMPARE(spy.at(0).at(0).value<WakaTime::State>(), WakaTime::TimedOut);
+    QCOMPARE(wakatime.journal.size(), 1);
+    QVERIFY(wakatime.inFlight.isEmpty());
+    QCOMPARE(wakatime.processRunner.running(), 0);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testCircuitBreaker() {
+    auto tempDir = createStubCli("echo >> \"$(dirname \"$0\")/runs.txt\"\n"
+                                 "test -f \"$(dirname \"$0\")/fail\" && exit 1\n"
+                                 "exit 0\n");
+    auto failFile = createFile(tempDir, QStringLiteral("fail"));
+    auto runsFile = tempDir.filePath(QStringLiteral("runs.txt"));
+    QFile::remove(runsFile);
+    const auto runs = [&runsFile]() {
+        QFile file(runsFile);
+        return file.open(QIODevice::ReadOnly) ? file.readAll().count('\n') : 0;
+    };
+
+    WakaTime wakatime;
+    wakatime.breaker = CircuitBreaker(2, 200, 200);
+    wakatime.breaker.setJitter(0);
+    const auto send = [&](const QString &name) {
+        return wakatime.send(createFile(tempDir, name), QStringLiteral("cpp"), 1, 1, 1, true);
+    };
+    QCOMPARE(send(QStringLiteral("a.cpp")), WakaTime::ErrorSending);
+    QCOMPARE(send(QStringLiteral("b.cpp")), WakaTime::ErrorSending);
+    QCOMPARE(wakatime.breaker.state(), CircuitBreaker::Open);
+    QVERIFY(wakatime.retryTimer.isActive());
+    // No process is started while the breaker is open.
+    QCOMPARE(send(QStringLiteral("c.cpp")), WakaTime::BackingOff);
+    QCOMPARE(wakatime.journal.size(), 3);
+    QCOMPARE(runs(), 2);
+
+    // Once the delay has passed one journalled heartbeat is sent as a probe. The rest follow in a
+    // single batch after it succeeds.
+    QFile::remove(failFile);
+    QTRY_VERIFY(wakatime.journal.isEmpty());
+    QTRY_VERIFY(!wakatime.replaying);
+    QCOMPARE(wakatime.breaker.state(), CircuitBreaker::Closed);
+    QCOMPARE(runs(), 4);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testCircuitBreakerProbeQueued() {
+    QTemporaryDir tempDir;
+    auto transport = std::make_unique<RecordingTransport>();
+    auto *recording = transport.get();
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    const auto file = createFile(QDir(tempDir.path()), QStringLiteral("a.cpp"));
+    wakatime.queueHeartbeat(file, QStringLiteral("cpp"), 1, 1, 1, false);
+    QCOMPARE(wakatime.scheduler.size(), 1);
+
+    // Open with the delay already over, so the next request is the probe.
+    wakatime.breaker = CircuitBreaker(1, 0, 0);
+    wakatime.breaker.recordFailure(QDateTime::currentMSecsSinceEpoch() - 1);
+    QCOMPARE(wakatime.breaker.state(), CircuitBreaker::Open);
+    // Queued behind the first heartbeat, so the breaker is left alone until the batch starts.
+    wakatime.sendAsync(file, QStringLiteral("cpp"), 2, 1, 1, false);
+    QCOMPARE(wakatime.breaker.state(), CircuitBreaker::Open);
+    wakatime.flush();
+    QCOMPARE(recording->heartbeats().size(), 1);
+    QCOMPARE(recording->heartbeats().first().lineNumber, 2);
+    QCOMPARE(wakatime.breaker.state(), CircuitBreaker::Closed);
+    QVERIFY(wakatime.journal.isEmpty());
+    QCOMPARE(spy.count(), 2);
+}
+
+void WakaTimeClientTest::testMetrics() {
+    auto tempDir = createStubCli("exit 0\n");
+    auto filePath = createFile(tempDir, QStringLiteral("some-file.cpp"));
+
+    WakaTime wakatime;
+    QCOMPARE(wakatime.send(filePath, QStringLiteral("cpp"), 10, 5, 100, false),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(wakatime.send(filePath, QStringLiteral("cpp"), 10, 5, 100, false), WakaTime::TooSoon);
+    QCOMPARE(wakatime.send(QString(), QStringLiteral("cpp"), 10, 5, 100, false),
+             WakaTime::NothingToSend);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    wakatime.sendAsync(filePath, QStringLiteral("cpp"), 10, 5, 100, true);
+    QVERIFY(spy.wait());
+
+    auto metrics = wakatime.metrics();
+    auto states = metrics.value(QStringLiteral("states")).toObject();
+    QCOMPARE(states.value(QStringLiteral("SentSuccessfully")).toInteger(), 2);
+    QCOMPARE(states.value(QStringLiteral("TooSoon")).toInteger(), 1);
+    QCOMPARE(states.value(QStringLiteral("NothingToSend")).toInteger(), 1);
+    QCOMPARE(states.value(QStringLiteral("ErrorSending")).toInteger(), 0);
+    QCOMPARE(metrics.value(QStringLiteral("sendTime"))
+                 .toObject()
+                 .value(QStringLiteral("count"))
+                 .toInteger(),
+             4);
+    QCOMPARE(metrics.value(QStringLiteral("processTime"))
+                 .toObject()
+                 .value(QStringLiteral("count"))
+                 .toInteger(),
+             2);
+    QCOMPARE(metrics.value(QStringLiteral("queued")).toInteger(), 0);
+    QCOMPARE(metrics.value(QStringLiteral("inFlight")).toInteger(), 0);
+    // The path to wakatime-cli is looked up once and then cached.
+    auto binPathCache = metrics.value(QStringLiteral("binPathCache")).toObject();
+    QCOMPARE(binPathCache.value(QStringLiteral("misses")).toInteger(), 1);
+    QCOMPARE(binPathCache.value(QStringLiteral("hits")).toInteger(), 1);
+    QCOMPARE(binPathCache.value(QStringLiteral("hitRate")).toDouble(), 0.5);
+
+    wakatime.resetMetrics();
+    metrics = wakatime.metrics();
+    QCOMPARE(metrics.value(QStringLiteral("states"))
+                 .toObject()
+                 .value(QStringLiteral("SentSuccessfully"))
+                 .toInteger(),
+             0);
+    QCOMPARE(metrics.value(QStringLiteral("projectCache"))
+                 .toObject()
+                 .value(QStringLiteral("hitRate"))
+                 .toDouble(),
+             0.0);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testMetricsDump() {
+    QTemporaryDir tempDir;
+    auto path = tempDir.filePath(QStringLiteral("metrics.json"));
+    WakaTime wakatime;
+    wakatime.setMetricsDumpPath(path);
+    wakatime.setMetricsDumpInterval(10);
+    QTRY_VERIFY(QFile::exists(path));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const auto metrics = QJsonDocument::fromJson(file.readAll()).object();
+    QVERIFY(metrics.contains(QStringLiteral("states")));
+    QVERIFY(metrics.contains(QStringLiteral("sendTime")));
+    wakatime.setMetricsDumpInterval(0);
+    QVERIFY(!wakatime.metricsDumpTimer.isActive());
+}
+
+void WakaTimeClientTest::testActivityTotalsAccepted() {
+    QTemporaryDir tempDir;
+    QFile::remove(ActivityTotals::defaultPath());
+    WakaTime wakatime;
+    wakatime.setTransport(std::make_unique<RecordingTransport>());
+    // Nothing is sent, so the write fills the queue.
+    wakatime.maxProcesses = 0;
+    wakatime.setQueueCapacity(1);
+    QSignalSpy spy(&wakatime, &WakaTime::activityTotalsChanged);
+    QSignalSpy finished(&wakatime, &WakaTime::sendFinished);
+    const QDir dir(tempDir.path());
+    wakatime.sendAsync(
+        createFile(dir, QStringLiteral("a.cpp")), QStringLiteral("cpp"), 1, 1, 1, true);
+    QCOMPARE(spy.count(), 1);
+    // Dropped from the full queue, so not counted.
+    wakatime.queueHeartbeat(
+        createFile(dir, QStringLiteral("b.cpp")), QStringLiteral("cpp"), 1, 1, 1, false);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(finished.at(0).at(0).value<WakaTime::State>(), WakaTime::Dropped);
+    QCOMPARE(spy.count(), 1);
+
+    // Saved a while after changing rather than only on exit.
+    QVERIFY(wakatime.totalsSaveTimer.isActive());
+    wakatime.totalsSaveTimer.start(0);
+    QTRY_VERIFY(QFile::exists(ActivityTotals::defaultPath()));
+    QVERIFY(!wakatime.activityTotals().isModified());
+}
+
+void WakaTimeClientTest::testActivityTotals() {
+    auto tempDir = createStubCli("exit 0\n");
+    const auto file = createFile(tempDir, QStringLiteral("totals.py"));
+    const auto language = QStringLiteral("Python");
+    {
+        WakaTime wakatime;
+        QSignalSpy spy(&wakatime, &WakaTime::activityTotalsChanged);
+        const auto before = wakatime.activityTotals().language(language);
+        QCOMPARE(wakatime.send(file, language, 1, 1, 1, false), WakaTime::SentSuccessfully);
+        QTest::qWait(20);
+        // Throttled heartbeats are not counted.
+        QCOMPARE(wakatime.send(file, language, 2, 1, 1, false), WakaTime::TooSoon);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(wakatime.send(file, language, 3, 1, 1, true), WakaTime::SentSuccessfully);
+        QCOMPARE(spy.count(), 2);
+        QVERIFY(wakatime.activityTotals().language(language) >= before + 20);
+    }
+    // Saved on destruction and loaded by the next instance.
+    WakaTime wakatime;
+    QVERIFY(wakatime.activityTotals().language(language) >= 20);
+    QVERIFY(QFile::exists(ActivityTotals::defaultPath()));
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testTransport() {
+    QTemporaryDir tempDir;
+    qputenv("HOME", tempDir.path().toUtf8());
+    qputenv("PATH", QByteArrayLiteral(""));
+    auto transport = std::make_unique<RecordingTransport>();
+    transport->setMaxBatchSize(2);
+    auto *recording = transport.get();
+
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    wakatime.setBatchSize(3);
+    QSignalSpy spy(&wakatime, &WakaTime::sendFinished);
+    const QDir dir(tempDir.path());
+    const auto first = createFile(dir, QStringLiteral("a.cpp"));
+    QCOMPARE(wakatime.send(first, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(recording->batches().size(), 1);
+    // A full queue is split to fit the transport.
+    for (const auto &name :
+         {QStringLiteral("b.cpp"), QStringLiteral("c.cpp"), QStringLiteral("d.cpp")}) {
+        wakatime.queueHeartbeat(createFile(dir, name), QStringLiteral("cpp"), 1, 1, 1, false);
+    }
+    QTRY_COMPARE(spy.count(), 3);
+    QCOMPARE(recording->batches().size(), 3);
+    QCOMPARE(recording->batches().at(1).size(), 2);
+    QCOMPARE(recording->heartbeats().size(), 4);
+    QVERIFY(recording->heartbeats().last().entity.endsWith(QStringLiteral("d.cpp")));
+
+    recording->setResult(HeartbeatTransport::Failed);
+    const auto last = createFile(dir, QStringLiteral("e.cpp"));
+    QCOMPARE(wakatime.send(last, QStringLiteral("cpp"), 1, 1, 1, false), WakaTime::ErrorSending);
+
+    qputenv("PATH", QByteArray(oldPath));
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testTransportUnavailable() {
+    QTemporaryDir tempDir;
+    qputenv("HOME", tempDir.path().toUtf8());
+    auto transport = std::make_unique<RecordingTransport>();
+    transport->setAvailable(false);
+    auto *recording = transport.get();
+
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    const auto file = createFile(QDir(tempDir.path()), QStringLiteral("a.cpp"));
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 1, 1, 1, false),
+             WakaTime::WakaTimeCliNotInPath);
+    QVERIFY(recording->batches().isEmpty());
+    // Kept for when the transport is available again.
+    QCOMPARE(wakatime.journal.size(), 1);
+
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testTransportFromEnvironment_data() {
+    QTest::addColumn<QByteArray>("name");
+    QTest::addColumn<bool>("batched");
+    QTest::addColumn<bool>("journal");
+
+    QTest::newRow("unset") << QByteArray() << true << false;
+    QTest::newRow("batched") << QByteArrayLiteral("batched") << true << false;
+    QTest::newRow("cli") << QByteArrayLiteral("cli") << false << false;
+    const auto otherJournal = homeDir.filePath(QStringLiteral("other.jsonl")).toUtf8();
+    QTest::newRow("journal") << (QByteArrayLiteral("journal:") + otherJournal) << false << true;
+    QTest::newRow("journal without path") << QByteArrayLiteral("journal:") << true << false;
+    QTest::newRow("offline journal")
+        << (QByteArrayLiteral("journal:") + HeartbeatJournal::defaultPath().toUtf8()) << true
+        << false;
+    QTest::newRow("unknown") << QByteArrayLiteral("http") << true << false;
+}
+
+void WakaTimeClientTest::testTransportFromEnvironment() {
+    QFETCH(QByteArray, name);
+    QFETCH(bool, batched);
+    QFETCH(bool, journal);
+    qputenv("KATE_WAKATIME_TRANSPORT", name);
+
+    WakaTime wakatime;
+    QCOMPARE(dynamic_cast<BatchedCliTransport *>(wakatime.transport.get()) != nullptr, batched);
+    QCOMPARE(dynamic_cast<JournalTransport *>(wakatime.transport.get()) != nullptr, journal);
+    QVERIFY(dynamic_cast<CliTransport *>(wakatime.transport.get()) || journal);
+
+    qunsetenv("KATE_WAKATIME_TRANSPORT");
+}
+
+void WakaTimeClientTest::testTransportJournal() {
+    QTemporaryDir tempDir;
+    qputenv("HOME", tempDir.path().toUtf8());
+    const auto path = tempDir.filePath(QStringLiteral("heartbeats.jsonl"));
+    qputenv("KATE_WAKATIME_TRANSPORT", QStringLiteral("journal:%1").arg(path).toUtf8());
+
+    {
+        WakaTime wakatime;
+        const auto file = createFile(QDir(tempDir.path()), QStringLiteral("a.cpp"));
+        QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 1, 1, 1, false),
+                 WakaTime::SentSuccessfully);
+        // Delivered, so nothing is kept for replaying.
+        QVERIFY(wakatime.journal.isEmpty());
+    }
+    HeartbeatJournal journal(path);
+    QCOMPARE(journal.size(), 1);
+
+    qunsetenv("KATE_WAKATIME_TRANSPORT");
+    qputenv("HOME", testHome);
+}
+
+void WakaTimeClientTest::testSendBranch() {
+    QTemporaryDir tempDir;
+    qputenv("HOME", tempDir.path().toUtf8());
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("project/.git"));
+    QDir project(root.filePath(QStringLiteral("project")));
+    QFile head(project.filePath(QStringLiteral(".git/HEAD")));
+    QVERIFY(head.open(QIODevice::WriteOnly));
+    head.write("ref: refs/heads/main\n");
+    head.close();
+    auto transport = std::make_unique<RecordingTransport>();
+    auto *recording = transport.get();
+
+    WakaTime wakatime;
+    wakatime.setTransport(std::move(transport));
+    const auto file = createFile(project, QStringLiteral("a.cpp"));
+    QCOMPARE(wakatime.getProjectBranch(QFileInfo(file)), QStringLiteral("main"));
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 1, 1, 1, true),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(recording->heartbeats().last().project, QStringLiteral("project"));
+    QCOMPARE(recording->heartbeats().last().branch, QStringLiteral("main"));
+    QCOMPARE(wakatime.branchResolver.stats().misses, 1U);
+    QCOMPARE(wakatime.branchResolver.stats().hits, 1U);
+
+    // A checkout is picked up from the new modification time.
+    QVERIFY(head.open(QIODevice::WriteOnly));
+    head.write("ref: refs/heads/feature\n");
+    head.close();
+    QVERIFY(head.open(QIODevice::ReadWrite));
+    QVERIFY(head.setFileTime(QDateTime::currentDateTime().addSecs(60),
+                             QFileDevice::FileModificationTime));
+    head.close();
+    QCOMPARE(wakatime.send(file, QStringLiteral("cpp"), 2, 1, 1, true),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(recording->heartbeats().last().branch, QStringLiteral("feature"));
+    QCOMPARE(wakatime.branchResolver.stats().misses, 2U);
+
+    qputenv("HOME", testHome);
 }
 
 QTEST_MAIN(WakaTimeClientTest)
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MIT
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QObject>
+#include <QtTest/QSignalSpy>
 #include <QtTest/QTest>
 
 #include "wakatimeconfig.h"
@@ -19,10 +20,24 @@ private Q_SLOTS:
     void testApiKey();
     void testApiUrl();
     void testConfigureDialogKeepsPointer();
+    void testConfigureDialogReparent();
+    void testDialogRefreshedOnChange();
     void testHideFilenames();
     void testInit();
     void testShowDialogClearApiKey();
     void testShowDialogDoesNothingIfNotConfigured();
+    void testSnapshot();
+    void testSnapshotReloadedOnChange();
+    void testSnapshotReloadedOnCreate();
+
+private:
+    /**
+     * Write the API key to the configuration file as another program would.
+     *
+     * @param config Configuration whose file to write.
+     * @param apiKey API key.
+     */
+    void writeApiKey(const WakaTimeConfig &config, const QString &apiKey);
 };
 
 WakaTimeConfigTest::WakaTimeConfigTest(QObject *parent) : QObject(parent) {
@@ -100,7 +115,22 @@ void WakaTimeConfigTest::testConfigureDialogKeepsPointer() {
     QVERIFY(config.dialog_ != nullptr);
     QDialog *oldDialog = config.dialog_;
     config.configureDialog();
-    QCOMPARE(config.dialog_, oldDialog);
+    QCOMPARE(config.dialog_.data(), oldDialog);
+}
+
+void WakaTimeConfigTest::testConfigureDialogReparent() {
+    WakaTimeConfig config;
+    config.configureDialog();
+    {
+        QWidget window;
+        config.configureDialog(&window);
+        QVERIFY(config.dialog_->isWindow());
+        QCOMPARE(config.dialog_->parentWidget(), &window);
+    }
+    // Deleted along with its parent window. A new one is created when needed.
+    QVERIFY(config.dialog_.isNull());
+    config.configureDialog();
+    QVERIFY(config.dialog_ != nullptr);
 }
 
 void WakaTimeConfigTest::testShowDialogDoesNothingIfNotConfigured() {
@@ -111,6 +141,62 @@ void WakaTimeConfigTest::testShowDialogDoesNothingIfNotConfigured() {
     config.showDialog();
 }
 
+void WakaTimeConfigTest::writeApiKey(const WakaTimeConfig &config, const QString &apiKey) {
+    QSettings other(config.config_->fileName(), QSettings::IniFormat);
+    other.setValue(kSettingsKeyApiKey, apiKey);
+    other.sync();
+}
+
+void WakaTimeConfigTest::testSnapshot() {
+    WakaTimeConfig config;
+    config.setApiKey(QStringLiteral("old"));
+    const auto snapshot = config.snapshot();
+    QSignalSpy spy(&config, &WakaTimeConfig::settingsChanged);
+    config.setApiKey(QStringLiteral("new"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(snapshot->apiKey, QStringLiteral("old"));
+    QCOMPARE(config.snapshot()->apiKey, QStringLiteral("new"));
+    // Setting the same value does not replace the snapshot.
+    const auto current = config.snapshot();
+    config.setApiKey(QStringLiteral("new"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(config.snapshot(), current);
+}
+
+void WakaTimeConfigTest::testSnapshotReloadedOnChange() {
+    WakaTimeConfig config;
+    config.setApiKey(QStringLiteral("before"));
+    config.save();
+    QSignalSpy spy(&config, &WakaTimeConfig::settingsChanged);
+    // The time stamp must change for QSettings to read the file again.
+    QTest::qWait(1100);
+    writeApiKey(config, QStringLiteral("after"));
+    QTRY_COMPARE(config.apiKey(), QStringLiteral("after"));
+    QCOMPARE(spy.count(), 1);
+}
+
+void WakaTimeConfigTest::testSnapshotReloadedOnCreate() {
+    WakaTimeConfig reader;
+    QFile::remove(reader.config_->fileName());
+    WakaTimeConfig config;
+    QVERIFY(config.apiKey().isEmpty());
+    QCOMPARE(config.watcher_.directories(), QStringList{QDir::homePath()});
+    writeApiKey(config, QStringLiteral("created"));
+    QTRY_COMPARE(config.apiKey(), QStringLiteral("created"));
+    // The home directory is no longer watched once the file exists.
+    QCOMPARE(config.watcher_.files(), QStringList{config.config_->fileName()});
+    QVERIFY(config.watcher_.directories().isEmpty());
+}
+
+void WakaTimeConfigTest::testDialogRefreshedOnChange() {
+    WakaTimeConfig config;
+    config.setApiKey(QStringLiteral("before"));
+    config.configureDialog();
+    QCOMPARE(config.ui_.lineEdit_apiKey->text(), QStringLiteral("before"));
+    config.setApiKey(QStringLiteral("after"));
+    QCOMPARE(config.ui_.lineEdit_apiKey->text(), QStringLiteral("after"));
+}
+
 QTEST_MAIN(WakaTimeConfigTest)
 
 #include "configtest.moc"
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include "debouncer.h"
+
+class DebouncerTest : public QObject {
+    Q_OBJECT
+
+public:
+    DebouncerTest(QObject *parent = nullptr);
+    ~DebouncerTest() override;
+
+private Q_SLOTS:
+    void testBurstFiresOnce();
+    void testMaxWait();
+    void testCancel();
+    void testIndependentObjects();
+};
+
+DebouncerTest::DebouncerTest(QObject *parent) : QObject(parent) {
+}
+
+DebouncerTest::~DebouncerTest() {
+}
+
+void DebouncerTest::testBurstFiresOnce() {
+    Debouncer debouncer(50, 10000);
+    QSignalSpy spy(&debouncer, &Debouncer::fired);
+    QObject object;
+    for (auto i = 0; i < 5; i++) {
+        debouncer.touch(&object);
+        QTest::qWait(10);
+    }
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(debouncer.isPending(&object));
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<QObject *>(), &object);
+    QVERIFY(!debouncer.isPending(&object));
+    QVERIFY(!debouncer.timer_.isActive());
+}
+
+void DebouncerTest::testMaxWait() {
+    Debouncer debouncer(100, 200);
+    QSignalSpy spy(&debouncer, &Debouncer::fired);
+    QObject object;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    // Never quiet for long enough, so only the maximum wait applies.
+    while (spy.isEmpty() && elapsed.elapsed() < 5000) {
+        debouncer.touch(&object);
+        QTest::qWait(20);
+    }
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(elapsed.elapsed() < 1000);
+}
+
+void DebouncerTest::testCancel() {
+    Debouncer debouncer(20, 10000);
+    QSignalSpy spy(&debouncer, &Debouncer::fired);
+    QObject object;
+    debouncer.touch(&object);
+    debouncer.cancel(&object);
+    QVERIFY(!debouncer.isPending(&object));
+    QVERIFY(!debouncer.timer_.isActive());
+    QVERIFY(!spy.wait(100));
+}
+
+void DebouncerTest::testIndependentObjects() {
+    Debouncer debouncer(50, 10000);
+    QSignalSpy spy(&debouncer, &Debouncer::fired);
+    QObject first;
+    QObject second;
+    debouncer.touch(&first);
+    QTest::qWait(30);
+    debouncer.touch(&second);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).value<QObject *>(), &first);
+    QVERIFY(debouncer.isPending(&second));
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(1).at(0).value<QObject *>(), &second);
+}
+
+QTEST_MAIN(DebouncerTest)
+
+#include "debouncertest.moc"
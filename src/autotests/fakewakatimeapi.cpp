@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QTcpSocket>
+
+#include "fakewakatimeapi.h"
+
+namespace {
+constexpr int kCreated = 201;
+constexpr int kAccepted = 202;
+
+QByteArray statusLine(int statusCode) {
+    switch (statusCode) {
+    case kCreated:
+        return QByteArrayLiteral("201 Created");
+    case kAccepted:
+        return QByteArrayLiteral("202 Accepted");
+    case 404:
+        return QByteArrayLiteral("404 Not Found");
+    default:
+        return QByteArray::number(statusCode) + QByteArrayLiteral(" Error");
+    }
+}
+
+/** Response data for one created heartbeat. */
+QJsonObject created(qsizetype id) {
+    return {{QStringLiteral("data"), QJsonObject{{QStringLiteral("id"), QString::number(id)}}}};
+}
+} // namespace
+
+FakeWakaTimeApi::FakeWakaTimeApi(QObject *parent) : QObject(parent) {
+    connect(&server_, &QTcpServer::newConnection, this, &FakeWakaTimeApi::slotNewConnection);
+}
+
+FakeWakaTimeApi::~FakeWakaTimeApi() {
+}
+
+bool FakeWakaTimeApi::listen() {
+    return server_.listen(QHostAddress::LocalHost);
+}
+
+QUrl FakeWakaTimeApi::url() const {
+    return QUrl(QStringLiteral("http://127.0.0.1:%1/api/v1").arg(server_.serverPort()));
+}
+
+qsizetype FakeWakaTimeApi::requests() const {
+    return requests_;
+}
+
+qsizetype FakeWakaTimeApi::heartbeats() const {
+    return heartbeats_;
+}
+
+QByteArray FakeWakaTimeApi::lastAuthorization() const {
+    return lastAuthorization_;
+}
+
+void FakeWakaTimeApi::setStatusCode(int statusCode) {
+    statusCode_ = statusCode;
+}
+
+void FakeWakaTimeApi::clear() {
+    requests_ = 0;
+    heartbeats_ = 0;
+    lastAuthorization_.clear();
+}
+
+void FakeWakaTimeApi::slotNewConnection() {
+    while (auto *socket = server_.nextPendingConnection()) {
+        buffers_.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            buffers_[socket] += socket->readAll();
+            processRequests(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            buffers_.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void FakeWakaTimeApi::processRequests(QTcpSocket *socket) {
+    auto &buffer = buffers_[socket];
+    // Clients may keep the connection open and send several requests.
+    while (true) {
+        const auto headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            return;
+        }
+        const auto lines = buffer.left(headerEnd).split('\n');
+        const auto requestLine = lines.first().trimmed().split(' ');
+        qsizetype contentLength = 0;
+        auto keepAlive = true;
+        for (auto it = lines.cbegin() + 1; it != lines.cend(); ++it) {
+            const auto colon = it->indexOf(':');
+            const auto name = it->left(colon).trimmed().toLower();
+            const auto value = it->mid(colon + 1).trimmed();
+            if (name == "content-length") {
+                contentLength = value.toLongLong();
+            } else if (name == "authorization") {
+                lastAuthorization_ = value;
+            } else if (name == "connection") {
+                keepAlive = value.toLower() != "close";
+            }
+        }
+        const auto bodyStart = headerEnd + 4;
+        if (buffer.size() < bodyStart + contentLength) {
+            return;
+        }
+        const auto body = buffer.mid(bodyStart, contentLength);
+        buffer.remove(0, bodyStart + contentLength);
+        QByteArray status;
+        const auto response = requestLine.size() < 2 ?
+                                  QByteArray() :
+                                  handle(requestLine.at(0),
+                                         requestLine.at(1).split('?').first(),
+                                         body,
+                                         status);
+        if (status.isEmpty()) {
+            status = statusLine(400);
+        }
+        socket->write(QByteArrayLiteral("HTTP/1.1 ") + status +
+                      QByteArrayLiteral("\r\nContent-Type: application/json\r\nContent-Length: ") +
+                      QByteArray::number(response.size()) +
+                      (keepAlive ? QByteArrayLiteral("\r\n\r\n") :
+                                   QByteArrayLiteral("\r\nConnection: close\r\n\r\n")) +
+                      response);
+        if (!keepAlive) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+}
+
+QByteArray FakeWakaTimeApi::handle(const QByteArray &method,
+                                   const QByteArray &path,
+                                   const QByteArray &body,
+                                   QByteArray &status) {
+    ++requests_;
+    const auto bulk = path.endsWith("/users/current/heartbeats.bulk");
+    if (method != "POST" || (!bulk && !path.endsWith("/users/current/heartbeats"))) {
+        status = statusLine(404);
+        return QByteArrayLiteral("{\"error\":\"Not found\"}");
+    }
+    const auto document = QJsonDocument::fromJson(body);
+    const auto count = document.isArray() ? document.array().size() : document.isObject() ? 1 : 0;
+    if (statusCode_ >= 400 || count == 0) {
+        status = statusLine(statusCode_ >= 400 ? statusCode_ : 400);
+        return QByteArrayLiteral("{\"error\":\"Rejected\"}");
+    }
+    heartbeats_ += count;
+    QByteArray response;
+    if (bulk) {
+        status = statusLine(statusCode_ ? statusCode_ : kAccepted);
+        QJsonArray responses;
+        for (qsizetype i = 0; i < count; ++i) {
+            responses.append(QJsonArray{created(heartbeats_ - count + i), kCreated});
+        }
+        response = QJsonDocument(QJsonObject{{QStringLiteral("responses"), responses}})
+                       .toJson(QJsonDocument::Compact);
+    } else {
+        status = statusLine(statusCode_ ? statusCode_ : kCreated);
+        response = QJsonDocument(created(heartbeats_)).toJson(QJsonDocument::Compact);
+    }
+    Q_EMIT heartbeatsReceived(count);
+    return response;
+}
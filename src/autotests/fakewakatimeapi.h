@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QUrl>
+#include <QtNetwork/QTcpServer>
+
+class QTcpSocket;
+
+/**
+ * Minimal stand-in for the WakaTime heartbeat API on a local port. It accepts `POST` requests to
+ * `/api/v1/users/current/heartbeats` and `/api/v1/users/current/heartbeats.bulk`, counts the
+ * heartbeats in their JSON bodies and answers the way the real API does. Point `api_url` in
+ * `~/.wakatime.cfg` at url() to use it.
+ */
+class FakeWakaTimeApi : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param parent Parent object.
+     */
+    explicit FakeWakaTimeApi(QObject *parent = nullptr);
+    ~FakeWakaTimeApi() override;
+    /**
+     * Start listening on a free port on the loopback interface.
+     *
+     * @return `true` if listening.
+     */
+    bool listen();
+    /**
+     * Get the base URL to use as `api_url`.
+     *
+     * @return URL ending in `/api/v1`.
+     */
+    QUrl url() const;
+    /**
+     * Get the number of requests answered.
+     *
+     * @return Number of requests.
+     */
+    qsizetype requests() const;
+    /**
+     * Get the number of heartbeats received.
+     *
+     * @return Number of heartbeats.
+     */
+    qsizetype heartbeats() const;
+    /**
+     * Get the `Authorization` header of the last request.
+     *
+     * @return Header value. Empty if there were no requests.
+     */
+    QByteArray lastAuthorization() const;
+    /**
+     * Set the status code of answers to heartbeat requests. Defaults to 201, or 202 for bulk
+     * requests. Heartbeats are not counted for error codes.
+     *
+     * @param statusCode HTTP status code. 0 restores the default.
+     */
+    void setStatusCode(int statusCode);
+    /** Forget the counts. */
+    void clear();
+
+Q_SIGNALS:
+    /**
+     * Emitted after a heartbeat request has been answered.
+     *
+     * @param count Number of heartbeats in the request.
+     */
+    void heartbeatsReceived(qsizetype count);
+
+private Q_SLOTS:
+    void slotNewConnection();
+
+private:
+    /**
+     * Answer every complete request buffered for @p socket.
+     *
+     * @param socket The connection.
+     */
+    void processRequests(QTcpSocket *socket);
+    /**
+     * Answer one request.
+     *
+     * @param method Request method.
+     * @param path Request path without the query.
+     * @param body Request body.
+     * @param[out] status Set to the status line.
+     * @return Response body.
+     */
+    QByteArray handle(const QByteArray &method,
+                      const QByteArray &path,
+                      const QByteArray &body,
+                      QByteArray &status);
+
+    QTcpServer server_;
+    QHash<QTcpSocket *, QByteArray> buffers_;
+    qsizetype requests_ = 0;
+    qsizetype heartbeats_ = 0;
+    QByteArray lastAuthorization_;
+    int statusCode_ = 0;
+};
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+// Stand-in for `wakatime-cli` used by the load test. It accepts the arguments the plugin passes,
+// reads `api_url` and `api_key` from `~/.wakatime.cfg` and posts the heartbeats to the API in one
+// bulk request, like the real CLI does. Unlike the real CLI it never queues heartbeats offline, so
+// every failure is visible to the plugin.
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QSettings>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkProxy>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include "heartbeat.h"
+
+namespace {
+// Exit codes used by the real CLI.
+constexpr int kSuccess = 0;
+constexpr int kFailure = 1;
+constexpr int kApiError = 102;
+constexpr int kConfigError = 103;
+constexpr int kRequestTimeoutMs = 30000;
+
+/**
+ * Read the heartbeat described on the command line.
+ *
+ * @param arguments Arguments without the program name.
+ * @param[out] extraHeartbeats Set if `--extra-heartbeats` was passed.
+ * @return The heartbeat.
+ */
+Heartbeat parseArguments(const QStringList &arguments, bool &extraHeartbeats) {
+    Heartbeat heartbeat;
+    extraHeartbeats = false;
+    for (auto it = arguments.cbegin(); it != arguments.cend(); ++it) {
+        const auto hasValue = it + 1 != arguments.cend();
+        if (*it == QStringLiteral("--write")) {
+            heartbeat.isWrite = true;
+        } else if (*it == QStringLiteral("--extra-heartbeats")) {
+            extraHeartbeats = true;
+        } else if (!hasValue) {
+            break;
+        } else if (*it == QStringLiteral("--entity")) {
+            heartbeat.entity = *++it;
+        } else if (*it == QStringLiteral("--time")) {
+            heartbeat.timeMs = qRound64((++it)->toDouble() * 1000.0);
+        } else if (*it == QStringLiteral("--alternate-project")) {
+            heartbeat.project = *++it;
+        } else if (*it == QStringLiteral("--alternate-branch")) {
+            heartbeat.branch = *++it;
+        } else if (*it == QStringLiteral("--language")) {
+            heartbeat.language = *++it;
+        } else if (*it == QStringLiteral("--lineno")) {
+            heartbeat.lineNumber = (++it)->toInt();
+        } else if (*it == QStringLiteral("--cursorpos")) {
+            heartbeat.cursorPosition = (++it)->toInt();
+        } else if (*it == QStringLiteral("--lines-in-file")) {
+            heartbeat.linesInFile = (++it)->toInt();
+        }
+    }
+    return heartbeat;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    bool extraHeartbeats;
+    const auto heartbeat = parseArguments(app.arguments().mid(1), extraHeartbeats);
+    if (heartbeat.entity.isEmpty()) {
+        return kFailure;
+    }
+    QJsonArray heartbeats{heartbeat.toJson()};
+    if (extraHeartbeats) {
+        QFile input;
+        if (input.open(stdin, QIODevice::ReadOnly)) {
+            for (const auto &value : QJsonDocument::fromJson(input.readAll()).array()) {
+                heartbeats.append(value);
+            }
+        }
+    }
+
+    const QSettings config(QDir::homePath() + QStringLiteral("/.wakatime.cfg"),
+                           QSettings::IniFormat);
+    auto apiUrl = config.value(QStringLiteral("settings/api_url")).toString();
+    const auto apiKey = config.value(QStringLiteral("settings/api_key")).toString();
+    if (apiUrl.isEmpty() || apiKey.isEmpty()) {
+        return kConfigError;
+    }
+    if (apiUrl.endsWith(QLatin1Char('/'))) {
+        apiUrl.chop(1);
+    }
+    QNetworkRequest request(QUrl(apiUrl + QStringLiteral("/users/current/heartbeats.bulk")));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+    request.setRawHeader(QByteArrayLiteral("Authorization"),
+                         QByteArrayLiteral("Basic ") + apiKey.toUtf8().toBase64());
+    request.setTransferTimeout(kRequestTimeoutMs);
+
+    QNetworkAccessManager manager;
+    // The API is always local, so ignore proxies set in the environment.
+    manager.setProxy(QNetworkProxy::NoProxy);
+    auto *reply =
+        manager.post(request, QJsonDocument(heartbeats).toJson(QJsonDocument::Compact));
+    QObject::connect(reply, &QNetworkReply::finished, &app, [reply]() {
+        const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        QCoreApplication::exit(reply->error() == QNetworkReply::NoError && status >= 200 &&
+                                       status < 300 ?
+                                   kSuccess :
+                                   kApiError);
+    });
+    return app.exec();
+}
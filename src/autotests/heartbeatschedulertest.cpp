@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include <optional>
+#include <utility>
+
+#include "heartbeatscheduler.h"
+
+class HeartbeatSchedulerTest : public QObject {
+    Q_OBJECT
+
+public:
+    HeartbeatSchedulerTest(QObject *parent = nullptr);
+    ~HeartbeatSchedulerTest() override;
+
+private Q_SLOTS:
+    void testWritesFirst();
+    void testTakeAll();
+    void testCoalesce();
+    void testCapacity();
+
+private:
+    /**
+     * Create a heartbeat.
+     *
+     * @param entity File path.
+     * @param isWrite Whether it is a write event.
+     * @return The heartbeat.
+     */
+    static Heartbeat heartbeat(const QString &entity, bool isWrite);
+};
+
+HeartbeatSchedulerTest::HeartbeatSchedulerTest(QObject *parent) : QObject(parent) {
+}
+
+HeartbeatSchedulerTest::~HeartbeatSchedulerTest() {
+}
+
+Heartbeat HeartbeatSchedulerTest::heartbeat(const QString &entity, bool isWrite) {
+    Heartbeat heartbeat;
+    heartbeat.entity = entity;
+    heartbeat.isWrite = isWrite;
+    return heartbeat;
+}
+
+void HeartbeatSchedulerTest::testWritesFirst() {
+    HeartbeatScheduler scheduler(10);
+    std::optional<Heartbeat> removed;
+    for (const auto &[entity, isWrite] : {std::pair{QStringLiteral("/a.cpp"), false},
+                                          std::pair{QStringLiteral("/b.cpp"), true},
+                                          std::pair{QStringLiteral("/c.cpp"), false},
+                                          std::pair{QStringLiteral("/d.cpp"), true}}) {
+        QCOMPARE(scheduler.enqueue(heartbeat(entity, isWrite), removed),
+                 HeartbeatScheduler::Queued);
+        QVERIFY(!removed);
+    }
+    QCOMPARE(scheduler.size(), 4);
+    QVERIFY(scheduler.hasWrites());
+
+    auto batch = scheduler.take(3);
+    QCOMPARE(batch.size(), 3);
+    QCOMPARE(batch.at(0).entity, QStringLiteral("/b.cpp"));
+    QCOMPARE(batch.at(1).entity, QStringLiteral("/d.cpp"));
+    QCOMPARE(batch.at(2).entity, QStringLiteral("/a.cpp"));
+    QVERIFY(!scheduler.hasWrites());
+
+    batch = scheduler.take(3);
+    QCOMPARE(batch.size(), 1);
+    QCOMPARE(batch.at(0).entity, QStringLiteral("/c.cpp"));
+    QVERIFY(scheduler.isEmpty());
+    QVERIFY(scheduler.take(3).isEmpty());
+}
+
+void HeartbeatSchedulerTest::testTakeAll() {
+    HeartbeatScheduler scheduler(10);
+    std::optional<Heartbeat> removed;
+    scheduler.enqueue(heartbeat(QStringLiteral("/a.cpp"), false), removed);
+    scheduler.enqueue(heartbeat(QStringLiteral("/b.cpp"), true), removed);
+    QVERIFY(scheduler.contains(QStringLiteral("/a.cpp")));
+    QVERIFY(scheduler.contains(QStringLiteral("/b.cpp")));
+    const auto batch = scheduler.takeAll();
+    QCOMPARE(batch.size(), 2);
+    QCOMPARE(batch.at(0).entity, QStringLiteral("/b.cpp"));
+    QVERIFY(scheduler.isEmpty());
+    QVERIFY(!scheduler.contains(QStringLiteral("/a.cpp")));
+}
+
+void HeartbeatSchedulerTest::testCoalesce() {
+    HeartbeatScheduler scheduler(10);
+    std::optional<Heartbeat> removed;
+    auto first = heartbeat(QStringLiteral("/a.cpp"), false);
+    first.lineNumber = 1;
+    auto second = first;
+    second.lineNumber = 2;
+    scheduler.enqueue(heartbeat(QStringLiteral("/b.cpp"), false), removed);
+    scheduler.enqueue(first, removed);
+    scheduler.enqueue(heartbeat(QStringLiteral("/c.cpp"), false), removed);
+    // The newer plain heartbeat replaces the older one in place.
+    QCOMPARE(scheduler.enqueue(second, removed), HeartbeatScheduler::Coalesced);
+    QCOMPARE(removed->lineNumber, 1);
+    QCOMPARE(scheduler.size(), 3);
+    auto batch = scheduler.take(2);
+    QCOMPARE(batch.at(1).entity, QStringLiteral("/a.cpp"));
+    QCOMPARE(batch.at(1).lineNumber, 2);
+
+    // A write replaces a plain heartbeat.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/c.cpp"), true), removed),
+             HeartbeatScheduler::Coalesced);
+    QVERIFY(!removed->isWrite);
+    QCOMPARE(scheduler.size(), 1);
+    QVERIFY(scheduler.hasWrites());
+    // A plain heartbeat is absorbed by a write.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/c.cpp"), false), removed),
+             HeartbeatScheduler::Coalesced);
+    QVERIFY(!removed->isWrite);
+    QCOMPARE(scheduler.size(), 1);
+    // Writes are kept.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/c.cpp"), true), removed),
+             HeartbeatScheduler::Queued);
+    QCOMPARE(scheduler.size(), 2);
+}
+
+void HeartbeatSchedulerTest::testCapacity() {
+    HeartbeatScheduler scheduler(2);
+    std::optional<Heartbeat> removed;
+    scheduler.enqueue(heartbeat(QStringLiteral("/a.cpp"), false), removed);
+    scheduler.enqueue(heartbeat(QStringLiteral("/b.cpp"), false), removed);
+    // The oldest plain heartbeat makes room.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/c.cpp"), false), removed),
+             HeartbeatScheduler::Queued);
+    QCOMPARE(removed->entity, QStringLiteral("/a.cpp"));
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/d.cpp"), true), removed),
+             HeartbeatScheduler::Queued);
+    QCOMPARE(removed->entity, QStringLiteral("/b.cpp"));
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/e.cpp"), true), removed),
+             HeartbeatScheduler::Queued);
+    QCOMPARE(removed->entity, QStringLiteral("/c.cpp"));
+    // Writes are never dropped, so the queue goes over capacity.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/f.cpp"), true), removed),
+             HeartbeatScheduler::Queued);
+    QVERIFY(!removed);
+    QCOMPARE(scheduler.size(), 3);
+    // With only writes queued a plain heartbeat has nothing to displace.
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/g.cpp"), false), removed),
+             HeartbeatScheduler::Dropped);
+    QCOMPARE(removed->entity, QStringLiteral("/g.cpp"));
+    scheduler.setCapacity(10);
+    QCOMPARE(scheduler.capacity(), 10);
+    QCOMPARE(scheduler.enqueue(heartbeat(QStringLiteral("/g.cpp"), false), removed),
+             HeartbeatScheduler::Queued);
+}
+
+QTEST_MAIN(HeartbeatSchedulerTest)
+
+#include "heartbeatschedulertest.moc"
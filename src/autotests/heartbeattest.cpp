@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QJsonObject>
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include <cstdlib>
+#include <utility>
+
+#include "heartbeat.h"
+
+#ifdef __GLIBC__
+// Every allocation, including those made by Qt for string and list data, goes through these.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+}
+
+namespace {
+// Only allocations made by the test thread while an AllocationCounter exists are counted.
+thread_local qsizetype *allocationCount = nullptr;
+
+void countAllocation() {
+    if (allocationCount) {
+        ++*allocationCount;
+    }
+}
+} // namespace
+
+extern "C" {
+void *malloc(size_t size) noexcept {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept {
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+/** Counts the allocations made by the current thread during its lifetime. */
+class AllocationCounter {
+public:
+    explicit AllocationCounter(qsizetype &count) {
+        count = 0;
+#ifdef __GLIBC__
+        allocationCount = &count;
+#endif
+    }
+    ~AllocationCounter() {
+#ifdef __GLIBC__
+        allocationCount = nullptr;
+#endif
+    }
+};
+
+class HeartbeatTest : public QObject {
+    Q_OBJECT
+
+public:
+    HeartbeatTest(QObject *parent = nullptr);
+    ~HeartbeatTest() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void testToArguments();
+    void testToArgumentsAllocations();
+    void testMoveDoesNotAllocate();
+    void testJsonRoundTrip();
+
+private:
+    /**
+     * Create a heartbeat with every field set.
+     *
+     * @return The heartbeat.
+     */
+    static Heartbeat heartbeat();
+};
+
+HeartbeatTest::HeartbeatTest(QObject *parent) : QObject(parent) {
+}
+
+HeartbeatTest::~HeartbeatTest() {
+}
+
+void HeartbeatTest::initTestCase() {
+#ifndef __GLIBC__
+    qWarning() << "Allocations are only counted with glibc.";
+#endif
+}
+
+Heartbeat HeartbeatTest::heartbeat() {
+    Heartbeat heartbeat;
+    heartbeat.entity = QStringLiteral("/home/user/project/main.cpp");
+    heartbeat.language = QStringLiteral("C++");
+    heartbeat.project = QStringLiteral("project");
+    heartbeat.branch = QStringLiteral("main");
+    heartbeat.lineNumber = 120;
+    heartbeat.cursorPosition = 7;
+    heartbeat.linesInFile = 4096;
+    heartbeat.isWrite = true;
+    heartbeat.timeMs = 1767225600005;
+    return heartbeat;
+}
+
+void HeartbeatTest::testToArguments() {
+    const QStringList suffix{QStringLiteral("--plugin"), QStringLiteral("test/1.0")};
+    const QStringList expected{
+        QStringLiteral("--entity"),
+        QStringLiteral("/home/user/project/main.cpp"),
+        QStringLiteral("--time"),
+        QStringLiteral("1767225600.005"),
+        QStringLiteral("--alternate-project"),
+        QStringLiteral("project"),
+        QStringLiteral("--alternate-branch"),
+        QStringLiteral("main"),
+        QStringLiteral("--write"),
+        QStringLiteral("--language"),
+        QStringLiteral("C++"),
+        QStringLiteral("--lineno"),
+        QStringLiteral("120"),
+        QStringLiteral("--cursorpos"),
+        QStringLiteral("7"),
+        QStringLiteral("--lines-in-file"),
+        QStringLiteral("4096"),
+        QStringLiteral("--plugin"),
+        QStringLiteral("test/1.0"),
+    };
+    QCOMPARE(heartbeat().toArguments(suffix), expected);
+    QCOMPARE(heartbeat().toArguments(), expected.mid(0, expected.size() - 2));
+}
+
+void HeartbeatTest::testToArgumentsAllocations() {
+#ifndef __GLIBC__
+    QSKIP("Allocations are only counted with glibc.");
+#endif
+    const auto record = heartbeat();
+    const QStringList suffix{QStringLiteral("--plugin"), QStringLiteral("test/1.0")};
+    qsizetype allocations = 0;
+    {
+        const AllocationCounter counter(allocations);
+        const auto arguments = record.toArguments(suffix);
+        Q_UNUSED(arguments);
+    }
+    // One for the list and one each for the time and the three numbers. The other strings are
+    // shared with the heartbeat and the suffix.
+    QVERIFY2(allocations <= 5, QByteArray::number(allocations).constData());
+}
+
+void HeartbeatTest::testMoveDoesNotAllocate() {
+#ifndef __GLIBC__
+    QSKIP("Allocations are only counted with glibc.");
+#endif
+    auto record = heartbeat();
+    qsizetype allocations = 0;
+    {
+        const AllocationCounter counter(allocations);
+        auto moved = std::move(record);
+        const auto copied = moved;
+        record = std::move(moved);
+        Q_UNUSED(copied);
+    }
+    QCOMPARE(allocations, 0);
+    QCOMPARE(record.entity, heartbeat().entity);
+}
+
+void HeartbeatTest::testJsonRoundTrip() {
+    const auto record = heartbeat();
+    const auto read = Heartbeat::fromJson(record.toJson());
+    QVERIFY(read);
+    QCOMPARE(read->toArguments(), record.toArguments());
+    QVERIFY(!Heartbeat::fromJson(QJsonObject()));
+}
+
+QTEST_MAIN(HeartbeatTest)
+
+#include "heartbeattest.moc"
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+
+#include <optional>
+
+#include "heartbeattransport.h"
+#include "processrunner.h"
+
+class HeartbeatTransportTest : public QObject {
+    Q_OBJECT
+
+public:
+    HeartbeatTransportTest(QObject *parent = nullptr);
+    ~HeartbeatTransportTest() override;
+
+private Q_SLOTS:
+    void testCliTransportOneProcessEach();
+    void testCliTransportWorstResult();
+    void testCliTransportUnavailable();
+    void testBatchedArguments();
+    void testBatchedCliTransport();
+    void testJournalTransport();
+    void testJournalTransportRefusesOfflineJournal();
+    void testRecordingTransport();
+
+private:
+    /**
+     * Write a stub `wakatime-cli` script.
+     *
+     * @param dir Directory to write the script to.
+     * @param body Shell script body, without the shebang line.
+     * @return The script path.
+     */
+    QString createStubCli(const QTemporaryDir &dir, const QByteArray &body);
+    /**
+     * Start delivery and wait for the result.
+     *
+     * @param transport Transport to use.
+     * @param heartbeats Heartbeats to deliver.
+     * @return The result, or `std::nullopt` if none was reported within 10 seconds.
+     */
+    std::optional<HeartbeatTransport::Result> start(HeartbeatTransport &transport,
+                                                    const QList<Heartbeat> &heartbeats);
+    /**
+     * Create a heartbeat.
+     *
+     * @param entity File path.
+     * @return The heartbeat.
+     */
+    static Heartbeat heartbeat(const QString &entity);
+    /**
+     * Read the lines of a file.
+     *
+     * @param path File path.
+     * @return Lines without the line endings.
+     */
+    static QList<QByteArray> readLines(const QString &path);
+};
+
+HeartbeatTransportTest::HeartbeatTransportTest(QObject *parent) : QObject(parent) {
+}
+
+HeartbeatTransportTest::~HeartbeatTransportTest() {
+}
+
+QString HeartbeatTransportTest::createStubCli(const QTemporaryDir &dir, const QByteArray &body) {
+    const auto path = dir.filePath(QStringLiteral("wakatime-cli"));
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    file.write("#!/bin/sh\n");
+    file.write(body);
+    file.close();
+    file.setPermissions(QFileDevice::ExeUser | QFileDevice::ReadUser | QFileDevice::WriteUser);
+    return path;
+}
+
+std::optional<HeartbeatTransport::Result>
+HeartbeatTransportTest::start(HeartbeatTransport &transport, const QList<Heartbeat> &heartbeats) {
+    std::optional<HeartbeatTransport::Result> result;
+    transport.start(heartbeats, [&result](HeartbeatTransport::Result r) { result = r; });
+    QTest::qWaitFor([&result]() { return result.has_value(); }, 10000);
+    return result;
+}
+
+Heartbeat HeartbeatTransportTest::heartbeat(const QString &entity) {
+    Heartbeat heartbeat;
+    heartbeat.entity = entity;
+    heartbeat.language = QStringLiteral("C++");
+    heartbeat.timeMs = 1767225600000;
+    return heartbeat;
+}
+
+QList<QByteArray> HeartbeatTransportTest::readLines(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return file.readAll().trimmed().split('\n');
+}
+
+void HeartbeatTransportTest::testCliTransportOneProcessEach() {
+    QTemporaryDir tempDir;
+    const auto program =
+        createStubCli(tempDir, "echo \"$@\" >> \"$(dirname \"$0\")/args.txt\"\n");
+    ProcessRunner runner(5000, 500);
+    CliTransport transport(runner, [program]() { return program; });
+    QVERIFY(transport.isAvailable());
+    QCOMPARE(transport.maxBatchSize(), 1);
+
+    const QList<Heartbeat> heartbeats{heartbeat(QStringLiteral("/a.cpp")),
+                                      heartbeat(QStringLiteral("/b.cpp"))};
+    QCOMPARE(start(transport, heartbeats), HeartbeatTransport::Sent);
+    QCOMPARE(runner.running(), 0);
+    QCOMPARE(transport.run(heartbeats), HeartbeatTransport::Sent);
+    const auto lines = readLines(tempDir.filePath(QStringLiteral("args.txt")));
+    QCOMPARE(lines.size(), 4);
+    for (const auto &line : lines) {
+        QVERIFY(line.contains("--plugin ktexteditor-wakatime/"));
+        QVERIFY(!line.contains("--extra-heartbeats"));
+    }
+}
+
+void HeartbeatTransportTest::testCliTransportWorstResult() {
+    QTemporaryDir tempDir;
+    // Fails for b.cpp only.
+    const auto program = createStubCli(tempDir,
+                                       "case \"$2\" in\n"
+                                       "*b.cpp) exit 1 ;;\n"
+                                       "esac\n");
+    ProcessRunner runner(5000, 500);
+    CliTransport transport(runner, [program]() { return program; });
+    const QList<Heartbeat> heartbeats{heartbeat(QStringLiteral("/a.cpp")),
+                                      heartbeat(QStringLiteral("/b.cpp")),
+                                      heartbeat(QStringLiteral("/c.cpp"))};
+    QCOMPARE(start(transport, heartbeats), HeartbeatTransport::Failed);
+    QCOMPARE(transport.run(heartbeats), HeartbeatTransport::Failed);
+    QCOMPARE(transport.run({heartbeat(QStringLiteral("/a.cpp"))}), HeartbeatTransport::Sent);
+}
+
+void HeartbeatTransportTest::testCliTransportUnavailable() {
+    ProcessRunner runner(5000, 500);
+    BatchedCliTransport transport(runner, []() { return QString(); });
+    QVERIFY(!transport.isAvailable());
+}
+
+void HeartbeatTransportTest::testBatchedArguments() {
+    QByteArray input("stale");
+    const auto single =
+        BatchedCliTransport::arguments({heartbeat(QStringLiteral("/a.cpp"))}, input);
+    QCOMPARE(single, CliTransport::arguments(heartbeat(QStringLiteral("/a.cpp"))));
+    QVERIFY(input.isEmpty());
+
+    const auto batch = BatchedCliTransport::arguments({heartbeat(QStringLiteral("/a.cpp")),
+                                                       heartbeat(QStringLiteral("/b.cpp")),
+                                                       heartbeat(QStringLiteral("/c.cpp"))},
+                                                      input);
+    QCOMPARE(batch.last(), QStringLiteral("--extra-heartbeats"));
+    QCOMPARE(batch.at(batch.indexOf(QStringLiteral("--entity")) + 1), QStringLiteral("/a.cpp"));
+    QVERIFY(input.startsWith('['));
+    QVERIFY(!input.contains("/a.cpp"));
+    QVERIFY(input.contains("/b.cpp"));
+    QVERIFY(input.contains("/c.cpp"));
+}
+
+void HeartbeatTransportTest::testBatchedCliTransport() {
+    QTemporaryDir tempDir;
+    const auto program = createStubCli(tempDir,
+                                       "echo \"$@\" >> \"$(dirname \"$0\")/args.txt\"\n"
+                                       "cat >> \"$(dirname \"$0\")/input.txt\"\n"
+                                       "echo >> \"$(dirname \"$0\")/input.txt\"\n");
+    ProcessRunner runner(5000, 500);
+    BatchedCliTransport transport(runner, [program]() { return program; });
+    QVERIFY(transport.maxBatchSize() > 1000);
+
+    const QList<Heartbeat> heartbeats{heartbeat(QStringLiteral("/a.cpp")),
+                                      heartbeat(QStringLiteral("/b.cpp")),
+                                      heartbeat(QStringLiteral("/c.cpp"))};
+    QCOMPARE(start(transport, heartbeats), HeartbeatTransport::Sent);
+    QCOMPARE(readLines(tempDir.filePath(QStringLiteral("args.txt"))).size(), 1);
+    const auto input = readLines(tempDir.filePath(QStringLiteral("input.txt")));
+    QCOMPARE(input.size(), 1);
+    QVERIFY(input.first().contains("/b.cpp"));
+    QVERIFY(input.first().contains("/c.cpp"));
+
+    // The synchronous path writes standard input too.
+    QCOMPARE(transport.run(heartbeats), HeartbeatTransport::Sent);
+    QCOMPARE(readLines(tempDir.filePath(QStringLiteral("args.txt"))).size(), 2);
+    QCOMPARE(readLines(tempDir.filePath(QStringLiteral("input.txt"))).size(), 2);
+}
+
+void HeartbeatTransportTest::testJournalTransport() {
+    QTemporaryDir tempDir;
+    JournalTransport transport(tempDir.filePath(QStringLiteral("journal.jsonl")));
+    QVERIFY(transport.isAvailable());
+    QCOMPARE(start(transport, {heartbeat(QStringLiteral("/a.cpp"))}), HeartbeatTransport::Sent);
+    QCOMPARE(transport.run({heartbeat(QStringLiteral("/b.cpp")),
+                            heartbeat(QStringLiteral("/c.cpp"))}),
+             HeartbeatTransport::Sent);
+    QCOMPARE(transport.running(), 0);
+    const auto journalled = transport.journal().read(10).heartbeats;
+    QCOMPARE(journalled.size(), 3);
+    QCOMPARE(journalled.at(0).entity, QStringLiteral("/a.cpp"));
+    QCOMPARE(journalled.at(2).entity, QStringLiteral("/c.cpp"));
+}
+
+void HeartbeatTransportTest::testJournalTransportRefusesOfflineJournal() {
+    QTemporaryDir tempDir;
+    const auto oldHome = qgetenv("HOME");
+    qputenv("HOME", tempDir.path().toUtf8());
+    {
+        // WakaTime replays this file, so each heartbeat would be sent again and again.
+        JournalTransport transport(HeartbeatJournal::defaultPath());
+        QVERIFY(!transport.isAvailable());
+        QCOMPARE(transport.run({heartbeat(QStringLiteral("/a.cpp"))}), HeartbeatTransport::Failed);
+        QVERIFY(transport.journal().isEmpty());
+    }
+    QVERIFY(!QFile::exists(HeartbeatJournal::defaultPath()));
+    qputenv("HOME", oldHome);
+}
+
+void HeartbeatTransportTest::testRecordingTransport() {
+    RecordingTransport transport;
+    QCOMPARE(start(transport, {heartbeat(QStringLiteral("/a.cpp"))}), HeartbeatTransport::Sent);
+    transport.setResult(HeartbeatTransport::TimedOut);
+    QCOMPARE(transport.run({heartbeat(QStringLiteral("/b.cpp")),
+                            heartbeat(QStringLiteral("/c.cpp"))}),
+             HeartbeatTransport::TimedOut);
+    QCOMPARE(transport.batches().size(), 2);
+    QCOMPARE(transport.heartbeats().size(), 3);
+    QCOMPARE(transport.heartbeats().at(1).entity, QStringLiteral("/b.cpp"));
+
+    transport.setMaxBatchSize(0);
+    QCOMPARE(transport.maxBatchSize(), 1);
+    transport.setAvailable(false);
+    QVERIFY(!transport.isAvailable());
+    transport.clear();
+    QVERIFY(transport.batches().isEmpty());
+}
+
+QTEST_MAIN(HeartbeatTransportTest)
+
+#include "heartbeattransporttest.moc"
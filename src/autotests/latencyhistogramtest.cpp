@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include "latencyhistogram.h"
+
+class LatencyHistogramTest : public QObject {
+    Q_OBJECT
+
+public:
+    LatencyHistogramTest(QObject *parent = nullptr);
+    ~LatencyHistogramTest() override;
+
+private Q_SLOTS:
+    void testEmpty();
+    void testRecord();
+    void testPercentile();
+    void testToJson();
+    void testTimer();
+};
+
+LatencyHistogramTest::LatencyHistogramTest(QObject *parent) : QObject(parent) {
+}
+
+LatencyHistogramTest::~LatencyHistogramTest() {
+}
+
+void LatencyHistogramTest::testEmpty() {
+    LatencyHistogram histogram;
+    QCOMPARE(histogram.count(), 0U);
+    QCOMPARE(histogram.max(), 0);
+    QCOMPARE(histogram.percentile(99), 0);
+}
+
+void LatencyHistogramTest::testRecord() {
+    LatencyHistogram histogram;
+    histogram.record(0);
+    histogram.record(3);
+    histogram.record(-5);
+    histogram.record(1000);
+    QCOMPARE(histogram.count(), 4U);
+    QCOMPARE(histogram.total(), 1003);
+    QCOMPARE(histogram.max(), 1000);
+    histogram.clear();
+    QCOMPARE(histogram.count(), 0U);
+    QCOMPARE(histogram.total(), 0);
+    QCOMPARE(histogram.max(), 0);
+}
+
+void LatencyHistogramTest::testPercentile() {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 99; ++i) {
+        histogram.record(100);
+    }
+    histogram.record(5000);
+    // 100 µs is in the [64, 128) bucket.
+    QCOMPARE(histogram.percentile(50), 127);
+    QCOMPARE(histogram.percentile(99), 127);
+    // Capped at the maximum instead of the 8191 µs bucket bound.
+    QCOMPARE(histogram.percentile(100), 5000);
+    QCOMPARE(histogram.percentile(0), 127);
+}
+
+void LatencyHistogramTest::testToJson() {
+    LatencyHistogram histogram;
+    histogram.record(1);
+    histogram.record(2);
+    histogram.record(3);
+    const auto json = histogram.toJson();
+    QCOMPARE(json.value(QStringLiteral("count")).toInteger(), 3);
+    QCOMPARE(json.value(QStringLiteral("totalUs")).toInteger(), 6);
+    QCOMPARE(json.value(QStringLiteral("maxUs")).toInteger(), 3);
+    QCOMPARE(json.value(QStringLiteral("p50Us")).toInteger(), 3);
+    const auto buckets = json.value(QStringLiteral("buckets")).toObject();
+    QCOMPARE(buckets.size(), 2);
+    QCOMPARE(buckets.value(QStringLiteral("1")).toInteger(), 1);
+    QCOMPARE(buckets.value(QStringLiteral("3")).toInteger(), 2);
+}
+
+void LatencyHistogramTest::testTimer() {
+    LatencyHistogram histogram;
+    {
+        const LatencyTimer timer(histogram);
+        QTest::qSleep(2);
+    }
+    QCOMPARE(histogram.count(), 1U);
+    QVERIFY(histogram.max() >= 1000);
+}
+
+QTEST_MAIN(LatencyHistogramTest)
+
+#include "latencyhistogramtest.moc"
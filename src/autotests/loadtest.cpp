@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMetaEnum>
+#include <QtCore/QObject>
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+
+#include "fakewakatimeapi.h"
+#include "latencyhistogram.h"
+#include "wakatime.h"
+
+namespace {
+constexpr qsizetype kDefaultDocuments = 2000;
+constexpr qsizetype kDefaultEvents = 10000;
+constexpr qsizetype kDocumentsPerProject = 100;
+constexpr int kDrainTimeoutMs = 120000;
+// Roughly one switch to another document every 20 keystrokes and a save every 50.
+constexpr quint32 kSwitchDocumentOdds = 20;
+constexpr quint32 kSaveOdds = 50;
+constexpr quint32 kSeed = 2026;
+
+qsizetype sizeFromEnvironment(const char *name, qsizetype defaultValue) {
+    bool ok;
+    const auto value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+} // namespace
+
+/**
+ * End-to-end load test. Synthetic editing sessions are replayed through WakaTime::queueHeartbeat(),
+ * the same path the view uses, and the heartbeats travel through `wakatime-cli` to a local
+ * stand-in for the WakaTime API. Each session reports heartbeats received per second, p50 and p99
+ * editor-thread stall per event and how many events were dropped.
+ *
+ * By default the stub CLI built with the tests is used. Set `KATE_WAKATIME_LOAD_CLI` to the path of
+ * a real `wakatime-cli` to measure that instead. `KATE_WAKATIME_LOAD_DOCUMENTS` and
+ * `KATE_WAKATIME_LOAD_EVENTS` change the size of the sessions, and `KATE_WAKATIME_LOAD_REPORT`
+ * names a file to write the reports to as JSON.
+ */
+class WakaTimeLoadTest : public QObject {
+    Q_OBJECT
+
+public:
+    WakaTimeLoadTest(QObject *parent = nullptr);
+    ~WakaTimeLoadTest() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void testFakeApi();
+    void testSession_data();
+    void testSession();
+
+private:
+    /**
+     * Write `~/.wakatime.cfg` pointing at the fake API.
+     *
+     * @return `true` if written.
+     */
+    bool writeConfig();
+    /**
+     * Create documents spread over projects with a `.git` directory each.
+     *
+     * @param count Number of documents.
+     */
+    void createDocuments(qsizetype count);
+
+    QTemporaryDir tempDir;
+    FakeWakaTimeApi api;
+    QStringList documents;
+    QJsonObject reports;
+    QByteArray oldHome;
+    QByteArray oldPath;
+};
+
+WakaTimeLoadTest::WakaTimeLoadTest(QObject *parent)
+    : QObject(parent), oldHome(qgetenv("HOME")), oldPath(qgetenv("PATH")) {
+}
+
+WakaTimeLoadTest::~WakaTimeLoadTest() {
+}
+
+void WakaTimeLoadTest::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    QVERIFY(api.listen());
+    QDir root(tempDir.path());
+    QVERIFY(root.mkdir(QStringLiteral("bin")));
+    auto cli = qEnvironmentVariable("KATE_WAKATIME_LOAD_CLI");
+    if (cli.isEmpty()) {
+        cli = QStringLiteral(FAKE_WAKATIME_CLI_PATH);
+    }
+    QVERIFY2(QFile::exists(cli), qPrintable(cli));
+    QVERIFY(QFile::link(cli, root.filePath(QStringLiteral("bin/wakatime-cli"))));
+    qputenv("HOME", tempDir.path().toUtf8());
+    qputenv("PATH", root.filePath(QStringLiteral("bin")).toUtf8());
+    QVERIFY(writeConfig());
+    createDocuments(sizeFromEnvironment("KATE_WAKATIME_LOAD_DOCUMENTS", kDefaultDocuments));
+    qInfo() << "Sending to" << api.url().toString() << "with" << cli;
+}
+
+void WakaTimeLoadTest::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+    qputenv("PATH", oldPath);
+    const auto reportPath = qEnvironmentVariable("KATE_WAKATIME_LOAD_REPORT");
+    if (reportPath.isEmpty()) {
+        return;
+    }
+    QSaveFile file(reportPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QJsonDocument(reports).toJson());
+    QVERIFY(file.commit());
+}
+
+void WakaTimeLoadTest::init() {
+    // Every session starts without a journal or totals from the previous one.
+    QDir(tempDir.filePath(QStringLiteral(".wakatime"))).removeRecursively();
+    api.clear();
+    api.setStatusCode(0);
+}
+
+bool WakaTimeLoadTest::writeConfig() {
+    QFile file(tempDir.filePath(QStringLiteral(".wakatime.cfg")));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write("[settings]\napi_key = 00000000-0000-4000-8000-000000000000\napi_url = ");
+    file.write(api.url().toEncoded());
+    file.write("\n");
+    return true;
+}
+
+void WakaTimeLoadTest::createDocuments(qsizetype count) {
+    QDir root(tempDir.path());
+    for (qsizetype i = 0; i < count; ++i) {
+        const auto project = QStringLiteral("project-%1").arg(i / kDocumentsPerProject);
+        if (i % kDocumentsPerProject == 0) {
+            root.mkpath(project + QStringLiteral("/.git"));
+        }
+        const auto path = root.filePath(project + QStringLiteral("/file-%1.cpp").arg(i));
+        QFile file(path);
+        file.open(QIODevice::WriteOnly);
+        documents << path;
+    }
+}
+
+void WakaTimeLoadTest::testFakeApi() {
+    WakaTime wakatime;
+    QCOMPARE(wakatime.send(documents.first(), QStringLiteral("C++"), 1, 1, 1, true),
+             WakaTime::SentSuccessfully);
+    QCOMPARE(api.heartbeats(), 1);
+    QVERIFY(api.lastAuthorization().startsWith("Basic "));
+
+    api.setStatusCode(500);
+    QCOMPARE(wakatime.send(documents.last(), QStringLiteral("C++"), 1, 1, 1, true),
+             WakaTime::ErrorSending);
+    QCOMPARE(api.heartbeats(), 1);
+}
+
+void WakaTimeLoadTest::testSession_data() {
+    QTest::addColumn<qint64>("throttleMs");
+    QTest::addColumn<int>("statusCode");
+    QTest::addColumn<qsizetype>("events");
+    const auto events = sizeFromEnvironment("KATE_WAKATIME_LOAD_EVENTS", kDefaultEvents);
+    // Heartbeats for the same file are throttled as in Kate, so most keystrokes are cheap.
+    QTest::newRow("typing") << qint64(120000) << 0 << events;
+    // Every keystroke is a heartbeat, which fills the queue and measures peak throughput.
+    QTest::newRow("unthrottled") << qint64(0) << 0 << events;
+    // The API fails, so heartbeats are journalled and the circuit breaker opens.
+    QTest::newRow("api errors") << qint64(0) << 500 << qMin<qsizetype>(events, 1000);
+}
+
+void WakaTimeLoadTest::testSession() {
+    QFETCH(qint64, throttleMs);
+    QFETCH(int, statusCode);
+    QFETCH(qsizetype, events);
+    api.setStatusCode(statusCode);
+
+    // Declared first as heartbeats still queued are reported when WakaTime is destroyed.
+    QHash<WakaTime::State, qsizetype> reported;
+    qsizetype reportedTotal = 0;
+    WakaTime wakatime;
+    wakatime.setThrottleInterval(throttleMs);
+    connect(&wakatime,
+            &WakaTime::sendFinished,
+            this,
+            [&reported, &reportedTotal](WakaTime::State state) {
+                ++reported[state];
+                ++reportedTotal;
+            });
+
+    QRandomGenerator random(kSeed);
+    LatencyHistogram stall;
+    auto document = documents.first();
+    int line = 1;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (qsizetype i = 0; i < events; ++i) {
+        if (random.bounded(kSwitchDocumentOdds) == 0) {
+            document = documents.at(random.bounded(documents.size()));
+            line = int(random.bounded(1000)) + 1;
+        }
+        line += int(random.bounded(3));
+        const auto isWrite = random.bounded(kSaveOdds) == 0;
+        // The time the editor thread is busy for one event, including handling processes that
+        // finished in the meantime.
+        const LatencyTimer timer(stall);
+        wakatime.queueHeartbeat(document, QStringLiteral("C++"), line, 1, 1000, isWrite);
+        QCoreApplication::processEvents();
+    }
+    wakatime.flush();
+    QTRY_VERIFY_WITH_TIMEOUT(reportedTotal == events, kDrainTimeoutMs);
+    const auto elapsedMs = qMax<qint64>(elapsed.elapsed(), 1);
+    QTRY_VERIFY_WITH_TIMEOUT(wakatime.metrics().value(QStringLiteral("processes")).toInteger() == 0,
+                             kDrainTimeoutMs);
+
+    QJsonObject states;
+    const auto stateEnum = QMetaEnum::fromType<WakaTime::State>();
+    for (auto it = reported.cbegin(); it != reported.cend(); ++it) {
+        states.insert(QString::fromLatin1(stateEnum.valueToKey(it.key())), it.value());
+    }
+    const QJsonObject report{
+        {QStringLiteral("documents"), documents.size()},
+        {QStringLiteral("events"), events},
+        {QStringLiteral("elapsedMs"), elapsedMs},
+        {QStringLiteral("requests"), api.requests()},
+        {QStringLiteral("heartbeatsReceived"), api.heartbeats()},
+        {QStringLiteral("heartbeatsPerSecond"), double(api.heartbeats()) * 1000.0 / elapsedMs},
+        {QStringLiteral("stallP50Us"), stall.percentile(50)},
+        {QStringLiteral("stallP99Us"), stall.percentile(99)},
+        {QStringLiteral("stallMaxUs"), stall.max()},
+        {QStringLiteral("dropped"), reported.value(WakaTime::Dropped)},
+        {QStringLiteral("states"), states},
+        {QStringLiteral("metrics"), wakatime.metrics()},
+    };
+    reports.insert(QString::fromLatin1(QTest::currentDataTag()), report);
+    qInfo().noquote() << QTest::currentDataTag()
+                      << QJsonDocument(report).toJson(QJsonDocument::Compact);
+
+    if (statusCode == 0) {
+        QCOMPARE(reported.value(WakaTime::ErrorSending), 0);
+        QVERIFY(reported.value(WakaTime::SentSuccessfully) > 0);
+        // A real CLI may also send heartbeats it queued offline earlier.
+        QVERIFY(api.heartbeats() >= reported.value(WakaTime::SentSuccessfully));
+    } else {
+        QCOMPARE(reported.value(WakaTime::SentSuccessfully), 0);
+        QVERIFY(reported.value(WakaTime::BackingOff) > 0);
+    }
+}
+
+QTEST_MAIN(WakaTimeLoadTest)
+
+#include "loadtest.moc"
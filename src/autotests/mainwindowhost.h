@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <KTextEditor/MainWindow>
+#include <KTextEditor/View>
+
+#include <KXmlGuiWindow>
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+
+/**
+ * Stands in for Kate's main window. KTextEditor::MainWindow forwards its calls to the slots of
+ * this object. Tests emit the signals of `mainWindow` as Kate would.
+ */
+class MainWindowHost : public QObject {
+    Q_OBJECT
+
+public:
+    MainWindowHost() : mainWindow(new KTextEditor::MainWindow(this)) {
+    }
+    ~MainWindowHost() override {
+        // Views of the main window still need the GUI factory while they are destroyed.
+        delete mainWindow;
+    }
+
+    KTextEditor::MainWindow *mainWindow;
+    KXmlGuiWindow guiWindow;
+    // Returned by views() and activeView().
+    QList<KTextEditor::View *> openViews;
+    KTextEditor::View *currentView = nullptr;
+
+public Q_SLOTS:
+    QWidget *window() {
+        return &guiWindow;
+    }
+    KXMLGUIFactory *guiFactory() {
+        return guiWindow.guiFactory();
+    }
+    QList<KTextEditor::View *> views() {
+        return openViews;
+    }
+    KTextEditor::View *activeView() {
+        return currentView;
+    }
+};
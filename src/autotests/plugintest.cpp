@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: MIT
+#include <KTextEditor/Cursor>
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+
+#include <QtCore/QFile>
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QUrl>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include <memory>
+
+#include "heartbeattransport.h"
+#include "mainwindowhost.h"
+#include "wakatimeplugin.h"
+
+/**
+ * Tests for the plugin's record of which documents have views in each main window. The main
+ * window signals are emitted by the test as Kate would.
+ */
+class WakaTimePluginTest : public QObject {
+    Q_OBJECT
+
+public:
+    WakaTimePluginTest(QObject *parent = nullptr);
+    ~WakaTimePluginTest() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+    void testActiveViewCursor();
+    void testDocumentConnectedOnce();
+    void testDuplicateViewCreated();
+    void testExistingViews();
+    void testLastViewDestroyed();
+    void testMainWindowClosed();
+
+private:
+    /**
+     * Create the plugin view for a main window.
+     *
+     * @param host Main window.
+     * @return The plugin view.
+     */
+    std::unique_ptr<WakaTimeView> createView(MainWindowHost &host);
+    /**
+     * Create a view of the test document.
+     *
+     * @return The view.
+     */
+    std::unique_ptr<KTextEditor::View> createDocumentView();
+
+    QTemporaryDir tempDir;
+    QByteArray oldHome;
+    QString filePath;
+    std::unique_ptr<WakaTimePlugin> plugin;
+    std::unique_ptr<KTextEditor::Document> document;
+};
+
+WakaTimePluginTest::WakaTimePluginTest(QObject *parent)
+    : QObject(parent), oldHome(qgetenv("HOME")) {
+}
+
+WakaTimePluginTest::~WakaTimePluginTest() {
+}
+
+void WakaTimePluginTest::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    // Keep the user's configuration and journal out of the tests.
+    qputenv("HOME", tempDir.path().toUtf8());
+    filePath = tempDir.filePath(QStringLiteral("document.cpp"));
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("int a;\nint b;\nint main() {}\n");
+}
+
+void WakaTimePluginTest::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+}
+
+void WakaTimePluginTest::init() {
+    plugin = std::make_unique<WakaTimePlugin>();
+    plugin->client().setTransport(std::make_unique<RecordingTransport>());
+    document.reset(KTextEditor::Editor::instance()->createDocument(nullptr));
+    QVERIFY(document->openUrl(QUrl::fromLocalFile(filePath)));
+}
+
+void WakaTimePluginTest::cleanup() {
+    document.reset();
+    plugin.reset();
+}
+
+std::unique_ptr<WakaTimeView> WakaTimePluginTest::createView(MainWindowHost &host) {
+    return std::unique_ptr<WakaTimeView>(
+        static_cast<WakaTimeView *>(plugin->createView(host.mainWindow)));
+}
+
+std::unique_ptr<KTextEditor::View> WakaTimePluginTest::createDocumentView() {
+    return std::unique_ptr<KTextEditor::View>(document->createView(nullptr));
+}
+
+void WakaTimePluginTest::testActiveViewCursor() {
+    MainWindowHost host;
+    auto first = createDocumentView();
+    auto second = createDocumentView();
+    first->setCursorPosition(KTextEditor::Cursor(0, 0));
+    second->setCursorPosition(KTextEditor::Cursor(2, 4));
+    auto view = createView(host);
+    Q_EMIT host.mainWindow->viewCreated(first.get());
+    Q_EMIT host.mainWindow->viewCreated(second.get());
+
+    Q_EMIT host.mainWindow->viewChanged(first.get());
+    auto state = view->documentState(document.get());
+    QVERIFY(state);
+    QCOMPARE(state->filePath, filePath);
+    QCOMPARE(state->line, 1);
+    QCOMPARE(state->column, 1);
+    QCOMPARE(state->linesInFile, document->lines());
+
+    Q_EMIT host.mainWindow->viewChanged(second.get());
+    state = view->documentState(document.get());
+    QVERIFY(state);
+    QCOMPARE(state->line, 3);
+    QCOMPARE(state->column, 5);
+
+    // The remaining view is used once the active one is closed.
+    second.reset();
+    state = view->documentState(document.get());
+    QVERIFY(state);
+    QCOMPARE(state->line, 1);
+}
+
+void WakaTimePluginTest::testDocumentConnectedOnce() {
+    MainWindowHost host;
+    auto first = createDocumentView();
+    auto second = createDocumentView();
+    auto view = createView(host);
+    Q_EMIT host.mainWindow->viewCreated(first.get());
+    Q_EMIT host.mainWindow->viewCreated(second.get());
+    QCOMPARE(view->documentViews.value(document.get()).size(), 2);
+    QCOMPARE(plugin->m_pathUsers.value(filePath), 1);
+
+    QSignalSpy spy(&view->activity, &EditorActivity::actionSent);
+    Q_EMIT document->modifiedChanged(document.get());
+    QCOMPARE(spy.count(), 1);
+}
+
+void WakaTimePluginTest::testDuplicateViewCreated() {
+    MainWindowHost host;
+    auto documentView = createDocumentView();
+    host.openViews = {documentView.get()};
+    auto view = createView(host);
+    // Already registered from views().
+    Q_EMIT host.mainWindow->viewCreated(documentView.get());
+    QCOMPARE(view->documentViews.value(document.get()).size(), 1);
+    QCOMPARE(view->viewDocuments.size(), 1);
+    QCOMPARE(plugin->m_pathUsers.value(filePath), 1);
+}
+
+void WakaTimePluginTest::testExistingViews() {
+    MainWindowHost host;
+    auto first = createDocumentView();
+    auto second = createDocumentView();
+    second->setCursorPosition(KTextEditor::Cursor(1, 0));
+    host.openViews = {first.get(), second.get()};
+    host.currentView = first.get();
+    auto view = createView(host);
+    const QList<KTextEditor::View *> expected{second.get(), first.get()};
+    QCOMPARE(view->documentViews.value(document.get()), expected);
+    QCOMPARE(view->documentPaths.value(document.get()), filePath);
+    QCOMPARE(view->documentState(document.get())->line, 1);
+}
+
+void WakaTimePluginTest::testLastViewDestroyed() {
+    MainWindowHost host;
+    auto first = createDocumentView();
+    auto second = createDocumentView();
+    auto view = createView(host);
+    Q_EMIT host.mainWindow->viewCreated(first.get());
+    Q_EMIT host.mainWindow->viewCreated(second.get());
+    QSignalSpy spy(&view->activity, &EditorActivity::actionSent);
+
+    first.reset();
+    QCOMPARE(view->documentViews.value(document.get()).size(), 1);
+    Q_EMIT document->modifiedChanged(document.get());
+    QCOMPARE(spy.count(), 1);
+
+    Q_EMIT document->textChanged(document.get());
+    QVERIFY(view->activity.isPending());
+    second.reset();
+    QVERIFY(!view->documentViews.contains(document.get()));
+    QVERIFY(!view->documentPaths.contains(document.get()));
+    QVERIFY(view->viewDocuments.isEmpty());
+    QVERIFY(!plugin->m_pathUsers.contains(filePath));
+    QVERIFY(!view->activity.isPending());
+    Q_EMIT document->modifiedChanged(document.get());
+    QCOMPARE(spy.count(), 1);
+}
+
+void WakaTimePluginTest::testMainWindowClosed() {
+    MainWindowHost firstHost;
+    MainWindowHost secondHost;
+    auto firstDocumentView = createDocumentView();
+    auto secondDocumentView = createDocumentView();
+    auto firstView = createView(firstHost);
+    auto secondView = createView(secondHost);
+    Q_EMIT firstHost.mainWindow->viewCreated(firstDocumentView.get());
+    Q_EMIT secondHost.mainWindow->viewCreated(secondDocumentView.get());
+    QCOMPARE(plugin->m_pathUsers.value(filePath), 2);
+
+    // Kate deletes the plugin view before the views of the closing main window.
+    firstView.reset();
+    firstDocumentView.reset();
+    QCOMPARE(plugin->m_pathUsers.value(filePath), 1);
+    QSignalSpy spy(&secondView->activity, &EditorActivity::actionSent);
+    Q_EMIT document->modifiedChanged(document.get());
+    QCOMPARE(spy.count(), 1);
+
+    secondView.reset();
+    secondDocumentView.reset();
+    QVERIFY(plugin->m_pathUsers.isEmpty());
+}
+
+QTEST_MAIN(WakaTimePluginTest)
+
+#include "plugintest.moc"
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include <optional>
+
+#include "processrunner.h"
+
+class ProcessRunnerTest : public QObject {
+    Q_OBJECT
+
+public:
+    ProcessRunnerTest(QObject *parent = nullptr);
+    ~ProcessRunnerTest() override;
+
+private Q_SLOTS:
+    void testStart_data();
+    void testStart();
+    void testStartFailedToStart();
+    void testStartKillsProcessIgnoringTerminate();
+    void testRun_data();
+    void testRun();
+
+private:
+    /**
+     * Run a shell script body with ProcessRunner::start() and wait for the result.
+     *
+     * @param runner Runner to use.
+     * @param body Shell script.
+     * @return The result, or `std::nullopt` if none was reported within 10 seconds.
+     */
+    std::optional<ProcessRunner::Result> start(ProcessRunner &runner, const QString &body);
+};
+
+ProcessRunnerTest::ProcessRunnerTest(QObject *parent) : QObject(parent) {
+}
+
+ProcessRunnerTest::~ProcessRunnerTest() {
+}
+
+std::optional<ProcessRunner::Result> ProcessRunnerTest::start(ProcessRunner &runner,
+                                                              const QString &body) {
+    std::optional<ProcessRunner::Result> result;
+    runner.start(QStringLiteral("/bin/sh"),
+                 {QStringLiteral("-c"), body},
+                 QByteArray(),
+                 [&result](ProcessRunner::Result r) { result = r; });
+    QTest::qWaitFor([&result]() { return result.has_value(); }, 10000);
+    return result;
+}
+
+void ProcessRunnerTest::testStart_data() {
+    QTest::addColumn<QString>("body");
+    QTest::addColumn<ProcessRunner::Result>("result");
+    QTest::newRow("succeeded") << QStringLiteral("exit 0") << ProcessRunner::Succeeded;
+    QTest::newRow("failed") << QStringLiteral("exit 1") << ProcessRunner::Failed;
+    QTest::newRow("deferred") << QStringLiteral("exit 102") << ProcessRunner::Deferred;
+    QTest::newRow("timed out") << QStringLiteral("exec sleep 10") << ProcessRunner::TimedOut;
+}
+
+void ProcessRunnerTest::testStart() {
+    QFETCH(QString, body);
+    QFETCH(ProcessRunner::Result, result);
+    ProcessRunner runner(500, 500);
+    runner.setDeferredExitCodes({102});
+    QElapsedTimer timer;
+    timer.start();
+    const auto actual = start(runner, body);
+    QVERIFY(actual);
+    QCOMPARE(*actual, result);
+    QVERIFY(timer.elapsed() < 5000);
+    QCOMPARE(runner.running(), 0);
+}
+
+void ProcessRunnerTest::testStartFailedToStart() {
+    ProcessRunner runner(500, 500);
+    std::optional<ProcessRunner::Result> result;
+    runner.start(QStringLiteral("/non/existent/program"),
+                 {},
+                 QByteArray(),
+                 [&result](ProcessRunner::Result r) { result = r; });
+    QTRY_VERIFY(result.has_value());
+    QCOMPARE(*result, ProcessRunner::Failed);
+    QCOMPARE(runner.running(), 0);
+}
+
+void ProcessRunnerTest::testStartKillsProcessIgnoringTerminate() {
+    ProcessRunner runner(200, 200);
+    QElapsedTimer timer;
+    timer.start();
+    const auto actual = start(runner, QStringLiteral("trap '' TERM; sleep 10"));
+    QVERIFY(actual);
+    QCOMPARE(*actual, ProcessRunner::TimedOut);
+    QVERIFY(timer.elapsed() < 5000);
+}
+
+void ProcessRunnerTest::testRun_data() {
+    testStart_data();
+    QTest::newRow("ignores terminate")
+        << QStringLiteral("trap '' TERM; sleep 10") << ProcessRunner::TimedOut;
+}
+
+void ProcessRunnerTest::testRun() {
+    QFETCH(QString, body);
+    QFETCH(ProcessRunner::Result, result);
+    ProcessRunner runner(500, 500);
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(runner.run(QStringLiteral("/bin/sh"), {QStringLiteral("-c"), body}), result);
+    QVERIFY(timer.elapsed() < 5000);
+}
+
+QTEST_MAIN(ProcessRunnerTest)
+
+#include "processrunnertest.moc"
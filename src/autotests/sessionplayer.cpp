@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+#include <utility>
+
+#include "sessionplayer.h"
+
+SessionPlayer::SessionPlayer(WakaTime &client, QObject *parent)
+    : QObject(parent), client_(client) {
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &SessionPlayer::replayDue);
+}
+
+SessionPlayer::~SessionPlayer() {
+}
+
+bool SessionPlayer::load(const QString &path) {
+    auto events = SessionRecorder::read(path);
+    if (!events) {
+        return false;
+    }
+    setEvents(std::move(*events));
+    return true;
+}
+
+void SessionPlayer::setEvents(QList<EditorEvent> events) {
+    stop();
+    events_ = std::move(events);
+}
+
+const QList<EditorEvent> &SessionPlayer::events() const {
+    return events_;
+}
+
+void SessionPlayer::start(double speed) {
+    stop();
+    speed_ = qMax(speed, 0.0);
+    next_ = 0;
+    actions_ = 0;
+    running_ = true;
+    const auto scaled = [this](int ms) { return speed_ > 0 ? int(ms / speed_) : 0; };
+    activity_ = new EditorActivity(
+        client_,
+        [this](QObject *document) -> std::optional<DocumentState> {
+            const auto it = states_.constFind(document);
+            if (it == states_.cend()) {
+                return std::nullopt;
+            }
+            return *it;
+        },
+        scaled(kTextChangedDelayMs),
+        scaled(kTextChangedMaxWaitMs),
+        this);
+    connect(activity_, &EditorActivity::actionSent, this, [this](QObject *document, bool isWrite) {
+        ++actions_;
+        Q_EMIT actionSent(states_.value(document), isWrite);
+        finishIfDone();
+    });
+    clock_.start();
+    replayDue();
+}
+
+void SessionPlayer::stop() {
+    timer_.stop();
+    running_ = false;
+    if (!activity_) {
+        return;
+    }
+    for (auto document : std::as_const(documents_)) {
+        activity_->cancel(document);
+    }
+    // May be called from one of its signals.
+    activity_->deleteLater();
+    activity_ = nullptr;
+}
+
+bool SessionPlayer::isRunning() const {
+    return running_;
+}
+
+qsizetype SessionPlayer::replayed() const {
+    return next_;
+}
+
+qsizetype SessionPlayer::actions() const {
+    return actions_;
+}
+
+void SessionPlayer::replayDue() {
+    while (running_ && next_ < events_.size()) {
+        const auto &event = events_.at(next_);
+        if (speed_ > 0) {
+            const auto dueMs = qint64(double(event.timeMs - events_.first().timeMs) / speed_);
+            const auto elapsedMs = clock_.elapsed();
+            if (dueMs > elapsedMs) {
+                timer_.start(int(dueMs - elapsedMs));
+                return;
+            }
+        }
+        auto &document = documents_[event.document.filePath];
+        if (!document) {
+            document = new QObject(this);
+        }
+        states_.insert(document, event.document);
+        ++next_;
+        activity_->handle(document, event.type);
+        if (speed_ == 0 && next_ < events_.size()) {
+            // Let the event loop run between events, as it would while typing.
+            timer_.start(0);
+            return;
+        }
+    }
+    finishIfDone();
+}
+
+void SessionPlayer::finishIfDone() {
+    if (running_ && next_ == events_.size() && !activity_->isPending()) {
+        running_ = false;
+        Q_EMIT finished();
+    }
+}
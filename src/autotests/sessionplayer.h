@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+
+#include "editoractivity.h"
+#include "sessionrecorder.h"
+
+class WakaTime;
+
+/**
+ * Replays a recorded editing session through EditorActivity, the path WakaTimeView uses, so the
+ * cost of handling document signals can be profiled without typing. Each recorded document is
+ * stood in for by a plain object whose state is taken from the event being replayed.
+ */
+class SessionPlayer : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param client Client to send heartbeats with. Must outlive this object.
+     * @param parent Parent object.
+     */
+    explicit SessionPlayer(WakaTime &client, QObject *parent = nullptr);
+    ~SessionPlayer() override;
+    /**
+     * Read a recording written by SessionRecorder.
+     *
+     * @param path File path.
+     * @return `true` if read.
+     */
+    bool load(const QString &path);
+    /**
+     * Set the events to replay, oldest first.
+     *
+     * @param events The events.
+     */
+    void setEvents(QList<EditorEvent> events);
+    /**
+     * Get the events to replay.
+     *
+     * @return The events.
+     */
+    const QList<EditorEvent> &events() const;
+    /**
+     * Start replaying from the first event. The gaps between events and the text change debounce
+     * delays are divided by @p speed.
+     *
+     * @param speed 1 for the original speed, 10 for ten times faster, or 0 to replay every event
+     * straight away with no debounce delay.
+     */
+    void start(double speed = 1);
+    /** Stop replaying. Heartbeats still waiting for a pause are not sent. */
+    void stop();
+    /**
+     * Check if a replay is in progress.
+     *
+     * @return `true` until finished() is emitted or stop() is called.
+     */
+    bool isRunning() const;
+    /**
+     * Get the number of events replayed so far.
+     *
+     * @return Number of events.
+     */
+    qsizetype replayed() const;
+    /**
+     * Get the number of heartbeats queued with the client so far.
+     *
+     * @return Number of heartbeats.
+     */
+    qsizetype actions() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted after a heartbeat has been queued with the client.
+     *
+     * @param document State of the document the heartbeat was queued with.
+     * @param isWrite Whether the heartbeat is a write.
+     */
+    void actionSent(const DocumentState &document, bool isWrite);
+    /** Emitted once every event has been replayed and every resulting heartbeat queued. */
+    void finished();
+
+private:
+    /** Replay the events that are due and schedule the next one. */
+    void replayDue();
+    /** Emit finished() if nothing is left to do. */
+    void finishIfDone();
+
+    WakaTime &client_;
+    QList<EditorEvent> events_;
+    // Stand-in object for each file path and the state last replayed for it.
+    QHash<QString, QObject *> documents_;
+    QHash<QObject *, DocumentState> states_;
+    // Replaced for every replay as the debounce delays depend on the speed.
+    EditorActivity *activity_ = nullptr;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    double speed_ = 1;
+    qsizetype next_ = 0;
+    qsizetype actions_ = 0;
+    bool running_ = false;
+};
@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QSignalSpy>
+#include <QtTest/QTest>
+
+#include <memory>
+#include <utility>
+
+#include "editoractivity.h"
+#include "sessionplayer.h"
+#include "sessionrecorder.h"
+#include "wakatime.h"
+
+namespace {
+// Magic, version and start time.
+constexpr qint64 kHeaderSize = 14;
+constexpr qint64 kEventSize = 21;
+} // namespace
+
+/**
+ * Tests for recording and replaying editing sessions. `benchmarkReplay` replays the recording
+ * named by `KATE_WAKATIME_REPLAY_FILE`, or a synthetic one, as fast as possible so profiles of the
+ * signal handling path can be compared between builds.
+ */
+class SessionTest : public QObject {
+    Q_OBJECT
+
+public:
+    SessionTest(QObject *parent = nullptr);
+    ~SessionTest() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void testRecordRead();
+    void testReadTruncated();
+    void testReadInvalid();
+    void testActivityRecords();
+    void testReplaySpeed();
+    void testReplayDeterministic();
+    void benchmarkReplay();
+
+private:
+    /**
+     * Create a client that records heartbeats instead of sending them.
+     *
+     * @param[out] recording Set to the transport.
+     * @return The client.
+     */
+    std::unique_ptr<WakaTime> createClient(RecordingTransport *&recording);
+    /**
+     * Create a session of @p count events over a few files, @p gapMs apart.
+     *
+     * @param count Number of events.
+     * @param gapMs Time between events.
+     * @return The events.
+     */
+    QList<EditorEvent> createSession(qsizetype count, qint64 gapMs);
+
+    QTemporaryDir tempDir;
+    QStringList files;
+    QByteArray oldHome;
+};
+
+SessionTest::SessionTest(QObject *parent) : QObject(parent), oldHome(qgetenv("HOME")) {
+}
+
+SessionTest::~SessionTest() {
+}
+
+void SessionTest::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    qputenv("HOME", tempDir.path().toUtf8());
+    QDir root(tempDir.path());
+    root.mkpath(QStringLiteral("project/.git"));
+    for (const auto &name :
+         {QStringLiteral("main.cpp"), QStringLiteral("util.cpp"), QStringLiteral("README.md")}) {
+        const auto path = root.filePath(QStringLiteral("project/") + name);
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        files << path;
+    }
+}
+
+void SessionTest::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+}
+
+std::unique_ptr<WakaTime> SessionTest::createClient(RecordingTransport *&recording) {
+    auto transport = std::make_unique<RecordingTransport>();
+    recording = transport.get();
+    auto client = std::make_unique<WakaTime>();
+    client->setTransport(std::move(transport));
+    // Every heartbeat is passed on straight away so they can be compared.
+    client->setThrottleInterval(0);
+    client->setBatchSize(1);
+    return client;
+}
+
+QList<EditorEvent> SessionTest::createSession(qsizetype count, qint64 gapMs) {
+    QList<EditorEvent> events;
+    const auto startMs = QDateTime::currentMSecsSinceEpoch();
+    for (qsizetype i = 0; i < count; ++i) {
+        EditorEvent event;
+        // Mostly typing, with a save every tenth event.
+        event.type = i % 10 == 9 ? EditorEvent::Saved : EditorEvent::TextChanged;
+        event.timeMs = startMs + i * gapMs;
+        event.document.filePath = files.at((i / 5) % files.size());
+        event.document.mode = QStringLiteral("C++");
+        event.document.line = int(i) + 1;
+        event.document.column = int(i % 80) + 1;
+        event.document.linesInFile = 100 + int(i);
+        events << event;
+    }
+    return events;
+}
+
+void SessionTest::testRecordRead() {
+    const auto path = tempDir.filePath(QStringLiteral("sessions/record.kwsr"));
+    QList<EditorEvent> events;
+    {
+        // Created first as events from before the recorder are moved to its start time.
+        SessionRecorder recorder(path);
+        QVERIFY(recorder.isOpen());
+        events = createSession(20, 7);
+        events[3].type = EditorEvent::ModifiedChanged;
+        events[4].document.mode = QStringLiteral("Markdown");
+        for (const auto &event : std::as_const(events)) {
+            recorder.record(event);
+        }
+        QCOMPARE(recorder.size(), events.size());
+    }
+    const auto read = SessionRecorder::read(path);
+    QVERIFY(read);
+    QCOMPARE(*read, events);
+
+    // Each document is written once, the rest is a fixed size per event.
+    qint64 documentsSize = 0;
+    for (const auto &[filePath, mode] : {std::pair(files.at(0), QStringLiteral("C++")),
+                                        std::pair(files.at(0), QStringLiteral("Markdown")),
+                                        std::pair(files.at(1), QStringLiteral("C++")),
+                                        std::pair(files.at(2), QStringLiteral("C++"))}) {
+        documentsSize += 1 + 4 + 4 + filePath.size() * 2 + 4 + mode.size() * 2;
+    }
+    QCOMPARE(QFileInfo(path).size(), kHeaderSize + documentsSize + events.size() * kEventSize);
+}
+
+void SessionTest::testReadTruncated() {
+    const auto path = tempDir.filePath(QStringLiteral("truncated.kwsr"));
+    QList<EditorEvent> events;
+    {
+        SessionRecorder recorder(path);
+        events = createSession(5, 10);
+        for (const auto &event : events) {
+            recorder.record(event);
+        }
+    }
+    QVERIFY(QFile::resize(path, QFileInfo(path).size() - 3));
+    const auto read = SessionRecorder::read(path);
+    QVERIFY(read);
+    QCOMPARE(*read, events.mid(0, 4));
+}
+
+void SessionTest::testReadInvalid() {
+    QVERIFY(!SessionRecorder::read(tempDir.filePath(QStringLiteral("missing.kwsr"))));
+    const auto path = tempDir.filePath(QStringLiteral("invalid.kwsr"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"not\": \"a recording\"}\n");
+    file.close();
+    QVERIFY(!SessionRecorder::read(path));
+}
+
+void SessionTest::testActivityRecords() {
+    RecordingTransport *recording;
+    auto client = createClient(recording);
+    QObject document;
+    DocumentState state{files.first(), QStringLiteral("C++"), 1, 1, 10};
+    EditorActivity activity(
+        *client,
+        [&document, &state](QObject *object) -> std::optional<DocumentState> {
+            if (object != &document) {
+                return std::nullopt;
+            }
+            return state;
+        },
+        50,
+        1000);
+    QSignalSpy spy(&activity, &EditorActivity::actionSent);
+    const auto path = tempDir.filePath(QStringLiteral("activity.kwsr"));
+    SessionRecorder recorder(path);
+    activity.setRecorder(&recorder);
+
+    for (auto line = 1; line <= 3; ++line) {
+        state.line = line;
+        activity.handle(&document, EditorEvent::TextChanged);
+    }
+    QVERIFY(activity.isPending());
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(spy.wait());
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!activity.isPending());
+    activity.handle(&document, EditorEvent::Saved);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(1).at(1).toBool(), true);
+    // Documents without a view are ignored.
+    QObject other;
+    activity.handle(&other, EditorEvent::ModifiedChanged);
+    QCOMPARE(spy.count(), 2);
+
+    QCOMPARE(recorder.size(), 4);
+    recorder.flush();
+    const auto read = SessionRecorder::read(path);
+    QVERIFY(read);
+    QCOMPARE(read->size(), 4);
+    QCOMPARE(read->at(2).document.line, 3);
+    QCOMPARE(read->at(3).type, EditorEvent::Saved);
+    QCOMPARE(recording->heartbeats().size(), 2);
+    QCOMPARE(recording->heartbeats().first().lineNumber, 3);
+    QVERIFY(recording->heartbeats().last().isWrite);
+}
+
+void SessionTest::testReplaySpeed() {
+    RecordingTransport *recording;
+    auto client = createClient(recording);
+    SessionPlayer player(*client);
+    QSignalSpy spy(&player, &SessionPlayer::finished);
+    // Twenty events over 950 ms.
+    player.setEvents(createSession(20, 50));
+
+    QElapsedTimer timer;
+    timer.start();
+    player.start(10);
+    QVERIFY(player.isRunning());
+    QVERIFY(spy.wait());
+    // The events take 95 ms at ten times the speed, followed by the scaled debounce delay.
+    QVERIFY(timer.elapsed() >= 95);
+    QCOMPARE(player.replayed(), 20);
+    QVERIFY(!player.isRunning());
+    // At least the two saves.
+    QVERIFY(player.actions() >= 2);
+    QVERIFY(!recording->heartbeats().isEmpty());
+
+    timer.restart();
+    player.start(0);
+    QVERIFY(spy.wait());
+    QVERIFY(timer.elapsed() < 95 * 10);
+    QCOMPARE(player.replayed(), 20);
+}
+
+void SessionTest::testReplayDeterministic() {
+    const auto path = tempDir.filePath(QStringLiteral("replay.kwsr"));
+    {
+        SessionRecorder recorder(path);
+        for (const auto &event : createSession(50, 20)) {
+            recorder.record(event);
+        }
+    }
+    // What reaches the client, not what it sends, as its throttle depends on the clock.
+    QList<QList<std::pair<DocumentState, bool>>> runs;
+    for (auto run = 0; run < 2; ++run) {
+        RecordingTransport *recording;
+        auto client = createClient(recording);
+        SessionPlayer player(*client);
+        QVERIFY(player.load(path));
+        QCOMPARE(player.events().size(), 50);
+        QList<std::pair<DocumentState, bool>> actions;
+        connect(&player,
+                &SessionPlayer::actionSent,
+                this,
+                [&actions](const DocumentState &document, bool isWrite) {
+                    actions.append({document, isWrite});
+                });
+        QSignalSpy spy(&player, &SessionPlayer::finished);
+        player.start(0);
+        QVERIFY(spy.wait());
+        QCOMPARE(actions.size(), player.actions());
+        runs << actions;
+    }
+    QVERIFY(!runs.first().isEmpty());
+    QVERIFY(runs.at(0) == runs.at(1));
+}
+
+void SessionTest::benchmarkReplay() {
+    RecordingTransport *recording;
+    auto client = createClient(recording);
+    SessionPlayer player(*client);
+    const auto path = qEnvironmentVariable("KATE_WAKATIME_REPLAY_FILE");
+    if (path.isEmpty()) {
+        player.setEvents(createSession(1000, 10));
+    } else {
+        QVERIFY2(player.load(path), qPrintable(path));
+    }
+    QSignalSpy spy(&player, &SessionPlayer::finished);
+    QBENCHMARK {
+        player.start(0);
+        QVERIFY(spy.wait(60000));
+    }
+}
+
+QTEST_MAIN(SessionTest)
+
+#include "sessiontest.moc"
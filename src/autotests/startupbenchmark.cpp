@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+#include <KTextEditor/Plugin>
+
+#include <KPluginFactory>
+#include <KPluginMetaData>
+
+#include <QtCore/QObject>
+#include <QtCore/QTemporaryDir>
+#include <QtTest/QTest>
+#include <QtWidgets/QDialog>
+
+#include <memory>
+
+#include "mainwindowhost.h"
+
+/**
+ * Benchmarks for the cost the plugin adds to Kate's start-up: loading the plugin library,
+ * creating the plugin and creating its view for a main window.
+ */
+class WakaTimeStartupBenchmark : public QObject {
+    Q_OBJECT
+
+public:
+    WakaTimeStartupBenchmark(QObject *parent = nullptr);
+    ~WakaTimeStartupBenchmark() override;
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkLoadPlugin();
+    void benchmarkCreatePlugin();
+    void benchmarkCreateView();
+    void testCreateViewDoesNotCreateDialog();
+
+private:
+    /**
+     * Load the plugin library and create the plugin.
+     *
+     * @return The plugin.
+     */
+    std::unique_ptr<KTextEditor::Plugin> createPlugin();
+
+    QTemporaryDir tempDir;
+    QByteArray oldHome;
+};
+
+WakaTimeStartupBenchmark::WakaTimeStartupBenchmark(QObject *parent)
+    : QObject(parent), oldHome(qgetenv("HOME")) {
+}
+
+WakaTimeStartupBenchmark::~WakaTimeStartupBenchmark() {
+}
+
+void WakaTimeStartupBenchmark::initTestCase() {
+    QVERIFY(tempDir.isValid());
+    // Keep the user's configuration and journal out of the measurements.
+    qputenv("HOME", tempDir.path().toUtf8());
+}
+
+void WakaTimeStartupBenchmark::cleanupTestCase() {
+    qputenv("HOME", oldHome);
+}
+
+std::unique_ptr<KTextEditor::Plugin> WakaTimeStartupBenchmark::createPlugin() {
+    const KPluginMetaData metaData(QStringLiteral(WAKATIME_PLUGIN_PATH));
+    auto result = KPluginFactory::instantiatePlugin<KTextEditor::Plugin>(metaData);
+    if (!result) {
+        qWarning() << "Failed to load the plugin:" << result.errorString;
+    }
+    return std::unique_ptr<KTextEditor::Plugin>(result.plugin);
+}
+
+void WakaTimeStartupBenchmark::benchmarkLoadPlugin() {
+    // The library stays loaded afterwards, so only the first load is cold.
+    QBENCHMARK_ONCE {
+        QVERIFY(createPlugin());
+    }
+}
+
+void WakaTimeStartupBenchmark::benchmarkCreatePlugin() {
+    QBENCHMARK {
+        QVERIFY(createPlugin());
+    }
+}
+
+void WakaTimeStartupBenchmark::benchmarkCreateView() {
+    const auto plugin = createPlugin();
+    QVERIFY(plugin);
+    MainWindowHost host;
+    QBENCHMARK {
+        delete plugin->createView(host.mainWindow);
+    }
+}
+
+void WakaTimeStartupBenchmark::testCreateViewDoesNotCreateDialog() {
+    const auto plugin = createPlugin();
+    QVERIFY(plugin);
+    MainWindowHost host;
+    std::unique_ptr<QObject> view(plugin->createView(host.mainWindow));
+    QVERIFY(view);
+    // The configuration dialog is only built when it is first opened.
+    QVERIFY(host.guiWindow.findChildren<QDialog *>().isEmpty());
+}
+
+QTEST_MAIN(WakaTimeStartupBenchmark)
+
+#include "startupbenchmark.moc"
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QObject>
+#include <QtTest/QTest>
+
+#include "throttletable.h"
+
+class ThrottleTableTest : public QObject {
+    Q_OBJECT
+
+public:
+    ThrottleTableTest(QObject *parent = nullptr);
+    ~ThrottleTableTest() override;
+
+private Q_SLOTS:
+    void testInterval();
+    void testPerEntity();
+    void testLeastRecentlyUsedEviction();
+    void testClear();
+};
+
+ThrottleTableTest::ThrottleTableTest(QObject *parent) : QObject(parent) {
+}
+
+ThrottleTableTest::~ThrottleTableTest() {
+}
+
+void ThrottleTableTest::testInterval() {
+    ThrottleTable throttle(1000, 10);
+    QVERIFY(!throttle.isThrottled(QStringLiteral("/a.cpp"), 0));
+    throttle.record(QStringLiteral("/a.cpp"), 0);
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.cpp"), 500));
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.cpp"), 1000));
+    QVERIFY(!throttle.isThrottled(QStringLiteral("/a.cpp"), 1001));
+    throttle.setInterval(2000);
+    QCOMPARE(throttle.interval(), 2000);
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.cpp"), 1001));
+}
+
+void ThrottleTableTest::testPerEntity() {
+    ThrottleTable throttle(1000, 10);
+    throttle.record(QStringLiteral("/a.h"), 0);
+    QVERIFY(!throttle.isThrottled(QStringLiteral("/a.cpp"), 10));
+    throttle.record(QStringLiteral("/a.cpp"), 10);
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.h"), 20));
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.cpp"), 20));
+    QCOMPARE(throttle.size(), 2);
+}
+
+void ThrottleTableTest::testLeastRecentlyUsedEviction() {
+    ThrottleTable throttle(1000, 2);
+    throttle.record(QStringLiteral("/a.cpp"), 0);
+    throttle.record(QStringLiteral("/b.cpp"), 0);
+    // Looking up a.cpp makes b.cpp the least recently used.
+    QVERIFY(throttle.isThrottled(QStringLiteral("/a.cpp"), 1));
+    throttle.record(QStringLiteral("/c.cpp"), 2);
+    QCOMPARE(throttle.size(), 2);
+    QVERIFY(throttle.contains(QStringLiteral("/a.cpp")));
+    QVERIFY(!throttle.contains(QStringLiteral("/b.cpp")));
+    QVERIFY(throttle.contains(QStringLiteral("/c.cpp")));
+    throttle.setCapacity(1);
+    QCOMPARE(throttle.size(), 1);
+}
+
+void ThrottleTableTest::testClear() {
+    ThrottleTable throttle(1000, 10);
+    throttle.record(QStringLiteral("/a.cpp"), 0);
+    throttle.clear();
+    QCOMPARE(throttle.size(), 0);
+    QVERIFY(!throttle.isThrottled(QStringLiteral("/a.cpp"), 1));
+}
+
+QTEST_MAIN(ThrottleTableTest)
+
+#include "throttletest.moc"
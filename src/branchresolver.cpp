@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include "branchresolver.h"
+
+namespace {
+// Plenty for any sane number of open repositories. The cache is dropped if exceeded.
+constexpr qsizetype kMaxEntries = 1024;
+// Longer than any `HEAD` or `.git` file Git writes.
+constexpr qint64 kMaxLineLength = 4096;
+const QByteArray kBranchPrefix = QByteArrayLiteral("ref: refs/heads/");
+const QByteArray kGitDirPrefix = QByteArrayLiteral("gitdir:");
+
+QByteArray readFirstLine(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readLine(kMaxLineLength).trimmed();
+}
+
+bool isSameOrDescendant(const QString &path, const QString &ancestor) {
+    return path == ancestor ||
+           (path.startsWith(ancestor) &&
+            (ancestor.endsWith(QLatin1Char('/')) || path.at(ancestor.size()) == QLatin1Char('/')));
+}
+} // namespace
+
+QString BranchResolver::branch(const QString &projectRoot) {
+    if (projectRoot.isEmpty()) {
+        return QString();
+    }
+    auto it = cache_.find(projectRoot);
+    if (it != cache_.end()) {
+        if (it->headPath.isEmpty()) {
+            stats_.hits++;
+            return QString();
+        }
+        // Git replaces HEAD with a new file on checkout, so one stat() tells if it changed.
+        const QFileInfo head(it->headPath);
+        if (head.lastModified() == it->modified && head.size() == it->size) {
+            stats_.hits++;
+            return it->branch;
+        }
+    } else {
+        if (cache_.size() >= kMaxEntries) {
+            cache_.clear();
+        }
+        it = cache_.insert(projectRoot, {headPath(projectRoot), QDateTime(), 0, QString()});
+    }
+    stats_.misses++;
+    if (!it->headPath.isEmpty()) {
+        // Checked before reading so a checkout while reading is picked up by the next lookup.
+        const QFileInfo head(it->headPath);
+        it->modified = head.lastModified();
+        it->size = head.size();
+        it->branch = readBranch(it->headPath);
+    }
+    return it->branch;
+}
+
+BranchResolver::Stats BranchResolver::stats() const {
+    auto stats = stats_;
+    stats.entries = cache_.size();
+    return stats;
+}
+
+void BranchResolver::resetStats() {
+    stats_ = Stats();
+}
+
+void BranchResolver::clear() {
+    cache_.clear();
+    stats_ = Stats();
+}
+
+void BranchResolver::invalidate(const QString &directory) {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (isSameOrDescendant(it.key(), directory)) {
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QString BranchResolver::headPath(const QString &projectRoot) {
+    const QFileInfo dotGit(projectRoot + QStringLiteral("/.git"));
+    if (dotGit.isDir()) {
+        return dotGit.filePath() + QStringLiteral("/HEAD");
+    }
+    if (!dotGit.isFile()) {
+        return QString();
+    }
+    // Worktrees and submodules have a file pointing to the Git directory, which may be relative.
+    const auto line = readFirstLine(dotGit.filePath());
+    if (!line.startsWith(kGitDirPrefix)) {
+        return QString();
+    }
+    const auto gitDir = QString::fromUtf8(line.mid(kGitDirPrefix.size()).trimmed());
+    return QDir::cleanPath(QDir(projectRoot).filePath(gitDir) + QStringLiteral("/HEAD"));
+}
+
+QString BranchResolver::readBranch(const QString &path) {
+    const auto line = readFirstLine(path);
+    // A detached HEAD holds a commit hash instead.
+    if (!line.startsWith(kBranchPrefix)) {
+        return QString();
+    }
+    return QString::fromUtf8(line.mid(kBranchPrefix.size()));
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QString>
+
+/**
+ * Cached lookup of the current Git branch of a project root. The branch is read from the `HEAD`
+ * file directly, following the `gitdir:` line of a `.git` file as used by worktrees and
+ * submodules, so no `git` process is started. Each root is cached with the modification time and
+ * size of its `HEAD` file, and later lookups only `stat()` that file to see if it changed.
+ */
+class BranchResolver {
+public:
+    /** Cache statistics. */
+    struct Stats {
+        /** Lookups answered from the cache. */
+        quint64 hits = 0;
+        /** Lookups that had to read `HEAD`. */
+        quint64 misses = 0;
+        /** Project roots in the cache. */
+        qsizetype entries = 0;
+    };
+
+    /**
+     * Get the current branch of a project.
+     *
+     * @param projectRoot Canonical path of the project root, as found by ProjectResolver.
+     * @return Branch name, or an empty string if the project is not a Git repository or its `HEAD`
+     * is detached.
+     */
+    QString branch(const QString &projectRoot);
+    /**
+     * Get cache statistics.
+     *
+     * @return Statistics.
+     */
+    Stats stats() const;
+    /** Reset the statistics without clearing the cache. */
+    void resetStats();
+    /** Clear the cache and statistics. */
+    void clear();
+    /**
+     * Drop cached branches of project roots at or below a directory, such as when a `.git` entry
+     * was added or replaced.
+     *
+     * @param directory Canonical path of the directory that changed.
+     */
+    void invalidate(const QString &directory);
+
+private:
+    struct Entry {
+        // Empty if the root has no Git directory.
+        QString headPath;
+        QDateTime modified;
+        qint64 size = 0;
+        QString branch;
+    };
+
+    /** Find the `HEAD` file of the repository at @p projectRoot. Empty if there is none. */
+    static QString headPath(const QString &projectRoot);
+    /** Read the branch name from the `HEAD` file at @p path. */
+    static QString readBranch(const QString &path);
+
+    // Project root to its branch.
+    QHash<QString, Entry> cache_;
+    Stats stats_;
+};
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QFileInfo>
+
+#include "cachewatcher.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeCacheWatcher, "wakatime-cache-watcher")
+
+// Keeps well clear of the default per-user inotify limit.
+constexpr qsizetype kDefaultMaxDirectories = 1024;
+
+CacheWatcher::CacheWatcher(QObject *parent)
+    : QObject(parent), maxDirectories_(kDefaultMaxDirectories) {
+    connect(&watcher_,
+            &QFileSystemWatcher::directoryChanged,
+            this,
+            &CacheWatcher::slotDirectoryChanged);
+}
+
+bool CacheWatcher::watch(const QString &directory) {
+    if (auto it = watched_.find(directory); it != watched_.end()) {
+        it.value()++;
+        return true;
+    }
+    if (watched_.size() >= maxDirectories_) {
+        qCDebug(gLogWakaTimeCacheWatcher) << "Not watching" << directory << "(limit reached)";
+        return false;
+    }
+    if (!watcher_.addPath(directory)) {
+        qCDebug(gLogWakaTimeCacheWatcher) << "Cannot watch" << directory;
+        return false;
+    }
+    watched_.insert(directory, 1);
+    return true;
+}
+
+void CacheWatcher::unwatch(const QString &directory) {
+    auto it = watched_.find(directory);
+    if (it == watched_.end() || --it.value() > 0) {
+        return;
+    }
+    watcher_.removePath(directory);
+    watched_.erase(it);
+}
+
+bool CacheWatcher::isWatching(const QString &directory) const {
+    return watched_.contains(directory);
+}
+
+qsizetype CacheWatcher::size() const {
+    return watched_.size();
+}
+
+qsizetype CacheWatcher::maxDirectories() const {
+    return maxDirectories_;
+}
+
+void CacheWatcher::setMaxDirectories(qsizetype maxDirectories) {
+    maxDirectories_ = maxDirectories;
+}
+
+void CacheWatcher::slotDirectoryChanged(const QString &directory) {
+    qCDebug(gLogWakaTimeCacheWatcher) << "Directory changed:" << directory;
+    // The watch is dropped by the system when the directory goes away.
+    if (!QFileInfo(directory).isDir()) {
+        watcher_.removePath(directory);
+        watched_.remove(directory);
+    }
+    Q_EMIT directoryChanged(directory);
+}
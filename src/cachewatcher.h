@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QObject>
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeCacheWatcher)
+
+/**
+ * Watches directories that cached lookups depend on so the affected cache entries can be dropped
+ * when the directory contents change. Watches are counted, so each successful watch() must be
+ * paired with an unwatch() when the cache entry that needed it is dropped.
+ */
+class CacheWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor. */
+    explicit CacheWatcher(QObject *parent = nullptr);
+    /**
+     * Watch a directory. Watching an already watched directory only adds to its count.
+     *
+     * @param directory Directory path.
+     * @return `true` if the directory is watched, `false` if it does not exist or the limit of
+     * watched directories has been reached. Results depending on an unwatched directory should not
+     * be cached.
+     */
+    bool watch(const QString &directory);
+    /**
+     * Release a watch taken with watch(). The directory stops being watched once every watch on it
+     * has been released. Directories that are not watched are ignored.
+     *
+     * @param directory Directory path.
+     */
+    void unwatch(const QString &directory);
+    /**
+     * Check if a directory is watched.
+     *
+     * @param directory Directory path.
+     * @return `true` if watched.
+     */
+    bool isWatching(const QString &directory) const;
+    /**
+     * Get the number of watched directories.
+     *
+     * @return Number of directories.
+     */
+    qsizetype size() const;
+    /**
+     * Get the maximum number of watched directories.
+     *
+     * @return Number of directories.
+     */
+    qsizetype maxDirectories() const;
+    /**
+     * Set the maximum number of watched directories. Each one uses an inotify watch or equivalent.
+     *
+     * @param maxDirectories Number of directories.
+     */
+    void setMaxDirectories(qsizetype maxDirectories);
+
+Q_SIGNALS:
+    /**
+     * Emitted when an entry is added to, removed from or renamed in a watched directory, or the
+     * directory itself is removed.
+     *
+     * @param directory The directory path as passed to watch().
+     */
+    void directoryChanged(const QString &directory);
+
+private:
+    void slotDirectoryChanged(const QString &directory);
+
+    QFileSystemWatcher watcher_;
+    // Directory to the number of watches on it.
+    QHash<QString, int> watched_;
+    qsizetype maxDirectories_;
+};
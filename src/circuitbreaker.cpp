@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QRandomGenerator>
+
+#include "circuitbreaker.h"
+
+CircuitBreaker::CircuitBreaker(int failureThreshold, qint64 baseDelayMs, qint64 maxDelayMs)
+    : failureThreshold_(failureThreshold), baseDelayMs_(baseDelayMs), maxDelayMs_(maxDelayMs) {
+}
+
+bool CircuitBreaker::allowRequest(qint64 nowMs) {
+    switch (state_) {
+    case Closed:
+        return true;
+    case HalfOpen:
+        return false;
+    case Open:
+        if (nowMs < retryAtMs_) {
+            return false;
+        }
+        state_ = HalfOpen;
+        return true;
+    }
+    return false; // LCOV_EXCL_LINE
+}
+
+void CircuitBreaker::recordSuccess() {
+    state_ = Closed;
+    failures_ = 0;
+    opened_ = 0;
+}
+
+void CircuitBreaker::recordFailure(qint64 nowMs) {
+    failures_++;
+    // Requests started before the breaker opened do not extend the delay.
+    if (state_ == Open || (state_ == Closed && failures_ < failureThreshold_)) {
+        return;
+    }
+    // Doubles each time, stopping before the shift could overflow.
+    auto delayMs = baseDelayMs_ << qMin(opened_, 30);
+    if (delayMs <= 0 || delayMs > maxDelayMs_) {
+        delayMs = maxDelayMs_;
+    }
+    delayMs -= qint64(double(delayMs) * jitter_ * QRandomGenerator::global()->generateDouble());
+    opened_++;
+    state_ = Open;
+    retryAtMs_ = nowMs + delayMs;
+}
+
+CircuitBreaker::State CircuitBreaker::state() const {
+    return state_;
+}
+
+int CircuitBreaker::consecutiveFailures() const {
+    return failures_;
+}
+
+qint64 CircuitBreaker::retryAt() const {
+    return retryAtMs_;
+}
+
+void CircuitBreaker::setJitter(double fraction) {
+    jitter_ = qBound(0.0, fraction, 1.0);
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QtGlobal>
+
+/**
+ * Stops requests after repeated failures. After a number of consecutive failures the breaker
+ * opens and refuses requests for a delay that doubles each time it opens again, with random
+ * jitter so that several editors do not retry in step. Once the delay has passed a single probe
+ * request is allowed. The breaker closes if it succeeds and opens again if it fails.
+ */
+class CircuitBreaker {
+public:
+    /** Breaker state. */
+    enum State {
+        Closed,   /**< Requests are allowed. */
+        HalfOpen, /**< A probe request is running. Other requests are refused. */
+        Open,     /**< Requests are refused until retryAt(). */
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param failureThreshold Consecutive failures that open the breaker.
+     * @param baseDelayMs Delay in milliseconds the first time the breaker opens.
+     * @param maxDelayMs Longest delay in milliseconds.
+     */
+    CircuitBreaker(int failureThreshold, qint64 baseDelayMs, qint64 maxDelayMs);
+    /**
+     * Check if a request may be made. If the breaker is open and the delay has passed this lets
+     * one probe request through and moves to HalfOpen.
+     *
+     * @param nowMs Current time in milliseconds since the epoch.
+     * @return `true` if the request may be made. The result must then be recorded.
+     */
+    bool allowRequest(qint64 nowMs);
+    /** Record a successful request. Closes the breaker. */
+    void recordSuccess();
+    /**
+     * Record a failed request.
+     *
+     * @param nowMs Current time in milliseconds since the epoch.
+     */
+    void recordFailure(qint64 nowMs);
+    /**
+     * Get the state.
+     *
+     * @return The state.
+     */
+    State state() const;
+    /**
+     * Get the number of consecutive failures.
+     *
+     * @return Number of failures since the last success.
+     */
+    int consecutiveFailures() const;
+    /**
+     * Get when the next probe is allowed.
+     *
+     * @return Time in milliseconds since the epoch. Only meaningful when open.
+     */
+    qint64 retryAt() const;
+    /**
+     * Set how much of the delay is randomised.
+     *
+     * @param fraction Between 0 (no jitter) and 1. The delay is reduced by a random amount up to
+     * this fraction. Defaults to 0.5.
+     */
+    void setJitter(double fraction);
+
+private:
+    int failureThreshold_;
+    qint64 baseDelayMs_;
+    qint64 maxDelayMs_;
+    double jitter_ = 0.5;
+    State state_ = Closed;
+    int failures_ = 0;
+    // Times opened since the last success.
+    int opened_ = 0;
+    qint64 retryAtMs_ = 0;
+};
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QList>
+
+#include <limits>
+
+#include "debouncer.h"
+
+Debouncer::Debouncer(int delayMs, int maxWaitMs, QObject *parent)
+    : QObject(parent), delayMs_(delayMs), maxWaitMs_(qMax(delayMs, maxWaitMs)) {
+    clock_.start();
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &Debouncer::slotTimeout);
+}
+
+void Debouncer::touch(QObject *object) {
+    const auto nowMs = clock_.elapsed();
+    auto it = pending_.find(object);
+    if (it != pending_.end()) {
+        it->lastMs = nowMs;
+        return;
+    }
+    pending_.insert(object, {nowMs, nowMs});
+    if (!timer_.isActive()) {
+        timer_.start(delayMs_);
+    }
+}
+
+void Debouncer::cancel(QObject *object) {
+    pending_.remove(object);
+    if (pending_.isEmpty()) {
+        timer_.stop();
+    }
+}
+
+bool Debouncer::isPending(QObject *object) const {
+    return pending_.contains(object);
+}
+
+bool Debouncer::isEmpty() const {
+    return pending_.isEmpty();
+}
+
+void Debouncer::slotTimeout() {
+    const auto nowMs = clock_.elapsed();
+    QList<QObject *> due;
+    auto nextMs = std::numeric_limits<qint64>::max();
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        const auto dueMs = qMin(it->lastMs + delayMs_, it->firstMs + maxWaitMs_);
+        if (dueMs <= nowMs) {
+            due << it.key();
+            it = pending_.erase(it);
+        } else {
+            nextMs = qMin(nextMs, dueMs);
+            ++it;
+        }
+    }
+    if (!pending_.isEmpty()) {
+        timer_.start(static_cast<int>(nextMs - nowMs));
+    }
+    // Emitted last as a receiver may call touch() or cancel().
+    for (auto object : due) {
+        Q_EMIT fired(object);
+    }
+}
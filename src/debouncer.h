@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+
+/**
+ * Per-object trailing-edge debouncer. A burst of touch() calls for the same object results in a
+ * single fired() signal once the object has been quiet for the delay, or once the maximum wait has
+ * passed since the first touch of the burst. touch() only stores a timestamp; a single timer is
+ * shared by all objects.
+ */
+class Debouncer : public QObject {
+    Q_OBJECT
+#ifdef TESTING
+    friend class DebouncerTest;
+#endif
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param delayMs Quiet time in milliseconds before fired() is emitted.
+     * @param maxWaitMs Maximum time in milliseconds between the first touch of a burst and fired().
+     * @param parent Parent object.
+     */
+    explicit Debouncer(int delayMs, int maxWaitMs, QObject *parent = nullptr);
+    /**
+     * Record an event for an object.
+     *
+     * @param object The object.
+     */
+    void touch(QObject *object);
+    /**
+     * Forget pending events for an object without emitting fired().
+     *
+     * @param object The object.
+     */
+    void cancel(QObject *object);
+    /**
+     * Check if an object has pending events.
+     *
+     * @param object The object.
+     * @return `true` if fired() will be emitted for @p object.
+     */
+    bool isPending(QObject *object) const;
+    /**
+     * Check if no object has pending events.
+     *
+     * @return `true` if fired() will not be emitted without another touch().
+     */
+    bool isEmpty() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted once per burst of events.
+     *
+     * @param object The object passed to touch().
+     */
+    void fired(QObject *object);
+
+private:
+    /** Emit fired() for objects that are due and reschedule the timer for the rest. */
+    void slotTimeout();
+
+    struct Burst {
+        qint64 firstMs;
+        qint64 lastMs;
+    };
+    int delayMs_;
+    int maxWaitMs_;
+    QElapsedTimer clock_;
+    QTimer timer_;
+    QHash<QObject *, Burst> pending_;
+};
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+
+#include <utility>
+
+#include "editoractivity.h"
+#include "wakatime.h"
+
+EditorActivity::EditorActivity(WakaTime &client,
+                               Describe describe,
+                               int delayMs,
+                               int maxWaitMs,
+                               QObject *parent)
+    : QObject(parent), client_(client), describe_(std::move(describe)),
+      textChangedDebouncer_(delayMs, maxWaitMs) {
+    // The cursor position is read when the debouncer fires, so it is the latest one.
+    connect(&textChangedDebouncer_, &Debouncer::fired, this, [this](QObject *document) {
+        sendAction(document, false);
+    });
+}
+
+void EditorActivity::handle(QObject *document, EditorEvent::Type type) {
+    if (recorder_) {
+        if (auto state = describe_(document)) {
+            recorder_->record({type, QDateTime::currentMSecsSinceEpoch(), std::move(*state)});
+        }
+    }
+    switch (type) {
+    case EditorEvent::TextChanged:
+        textChangedDebouncer_.touch(document);
+        break;
+    case EditorEvent::ModifiedChanged:
+        sendAction(document, false);
+        break;
+    case EditorEvent::Saved:
+        sendAction(document, true);
+        break;
+    }
+}
+
+void EditorActivity::cancel(QObject *document) {
+    textChangedDebouncer_.cancel(document);
+}
+
+bool EditorActivity::isPending() const {
+    return !textChangedDebouncer_.isEmpty();
+}
+
+void EditorActivity::setRecorder(SessionRecorder *recorder) {
+    recorder_ = recorder;
+}
+
+void EditorActivity::sendAction(QObject *document, bool isWrite) {
+    const auto state = describe_(document);
+    if (!state) {
+        return;
+    }
+    client_.queueHeartbeat(
+        state->filePath, state->mode, state->line, state->column, state->linesInFile, isWrite);
+    Q_EMIT actionSent(document, isWrite);
+}
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QObject>
+
+#include <functional>
+#include <optional>
+
+#include "debouncer.h"
+#include "sessionrecorder.h"
+
+class WakaTime;
+
+/** Quiet time after the last keystroke before a heartbeat is sent for it. */
+constexpr int kTextChangedDelayMs = 1000;
+/** Upper bound for continuous typing without a pause. */
+constexpr int kTextChangedMaxWaitMs = 10000;
+
+/**
+ * Turns document signals into heartbeats. Bursts of text changes are debounced per document, while
+ * modification and save events are sent straight away. The editor is only reached through the
+ * describe function, so WakaTimeView and SessionPlayer share this path.
+ */
+class EditorActivity : public QObject {
+    Q_OBJECT
+
+public:
+    /** Returns the current state of a document, or `std::nullopt` if it has no view. */
+    using Describe = std::function<std::optional<DocumentState>(QObject *document)>;
+
+    /**
+     * Constructor.
+     *
+     * @param client Client to send heartbeats with. Must outlive this object.
+     * @param describe Called for the state of a document when an event is handled and when its
+     * heartbeat is sent.
+     * @param delayMs Quiet time after the last text change before a heartbeat is sent for it.
+     * @param maxWaitMs Upper bound for continuous typing without a pause.
+     * @param parent Parent object.
+     */
+    EditorActivity(WakaTime &client,
+                   Describe describe,
+                   int delayMs,
+                   int maxWaitMs,
+                   QObject *parent = nullptr);
+    /**
+     * Handle a document signal.
+     *
+     * @param document The document.
+     * @param type The signal.
+     */
+    void handle(QObject *document, EditorEvent::Type type);
+    /**
+     * Forget pending text changes for a document.
+     *
+     * @param document The document.
+     */
+    void cancel(QObject *document);
+    /**
+     * Check if a heartbeat for a text change is still waiting for a pause.
+     *
+     * @return `true` if a heartbeat is pending for any document.
+     */
+    bool isPending() const;
+    /**
+     * Record every handled event from now on.
+     *
+     * @param recorder Recorder, or `nullptr` to stop recording. Must outlive this object or be
+     * replaced first.
+     */
+    void setRecorder(SessionRecorder *recorder);
+
+Q_SIGNALS:
+    /**
+     * Emitted after a heartbeat has been queued for a document.
+     *
+     * @param document The document.
+     * @param isWrite Whether the heartbeat is a write.
+     */
+    void actionSent(QObject *document, bool isWrite);
+
+private:
+    /**
+     * Queue a heartbeat with the current state of @p document.
+     *
+     * @param document The document.
+     * @param isWrite Whether this is a write event.
+     */
+    void sendAction(QObject *document, bool isWrite);
+
+    WakaTime &client_;
+    Describe describe_;
+    // Collapses bursts of textChanged into one heartbeat per document.
+    Debouncer textChangedDebouncer_;
+    SessionRecorder *recorder_ = nullptr;
+};
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: MIT
+#include <charconv>
+#include <type_traits>
+
+#include "heartbeat.h"
+
+static_assert(std::is_nothrow_move_constructible_v<Heartbeat>);
+
+// Flags and values of the longest argument list.
+constexpr qsizetype kMaxArguments = 18;
+
+namespace {
+// Formatted on the stack so each number costs a single allocation for the string.
+QString numberString(qint64 number) {
+    char buffer[24];
+    const auto end = std::to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+    return QString::fromLatin1(buffer, end - buffer);
+}
+
+QString timeString(qint64 timeMs) {
+    // Seconds with three decimals. Negative times do not occur.
+    char buffer[32];
+    auto end = std::to_chars(buffer, buffer + sizeof(buffer) - 4, timeMs / 1000).ptr;
+    const auto ms = int(timeMs % 1000);
+    *end++ = '.';
+    *end++ = char('0' + ms / 100);
+    *end++ = char('0' + ms / 10 % 10);
+    *end++ = char('0' + ms % 10);
+    return QString::fromLatin1(buffer, end - buffer);
+}
+} // namespace
+
+QStringList Heartbeat::toArguments(const QStringList &suffix) const {
+    QStringList arguments;
+    arguments.reserve(kMaxArguments + suffix.size());
+    arguments << QStringLiteral("--entity") << entity;
+    arguments << QStringLiteral("--time") << timeString(timeMs);
+    if (!project.isEmpty()) {
+        arguments << QStringLiteral("--alternate-project") << project;
+    }
+    if (!branch.isEmpty()) {
+        arguments << QStringLiteral("--alternate-branch") << branch;
+    }
+    if (isWrite) {
+        arguments << QStringLiteral("--write");
+    }
+    if (!language.isEmpty()) {
+        arguments << QStringLiteral("--language") << language;
+    }
+    arguments << QStringLiteral("--lineno") << numberString(lineNumber);
+    arguments << QStringLiteral("--cursorpos") << numberString(cursorPosition);
+    arguments << QStringLiteral("--lines-in-file") << numberString(linesInFile);
+    arguments << suffix;
+    return arguments;
+}
+
+QJsonObject Heartbeat::toJson() const {
+    QJsonObject object;
+    object.insert(QStringLiteral("entity"), entity);
+    object.insert(QStringLiteral("type"), QStringLiteral("file"));
+    object.insert(QStringLiteral("time"), static_cast<double>(timeMs) / 1000.0);
+    object.insert(QStringLiteral("is_write"), isWrite);
+    object.insert(QStringLiteral("lineno"), lineNumber);
+    object.insert(QStringLiteral("cursorpos"), cursorPosition);
+    object.insert(QStringLiteral("lines"), linesInFile);
+    if (!project.isEmpty()) {
+        object.insert(QStringLiteral("alternate_project"), project);
+    }
+    if (!branch.isEmpty()) {
+        object.insert(QStringLiteral("alternate_branch"), branch);
+    }
+    if (!language.isEmpty()) {
+        object.insert(QStringLiteral("language"), language);
+    }
+    return object;
+}
+
+std::optional<Heartbeat> Heartbeat::fromJson(const QJsonObject &object) {
+    Heartbeat heartbeat;
+    heartbeat.entity = object.value(QStringLiteral("entity")).toString();
+    if (heartbeat.entity.isEmpty()) {
+        return std::nullopt;
+    }
+    heartbeat.language = object.value(QStringLiteral("language")).toString();
+    heartbeat.project = object.value(QStringLiteral("alternate_project")).toString();
+    heartbeat.branch = object.value(QStringLiteral("alternate_branch")).toString();
+    heartbeat.lineNumber = object.value(QStringLiteral("lineno")).toInt();
+    heartbeat.cursorPosition = object.value(QStringLiteral("cursorpos")).toInt();
+    heartbeat.linesInFile = object.value(QStringLiteral("lines")).toInt();
+    heartbeat.isWrite = object.value(QStringLiteral("is_write")).toBool();
+    heartbeat.timeMs = qRound64(object.value(QStringLiteral("time")).toDouble() * 1000.0);
+    return heartbeat;
+}
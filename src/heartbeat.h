@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <optional>
+
+/**
+ * A single heartbeat to be sent by `wakatime-cli`. It is kept as plain fields until it is
+ * dispatched, and is cheap to move and copy as the strings are shared.
+ */
+struct Heartbeat {
+    /** Canonical path of the file. */
+    QString entity;
+    /** Language mode of the file. May be empty. */
+    QString language;
+    /** Project name. May be empty. */
+    QString project;
+    /** Git branch of the project. May be empty. */
+    QString branch;
+    /** Line number of the cursor position. */
+    int lineNumber = 0;
+    /** Column number of the cursor position. */
+    int cursorPosition = 0;
+    /** Total number of lines in the file. */
+    int linesInFile = 0;
+    /** Whether this is a write event. */
+    bool isWrite = false;
+    /** Time of the event in milliseconds since the epoch. */
+    qint64 timeMs = 0;
+
+    /**
+     * Arguments describing this heartbeat on the `wakatime-cli` command line.
+     *
+     * @param suffix Arguments appended after the heartbeat's own, such as `--plugin`. Built once
+     * by the caller so they are shared rather than copied.
+     * @return Argument list.
+     */
+    QStringList toArguments(const QStringList &suffix = QStringList()) const;
+    /**
+     * JSON object describing this heartbeat, as read by `wakatime-cli --extra-heartbeats`.
+     *
+     * @return JSON object.
+     */
+    QJsonObject toJson() const;
+    /**
+     * Read a heartbeat from JSON written by toJson().
+     *
+     * @param object JSON object.
+     * @return The heartbeat, or `std::nullopt` if @p object has no entity.
+     */
+    static std::optional<Heartbeat> fromJson(const QJsonObject &object);
+};
@@ -0,0 +1,348 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QLockFile>
+#include <QtCore/QSaveFile>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <limits>
+
+#include "heartbeatjournal.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeJournal, "wakatime-journal")
+
+constexpr int kSyncDelayMs = 1000;
+constexpr qsizetype kDefaultMaxEntries = 100000;
+constexpr qsizetype kAllEntries = std::numeric_limits<qsizetype>::max();
+// Longer than any operation on the journal takes. A lock left by a crash is stale after 30 s.
+constexpr int kLockTimeoutMs = 5000;
+
+namespace {
+QByteArray toLine(const Heartbeat &heartbeat) {
+    return QJsonDocument(heartbeat.toJson()).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * Take the lock shared with other Kate processes. Carries on without it if that fails. Without a
+ * directory there is no journal to share, and nothing is locked.
+ */
+void lock(QLockFile &lockFile, const QString &lockPath) {
+    if (!QFileInfo(lockPath).absoluteDir().exists()) {
+        return;
+    }
+    if (!lockFile.tryLock(kLockTimeoutMs)) {
+        qCWarning(gLogWakaTimeJournal) << "Cannot lock journal, error" << lockFile.error();
+    }
+}
+} // namespace
+
+HeartbeatJournal::HeartbeatJournal(const QString &path, QObject *parent)
+    : QObject(parent), path_(path), lockPath_(path + QStringLiteral(".lock")), file_(path),
+      maxEntries_(kDefaultMaxEntries) {
+    syncTimer_.setSingleShot(true);
+    syncTimer_.setInterval(kSyncDelayMs);
+    connect(&syncTimer_, &QTimer::timeout, this, &HeartbeatJournal::sync);
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    qsizetype invalid = 0;
+    size_ = readEntries(0, kAllEntries, nullptr, &invalid).size();
+    state_ = fileState();
+    if (invalid > 0 || size_ > maxEntries_) {
+        qCDebug(gLogWakaTimeJournal) << "Compacting journal with" << invalid << "unreadable lines";
+        compactLocked();
+    }
+}
+
+HeartbeatJournal::~HeartbeatJournal() {
+    sync();
+    if (offset_ == 0) {
+        return;
+    }
+    // The replayed lines are blank already, this only saves reading past them next time.
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    refresh();
+    if (offset_ > 0) {
+        compactLocked();
+    }
+}
+
+QString HeartbeatJournal::defaultPath() {
+    return QDir::homePath() + QStringLiteral("/.wakatime/kate-wakatime-offline.jsonl");
+}
+
+QString HeartbeatJournal::path() const {
+    return path_;
+}
+
+qsizetype HeartbeatJournal::size() const {
+    return size_;
+}
+
+bool HeartbeatJournal::isEmpty() const {
+    return size_ == 0;
+}
+
+qsizetype HeartbeatJournal::maxEntries() const {
+    return maxEntries_;
+}
+
+void HeartbeatJournal::setMaxEntries(qsizetype maxEntries) {
+    maxEntries_ = qMax<qsizetype>(maxEntries, 1);
+}
+
+void HeartbeatJournal::append(const QList<Heartbeat> &heartbeats) {
+    if (heartbeats.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    refresh();
+    if (!file_.isOpen()) {
+        if (!file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qCWarning(gLogWakaTimeJournal)
+                << "Cannot open journal" << path_ << file_.errorString();
+            return;
+        }
+    }
+    for (const auto &heartbeat : heartbeats) {
+        file_.write(toLine(heartbeat));
+        file_.write("\n");
+    }
+    // Hand the data to the operating system now so it survives a crash of Kate itself.
+    file_.flush();
+    state_ = fileState();
+    size_ += heartbeats.size();
+    qCDebug(gLogWakaTimeJournal) << "Journalled" << heartbeats.size() << "heartbeats," << size_
+                                 << "total";
+    if (size_ > maxEntries_) {
+        compactLocked();
+    } else if (!syncTimer_.isActive()) {
+        syncTimer_.start();
+    }
+}
+
+HeartbeatJournal::Batch HeartbeatJournal::read(qsizetype count) {
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    refresh();
+    Batch batch;
+    batch.begin = offset_;
+    batch.generation = generation_;
+    auto entries = readEntries(offset_, count, &batch.end);
+    batch.heartbeats.reserve(entries.size());
+    batch.lines.reserve(entries.size());
+    for (auto &entry : entries) {
+        batch.heartbeats << std::move(entry.heartbeat);
+        batch.lines << std::move(entry.line);
+    }
+    return batch;
+}
+
+void HeartbeatJournal::discard(const Batch &batch) {
+    if (batch.lines.isEmpty()) {
+        return;
+    }
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    refresh();
+    if (batch.generation == generation_ && batch.begin == offset_) {
+        // Blanked rather than only skipped, so they are not read again after a restart or by
+        // another process.
+        blank(batch.begin, batch.end);
+        offset_ = batch.end;
+        size_ -= batch.lines.size();
+        // Drop the replayed lines from the file once they outweigh the rest, so the cost of
+        // rewriting is spread over the batches.
+        const auto fileSize = QFileInfo(path_).size();
+        if (size_ == 0 || offset_ > fileSize - offset_) {
+            QList<QByteArray> lines;
+            for (auto &entry : readEntries(offset_, kAllEntries)) {
+                lines << std::move(entry.line);
+            }
+            rewrite(lines);
+        }
+        return;
+    }
+    // The journal was rewritten since the batch was read, so find its lines again. Heartbeats are
+    // timestamped in milliseconds so equal lines are the same heartbeat.
+    QHash<QByteArray, qsizetype> replayed;
+    for (const auto &line : batch.lines) {
+        replayed[line]++;
+    }
+    QList<QByteArray> lines;
+    for (auto &entry : readEntries(offset_, kAllEntries)) {
+        if (auto it = replayed.find(entry.line); it != replayed.end() && it.value() > 0) {
+            it.value()--;
+            continue;
+        }
+        lines << std::move(entry.line);
+    }
+    rewrite(lines);
+}
+
+void HeartbeatJournal::compact() {
+    QLockFile lockFile(lockPath_);
+    lock(lockFile, lockPath_);
+    refresh();
+    compactLocked();
+}
+
+void HeartbeatJournal::compactLocked() {
+    QList<QByteArray> lines;
+    for (auto &entry : readEntries(offset_, kAllEntries)) {
+        lines << std::move(entry.line);
+    }
+    if (lines.size() > maxEntries_) {
+        // Leave room so the following appends do not each rewrite the file.
+        const auto keep = maxEntries_ - maxEntries_ / 10;
+        qCWarning(gLogWakaTimeJournal)
+            << "Dropping" << lines.size() - keep << "oldest journalled heartbeats";
+        lines.remove(0, lines.size() - keep);
+    }
+    rewrite(lines);
+}
+
+void HeartbeatJournal::sync() {
+    syncTimer_.stop();
+    if (!file_.isOpen()) {
+        return;
+    }
+    file_.flush();
+#ifdef Q_OS_WIN
+    _commit(file_.handle());
+#else
+    ::fsync(file_.handle());
+#endif
+}
+
+HeartbeatJournal::FileState HeartbeatJournal::fileState() const {
+    const QFileInfo info(path_);
+    FileState state;
+    if (!info.exists()) {
+        return state;
+    }
+    state.size = info.size();
+    state.modified = info.lastModified();
+#ifndef Q_OS_WIN
+    struct stat buffer;
+    if (::stat(QFile::encodeName(path_).constData(), &buffer) == 0) {
+        state.inode = buffer.st_ino;
+    }
+#endif
+    return state;
+}
+
+void HeartbeatJournal::refresh() {
+    const auto state = fileState();
+    if (state == state_) {
+        return;
+    }
+    qCDebug(gLogWakaTimeJournal) << "Journal changed by another process";
+    // If the file was replaced, appending to the old one would lose the heartbeats.
+    syncTimer_.stop();
+    file_.close();
+    // Replayed lines are blank, so reading from the start again skips them.
+    size_ = readEntries(0, kAllEntries).size();
+    offset_ = 0;
+    generation_++;
+    state_ = state;
+}
+
+void HeartbeatJournal::blank(qint64 begin, qint64 end) {
+    QFile file(path_);
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(begin)) {
+        qCWarning(gLogWakaTimeJournal) << "Cannot update journal" << path_ << file.errorString();
+        return;
+    }
+    auto bytes = file.read(end - begin);
+    for (auto &byte : bytes) {
+        if (byte != '\n') {
+            byte = ' ';
+        }
+    }
+    file.seek(begin);
+    file.write(bytes);
+    file.close();
+    state_ = fileState();
+}
+
+QList<HeartbeatJournal::Entry> HeartbeatJournal::readEntries(qint64 from,
+                                                             qsizetype count,
+                                                             qint64 *end,
+                                                             qsizetype *invalid) const {
+    QList<Entry> entries;
+    auto position = from;
+    qsizetype unreadable = 0;
+    QFile file(path_);
+    if (file.open(QIODevice::ReadOnly) && file.seek(from)) {
+        while (entries.size() < count && !file.atEnd()) {
+            auto line = file.readLine().trimmed();
+            if (line.isEmpty()) {
+                continue;
+            }
+            QJsonParseError error;
+            const auto document = QJsonDocument::fromJson(line, &error);
+            std::optional<Heartbeat> heartbeat;
+            if (error.error == QJsonParseError::NoError && document.isObject()) {
+                heartbeat = Heartbeat::fromJson(document.object());
+            }
+            if (!heartbeat) {
+                unreadable++;
+                continue;
+            }
+            entries.append({std::move(line), std::move(*heartbeat)});
+            position = file.pos();
+        }
+    }
+    if (end) {
+        *end = position;
+    }
+    if (invalid) {
+        *invalid = unreadable;
+    }
+    return entries;
+}
+
+void HeartbeatJournal::rewrite(const QList<QByteArray> &lines) {
+    syncTimer_.stop();
+    file_.close();
+    if (lines.isEmpty()) {
+        QFile::remove(path_);
+        size_ = 0;
+        offset_ = 0;
+        generation_++;
+        state_ = fileState();
+        return;
+    }
+    // QSaveFile writes to a temporary file and renames it over the journal on commit, so a crash
+    // during compaction leaves either the old or the new journal intact.
+    QSaveFile saveFile(path_);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        qCWarning(gLogWakaTimeJournal)
+            << "Cannot rewrite journal" << path_ << saveFile.errorString();
+        return;
+    }
+    for (const auto &line : lines) {
+        saveFile.write(line);
+        saveFile.write("\n");
+    }
+    if (!saveFile.commit()) {
+        qCWarning(gLogWakaTimeJournal)
+            << "Cannot rewrite journal" << path_ << saveFile.errorString();
+        return;
+    }
+    size_ = lines.size();
+    offset_ = 0;
+    generation_++;
+    state_ = fileState();
+}
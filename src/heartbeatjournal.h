@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+
+#include "heartbeat.h"
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeJournal)
+
+/**
+ * Append-only file of heartbeats that could not be sent. Each heartbeat is stored as one line of
+ * compact JSON. Writes reach the operating system straight away but `fsync()` is batched on a short
+ * timer. A torn last line left by a crash is ignored when reading and removed by compact().
+ *
+ * Replayed heartbeats are blanked out in place and skipped by moving a read offset forward, and the
+ * file is only rewritten once the replayed part is larger than the rest or the journal is
+ * destroyed, so replaying a long journal in batches costs time proportional to its length and a
+ * replayed heartbeat is never read again, even after a crash.
+ *
+ * Every Kate process shares the file, so each operation holds a lock file next to it and first
+ * checks whether another process has changed the file since.
+ */
+class HeartbeatJournal : public QObject {
+    Q_OBJECT
+
+public:
+    /** Heartbeats returned by read(), to be passed to discard() once they have been replayed. */
+    struct Batch {
+        /** Heartbeats, oldest first. */
+        QList<Heartbeat> heartbeats;
+
+    private:
+        friend class HeartbeatJournal;
+        // The lines the heartbeats were read from, to find them again after a rewrite.
+        QList<QByteArray> lines;
+        qint64 begin = 0;
+        qint64 end = 0;
+        quint64 generation = 0;
+    };
+
+    /**
+     * Constructor. Compacts the journal if it has unreadable lines or too many entries.
+     *
+     * @param path Path of the journal file. The parent directory is created on first write.
+     * @param parent Parent object.
+     */
+    explicit HeartbeatJournal(const QString &path, QObject *parent = nullptr);
+    /** Destructor. Syncs pending writes and removes replayed heartbeats from the file. */
+    ~HeartbeatJournal() override;
+    /**
+     * Default journal location in `~/.wakatime`.
+     *
+     * @return File path.
+     */
+    static QString defaultPath();
+    /**
+     * Get the journal file path.
+     *
+     * @return File path.
+     */
+    QString path() const;
+    /**
+     * Get the number of heartbeats in the journal.
+     *
+     * @return Number of heartbeats.
+     */
+    qsizetype size() const;
+    /**
+     * Check if the journal has no heartbeats.
+     *
+     * @return `true` if empty.
+     */
+    bool isEmpty() const;
+    /**
+     * Append heartbeats to the journal.
+     *
+     * @param heartbeats Heartbeats to append.
+     */
+    void append(const QList<Heartbeat> &heartbeats);
+    /**
+     * Read the oldest heartbeats in the journal. Only the lines returned are read.
+     *
+     * @param count Maximum number of heartbeats to read.
+     * @return Heartbeats, oldest first.
+     */
+    Batch read(qsizetype count);
+    /**
+     * Remove heartbeats returned by read(), typically after they have been replayed. Heartbeats
+     * dropped by compaction in the meantime are skipped, and heartbeats appended since are kept.
+     *
+     * @param batch Result of read().
+     */
+    void discard(const Batch &batch);
+    /**
+     * Rewrite the journal without unreadable lines or replayed heartbeats. If there are more than
+     * maxEntries(), the oldest are dropped to leave a tenth of the cap free, so that appends while
+     * offline do not rewrite the file every time.
+     */
+    void compact();
+    /** Flush and `fsync()` pending writes now. */
+    void sync();
+    /**
+     * Get the maximum number of heartbeats kept.
+     *
+     * @return Number of heartbeats.
+     */
+    qsizetype maxEntries() const;
+    /**
+     * Set the maximum number of heartbeats kept. The oldest are dropped on compaction.
+     *
+     * @param maxEntries Number of heartbeats.
+     */
+    void setMaxEntries(qsizetype maxEntries);
+
+private:
+    /** A valid line of the journal. */
+    struct Entry {
+        QByteArray line;
+        Heartbeat heartbeat;
+    };
+    /** What the file looked like after the last operation, to notice other processes' changes. */
+    struct FileState {
+        // -1 if the file does not exist.
+        qint64 size = -1;
+        QDateTime modified;
+        // Changes when the file is replaced. Always 0 on Windows.
+        quint64 inode = 0;
+
+        bool operator==(const FileState &) const = default;
+    };
+
+    /** Get the current state of the journal file. */
+    FileState fileState() const;
+    /**
+     * Pick up changes made by another process since the last operation: reopen the file if it
+     * was replaced, and count its heartbeats again. Call with the lock held.
+     */
+    void refresh();
+    /** compact() with the lock held. */
+    void compactLocked();
+    /** Overwrite the bytes from @p begin to @p end with spaces, keeping line breaks. */
+    void blank(qint64 begin, qint64 end);
+
+    /**
+     * Read valid lines.
+     *
+     * @param from Byte offset to start at.
+     * @param count Maximum number of lines to read.
+     * @param[out] end If not `nullptr`, set to the byte offset after the last valid line read.
+     * @param[out] invalid If not `nullptr`, set to the number of unreadable lines skipped.
+     * @return The lines, oldest first.
+     */
+    QList<Entry> readEntries(qint64 from,
+                             qsizetype count,
+                             qint64 *end = nullptr,
+                             qsizetype *invalid = nullptr) const;
+    /** Atomically replace the journal contents with @p lines. */
+    void rewrite(const QList<QByteArray> &lines);
+
+    QString path_;
+    QString lockPath_;
+    QFile file_;
+    FileState state_;
+    QTimer syncTimer_;
+    // Heartbeats after offset_.
+    qsizetype size_ = 0;
+    qsizetype maxEntries_;
+    // Lines before this byte offset have been replayed.
+    qint64 offset_ = 0;
+    // Incremented on each rewrite, which invalidates byte offsets held by a Batch.
+    quint64 generation_ = 0;
+};
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+#include <algorithm>
+#include <utility>
+
+#include "heartbeatscheduler.h"
+
+namespace {
+qsizetype indexOf(const QList<Heartbeat> &lane, const QString &entity) {
+    const auto it = std::find_if(lane.cbegin(), lane.cend(), [&entity](const Heartbeat &other) {
+        return other.entity == entity;
+    });
+    return it == lane.cend() ? -1 : it - lane.cbegin();
+}
+} // namespace
+
+HeartbeatScheduler::HeartbeatScheduler(qsizetype capacity) : capacity_(capacity) {
+}
+
+HeartbeatScheduler::Result HeartbeatScheduler::enqueue(Heartbeat heartbeat,
+                                                       std::optional<Heartbeat> &removed) {
+    removed.reset();
+    const auto plainIndex = indexOf(plain_, heartbeat.entity);
+    if (heartbeat.isWrite) {
+        if (plainIndex >= 0) {
+            removed = plain_.takeAt(plainIndex);
+            writes_ << std::move(heartbeat);
+            return Coalesced;
+        }
+        // Writes are never dropped, so they may go over capacity.
+        if (size() >= capacity_ && !plain_.isEmpty()) {
+            removed = plain_.takeFirst();
+        }
+        writes_ << std::move(heartbeat);
+        return Queued;
+    }
+    if (plainIndex >= 0) {
+        removed = std::exchange(plain_[plainIndex], std::move(heartbeat));
+        return Coalesced;
+    }
+    if (indexOf(writes_, heartbeat.entity) >= 0) {
+        removed = std::move(heartbeat);
+        return Coalesced;
+    }
+    if (size() >= capacity_) {
+        if (plain_.isEmpty()) {
+            removed = std::move(heartbeat);
+            return Dropped;
+        }
+        removed = plain_.takeFirst();
+    }
+    plain_ << std::move(heartbeat);
+    return Queued;
+}
+
+QList<Heartbeat> HeartbeatScheduler::take(qsizetype count) {
+    if (count >= size()) {
+        return takeAll();
+    }
+    QList<Heartbeat> batch;
+    batch.reserve(count);
+    const auto fromWrites = qMin(count, writes_.size());
+    batch << writes_.first(fromWrites);
+    writes_.remove(0, fromWrites);
+    const auto fromPlain = count - fromWrites;
+    batch << plain_.first(fromPlain);
+    plain_.remove(0, fromPlain);
+    return batch;
+}
+
+QList<Heartbeat> HeartbeatScheduler::takeAll() {
+    auto batch = std::exchange(writes_, {});
+    batch << std::exchange(plain_, {});
+    return batch;
+}
+
+bool HeartbeatScheduler::contains(const QString &entity) const {
+    return indexOf(plain_, entity) >= 0 || indexOf(writes_, entity) >= 0;
+}
+
+bool HeartbeatScheduler::isEmpty() const {
+    return writes_.isEmpty() && plain_.isEmpty();
+}
+
+qsizetype HeartbeatScheduler::size() const {
+    return writes_.size() + plain_.size();
+}
+
+bool HeartbeatScheduler::hasWrites() const {
+    return !writes_.isEmpty();
+}
+
+qsizetype HeartbeatScheduler::capacity() const {
+    return capacity_;
+}
+
+void HeartbeatScheduler::setCapacity(qsizetype capacity) {
+    capacity_ = capacity;
+}
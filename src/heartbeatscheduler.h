@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QList>
+
+#include <optional>
+
+#include "heartbeat.h"
+
+/**
+ * Bounded queue of heartbeats waiting to be sent, in two lanes. Write heartbeats are always taken
+ * before plain ones and are never dropped.
+ *
+ * When a heartbeat is added for a file that already has one waiting, the two are coalesced: a
+ * newer plain heartbeat replaces an older one, a write replaces a plain heartbeat, and a plain
+ * heartbeat is absorbed by a write. Otherwise, if the queue is full, the oldest plain heartbeat
+ * is dropped to make room. The queue is small, so lookups are linear.
+ */
+class HeartbeatScheduler {
+public:
+    /** What enqueue() did with a heartbeat. */
+    enum Result {
+        Coalesced, /**< Merged with a heartbeat waiting for the same file. */
+        Dropped,   /**< Not added because the queue is full of writes. */
+        Queued,    /**< Added. */
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param capacity Number of heartbeats beyond which plain heartbeats are dropped.
+     */
+    explicit HeartbeatScheduler(qsizetype capacity);
+    /**
+     * Add a heartbeat to the lane for its kind.
+     *
+     * @param heartbeat The heartbeat. Moved into the queue.
+     * @param[out] removed Set to the heartbeat that was replaced, absorbed or dropped, if any. This
+     * is @p heartbeat itself if it was absorbed by a write or dropped.
+     * @return What happened to @p heartbeat.
+     */
+    Result enqueue(Heartbeat heartbeat, std::optional<Heartbeat> &removed);
+    /**
+     * Remove heartbeats to send, writes first and then plain heartbeats, oldest first in each
+     * lane.
+     *
+     * @param count Maximum number of heartbeats.
+     * @return The heartbeats.
+     */
+    QList<Heartbeat> take(qsizetype count);
+    /**
+     * Remove all heartbeats, writes first.
+     *
+     * @return The heartbeats.
+     */
+    QList<Heartbeat> takeAll();
+    /**
+     * Check if a heartbeat for a file is waiting.
+     *
+     * @param entity Canonical file path.
+     * @return `true` if either lane has a heartbeat for @p entity.
+     */
+    bool contains(const QString &entity) const;
+    /**
+     * Check if there are no heartbeats waiting.
+     *
+     * @return `true` if both lanes are empty.
+     */
+    bool isEmpty() const;
+    /**
+     * Get the number of heartbeats waiting.
+     *
+     * @return Number of heartbeats in both lanes.
+     */
+    qsizetype size() const;
+    /**
+     * Check if there are write heartbeats waiting.
+     *
+     * @return `true` if the write lane is not empty.
+     */
+    bool hasWrites() const;
+    /**
+     * Get the capacity.
+     *
+     * @return Number of heartbeats.
+     */
+    qsizetype capacity() const;
+    /**
+     * Set the number of heartbeats beyond which plain heartbeats are dropped. Heartbeats already
+     * waiting are kept.
+     *
+     * @param capacity Number of heartbeats.
+     */
+    void setCapacity(qsizetype capacity);
+
+private:
+    QList<Heartbeat> writes_;
+    QList<Heartbeat> plain_;
+    qsizetype capacity_;
+};
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "heartbeattransport.h"
+#include "processrunner.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeTransport, "wakatime-transport")
+
+constexpr auto kUnlimitedBatchSize = std::numeric_limits<qsizetype>::max();
+
+namespace {
+HeartbeatTransport::Result fromProcessResult(ProcessRunner::Result result) {
+    switch (result) {
+    case ProcessRunner::Succeeded:
+        return HeartbeatTransport::Sent;
+    case ProcessRunner::Deferred:
+        return HeartbeatTransport::Queued;
+    case ProcessRunner::TimedOut:
+        return HeartbeatTransport::TimedOut;
+    case ProcessRunner::Failed:
+        break;
+    }
+    return HeartbeatTransport::Failed;
+}
+
+/** The worse of two results, so a batch only counts as sent if every part of it was. */
+HeartbeatTransport::Result worse(HeartbeatTransport::Result a, HeartbeatTransport::Result b) {
+    if (a == HeartbeatTransport::Sent ||
+        (a == HeartbeatTransport::Queued && b != HeartbeatTransport::Sent)) {
+        return b;
+    }
+    return a;
+}
+} // namespace
+
+HeartbeatTransport::~HeartbeatTransport() = default;
+
+CliTransport::CliTransport(ProcessRunner &runner, std::function<QString()> locateProgram)
+    : runner_(runner), locateProgram_(std::move(locateProgram)) {
+}
+
+bool CliTransport::isAvailable() {
+    return !locateProgram_().isEmpty();
+}
+
+qsizetype CliTransport::maxBatchSize() const {
+    return 1;
+}
+
+QStringList CliTransport::arguments(const Heartbeat &heartbeat) {
+    // The same for every heartbeat, so built once and shared.
+    static const QStringList pluginArguments{QStringLiteral("--plugin"),
+                                             QStringLiteral("ktexteditor-wakatime/" VERSION)};
+    return heartbeat.toArguments(pluginArguments);
+}
+
+void CliTransport::start(const QList<Heartbeat> &heartbeats,
+                         std::function<void(Result)> onFinished) {
+    if (heartbeats.isEmpty()) {
+        onFinished(Sent);
+        return;
+    }
+    const auto program = locateProgram_();
+    // One process each. The result is reported once all of them have finished.
+    auto remaining = std::make_shared<qsizetype>(heartbeats.size());
+    auto combined = std::make_shared<Result>(Sent);
+    for (const auto &heartbeat : heartbeats) {
+        runner_.start(program,
+                      arguments(heartbeat),
+                      QByteArray(),
+                      [remaining, combined, onFinished](ProcessRunner::Result result) {
+                          *combined = worse(*combined, fromProcessResult(result));
+                          if (--*remaining == 0) {
+                              onFinished(*combined);
+                          }
+                      });
+    }
+}
+
+HeartbeatTransport::Result CliTransport::run(const QList<Heartbeat> &heartbeats) {
+    const auto program = locateProgram_();
+    auto result = Sent;
+    for (const auto &heartbeat : heartbeats) {
+        result = worse(result, fromProcessResult(runner_.run(program, arguments(heartbeat))));
+    }
+    return result;
+}
+
+qsizetype CliTransport::running() const {
+    return runner_.running();
+}
+
+void CliTransport::waitForFinished(QDeadlineTimer deadline) {
+    runner_.waitForFinished(deadline);
+}
+
+qsizetype BatchedCliTransport::maxBatchSize() const {
+    return kUnlimitedBatchSize;
+}
+
+QStringList BatchedCliTransport::arguments(const QList<Heartbeat> &heartbeats,
+                                           QByteArray &input) {
+    auto args = CliTransport::arguments(heartbeats.first());
+    input.clear();
+    if (heartbeats.size() > 1) {
+        QJsonArray extraHeartbeats;
+        for (auto it = heartbeats.cbegin() + 1; it != heartbeats.cend(); ++it) {
+            extraHeartbeats.append(it->toJson());
+        }
+        args << QStringLiteral("--extra-heartbeats");
+        input = QJsonDocument(extraHeartbeats).toJson(QJsonDocument::Compact);
+    }
+    return args;
+}
+
+void BatchedCliTransport::start(const QList<Heartbeat> &heartbeats,
+                                std::function<void(Result)> onFinished) {
+    QByteArray input;
+    const auto args = arguments(heartbeats, input);
+    runner_.start(locateProgram_(), args, input, [onFinished](ProcessRunner::Result result) {
+        onFinished(fromProcessResult(result));
+    });
+}
+
+HeartbeatTransport::Result BatchedCliTransport::run(const QList<Heartbeat> &heartbeats) {
+    QByteArray input;
+    const auto args = arguments(heartbeats, input);
+    return fromProcessResult(runner_.run(locateProgram_(), args, input));
+}
+
+JournalTransport::JournalTransport(const QString &path)
+    : journal_(path), refused_(QFileInfo(path).absoluteFilePath() ==
+                               QFileInfo(HeartbeatJournal::defaultPath()).absoluteFilePath()) {
+    if (refused_) {
+        qCWarning(gLogWakaTimeTransport) << "Cannot use the offline journal" << path
+                                         << "as a transport";
+    }
+}
+
+bool JournalTransport::isAvailable() {
+    return !refused_;
+}
+
+qsizetype JournalTransport::maxBatchSize() const {
+    return kUnlimitedBatchSize;
+}
+
+void JournalTransport::start(const QList<Heartbeat> &heartbeats,
+                             std::function<void(Result)> onFinished) {
+    onFinished(run(heartbeats));
+}
+
+HeartbeatTransport::Result JournalTransport::run(const QList<Heartbeat> &heartbeats) {
+    if (refused_) {
+        return Failed;
+    }
+    qCDebug(gLogWakaTimeTransport) << "Journalling" << heartbeats.size() << "heartbeats";
+    journal_.append(heartbeats);
+    return Sent;
+}
+
+qsizetype JournalTransport::running() const {
+    return 0;
+}
+
+void JournalTransport::waitForFinished(QDeadlineTimer deadline) {
+    Q_UNUSED(deadline);
+}
+
+HeartbeatJournal &JournalTransport::journal() {
+    return journal_;
+}
+
+RecordingTransport::RecordingTransport() : maxBatchSize_(kUnlimitedBatchSize) {
+}
+
+bool RecordingTransport::isAvailable() {
+    return available_;
+}
+
+qsizetype RecordingTransport::maxBatchSize() const {
+    return maxBatchSize_;
+}
+
+void RecordingTransport::start(const QList<Heartbeat> &heartbeats,
+                               std::function<void(Result)> onFinished) {
+    onFinished(run(heartbeats));
+}
+
+HeartbeatTransport::Result RecordingTransport::run(const QList<Heartbeat> &heartbeats) {
+    batches_.append(heartbeats);
+    return result_;
+}
+
+qsizetype RecordingTransport::running() const {
+    return 0;
+}
+
+void RecordingTransport::waitForFinished(QDeadlineTimer deadline) {
+    Q_UNUSED(deadline);
+}
+
+const QList<QList<Heartbeat>> &RecordingTransport::batches() const {
+    return batches_;
+}
+
+QList<Heartbeat> RecordingTransport::heartbeats() const {
+    QList<Heartbeat> heartbeats;
+    for (const auto &batch : batches_) {
+        heartbeats << batch;
+    }
+    return heartbeats;
+}
+
+void RecordingTransport::clear() {
+    batches_.clear();
+}
+
+void RecordingTransport::setResult(Result result) {
+    result_ = result;
+}
+
+void RecordingTransport::setAvailable(bool available) {
+    available_ = available;
+}
+
+void RecordingTransport::setMaxBatchSize(qsizetype size) {
+    maxBatchSize_ = qMax<qsizetype>(size, 1);
+}
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QList>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QStringList>
+
+#include <functional>
+
+#include "heartbeat.h"
+#include "heartbeatjournal.h"
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeTransport)
+
+class ProcessRunner;
+
+/**
+ * Delivers heartbeats somewhere. WakaTime decides what to send and when, and hands each batch to
+ * a transport. This keeps the dispatch strategy replaceable without changing the editor side.
+ */
+class HeartbeatTransport {
+public:
+    /** Result of delivering heartbeats. */
+    enum Result {
+        Failed,   /**< The heartbeats were not delivered. */
+        Queued,   /**< The heartbeats were kept to be delivered later by the receiver itself. */
+        Sent,     /**< The heartbeats were delivered. */
+        TimedOut, /**< Delivery did not finish in time and was stopped. */
+    };
+
+    virtual ~HeartbeatTransport();
+    /**
+     * Check if heartbeats can be delivered at all, for example if `wakatime-cli` is installed.
+     *
+     * @return `true` if available.
+     */
+    virtual bool isAvailable() = 0;
+    /**
+     * Get the most heartbeats that can be passed to start() or run() at once.
+     *
+     * @return Number of heartbeats.
+     */
+    virtual qsizetype maxBatchSize() const = 0;
+    /**
+     * Deliver heartbeats without blocking. @p onFinished may be called before this returns.
+     *
+     * @param heartbeats Heartbeats, at most maxBatchSize().
+     * @param onFinished Called once with the result.
+     */
+    virtual void start(const QList<Heartbeat> &heartbeats,
+                       std::function<void(Result)> onFinished) = 0;
+    /**
+     * Deliver heartbeats and wait for the result.
+     *
+     * @param heartbeats Heartbeats, at most maxBatchSize().
+     * @return The result.
+     */
+    virtual Result run(const QList<Heartbeat> &heartbeats) = 0;
+    /**
+     * Get the number of deliveries started with start() that have not finished.
+     *
+     * @return Number of deliveries.
+     */
+    virtual qsizetype running() const = 0;
+    /**
+     * Wait for deliveries started with start() to finish.
+     *
+     * @param deadline When to stop waiting.
+     */
+    virtual void waitForFinished(QDeadlineTimer deadline) = 0;
+};
+
+/** Runs `wakatime-cli` once for each heartbeat. */
+class CliTransport : public HeartbeatTransport {
+public:
+    /**
+     * Constructor.
+     *
+     * @param runner Runs the processes. Must outlive the transport.
+     * @param locateProgram Returns the path to `wakatime-cli`, or an empty string if not found.
+     */
+    CliTransport(ProcessRunner &runner, std::function<QString()> locateProgram);
+    bool isAvailable() override;
+    qsizetype maxBatchSize() const override;
+    void start(const QList<Heartbeat> &heartbeats,
+               std::function<void(Result)> onFinished) override;
+    Result run(const QList<Heartbeat> &heartbeats) override;
+    qsizetype running() const override;
+    void waitForFinished(QDeadlineTimer deadline) override;
+    /**
+     * Full `wakatime-cli` argument list for a heartbeat.
+     *
+     * @param heartbeat The heartbeat.
+     * @return Arguments, including `--plugin`.
+     */
+    static QStringList arguments(const Heartbeat &heartbeat);
+
+protected:
+    ProcessRunner &runner_;
+    std::function<QString()> locateProgram_;
+};
+
+/**
+ * Runs `wakatime-cli` once for a batch of heartbeats. The first heartbeat goes on the command line
+ * and the rest are written to standard input for `--extra-heartbeats`.
+ */
+class BatchedCliTransport : public CliTransport {
+public:
+    using CliTransport::CliTransport;
+    qsizetype maxBatchSize() const override;
+    void start(const QList<Heartbeat> &heartbeats,
+               std::function<void(Result)> onFinished) override;
+    Result run(const QList<Heartbeat> &heartbeats) override;
+    /**
+     * Arguments to send a batch with one invocation.
+     *
+     * @param heartbeats Heartbeats. Must not be empty.
+     * @param[out] input Set to the data to write to standard input. Empty for a single heartbeat.
+     * @return Arguments.
+     */
+    static QStringList arguments(const QList<Heartbeat> &heartbeats, QByteArray &input);
+};
+
+/**
+ * Appends heartbeats to a journal file instead of sending them, for offline use or for sending
+ * later with another tool. Delivery always succeeds. Write errors are logged by the journal.
+ *
+ * The journal WakaTime replays from (HeartbeatJournal::defaultPath()) is refused, as every replayed
+ * heartbeat would be appended to it again. The transport is then unavailable.
+ */
+class JournalTransport : public HeartbeatTransport {
+public:
+    /**
+     * Constructor.
+     *
+     * @param path Journal file path.
+     */
+    explicit JournalTransport(const QString &path);
+    bool isAvailable() override;
+    qsizetype maxBatchSize() const override;
+    void start(const QList<Heartbeat> &heartbeats,
+               std::function<void(Result)> onFinished) override;
+    Result run(const QList<Heartbeat> &heartbeats) override;
+    qsizetype running() const override;
+    void waitForFinished(QDeadlineTimer deadline) override;
+    /**
+     * Get the journal.
+     *
+     * @return The journal.
+     */
+    HeartbeatJournal &journal();
+
+private:
+    HeartbeatJournal journal_;
+    bool refused_;
+};
+
+/** Keeps delivered heartbeats in memory. For tests and load tests. */
+class RecordingTransport : public HeartbeatTransport {
+public:
+    /** Constructor. */
+    RecordingTransport();
+    bool isAvailable() override;
+    qsizetype maxBatchSize() const override;
+    void start(const QList<Heartbeat> &heartbeats,
+               std::function<void(Result)> onFinished) override;
+    Result run(const QList<Heartbeat> &heartbeats) override;
+    qsizetype running() const override;
+    void waitForFinished(QDeadlineTimer deadline) override;
+    /**
+     * Get the batches delivered so far, in order.
+     *
+     * @return Batches of heartbeats.
+     */
+    const QList<QList<Heartbeat>> &batches() const;
+    /**
+     * Get every heartbeat delivered so far, in order.
+     *
+     * @return Heartbeats.
+     */
+    QList<Heartbeat> heartbeats() const;
+    /** Forget the delivered heartbeats. */
+    void clear();
+    /**
+     * Set the result reported for deliveries from now on. Defaults to Sent. Failed deliveries
+     * are recorded too.
+     *
+     * @param result The result.
+     */
+    void setResult(Result result);
+    /**
+     * Set what isAvailable() returns. Defaults to `true`.
+     *
+     * @param available Flag.
+     */
+    void setAvailable(bool available);
+    /**
+     * Set the most heartbeats accepted at once. Defaults to no limit.
+     *
+     * @param size Number of heartbeats.
+     */
+    void setMaxBatchSize(qsizetype size);
+
+private:
+    QList<QList<Heartbeat>> batches_;
+    Result result_ = Sent;
+    bool available_ = true;
+    qsizetype maxBatchSize_;
+};
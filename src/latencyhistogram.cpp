@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QString>
+
+#include <bit>
+#include <cmath>
+
+#include "latencyhistogram.h"
+
+namespace {
+qint64 upperBound(int bucket) {
+    return bucket == 0 ? 0 : (qint64(1) << bucket) - 1;
+}
+} // namespace
+
+void LatencyHistogram::record(qint64 us) {
+    us = qMax<qint64>(us, 0);
+    const auto bucket = qMin<int>(std::bit_width(quint64(us)), kBuckets - 1);
+    ++buckets_[bucket];
+    ++count_;
+    total_ += us;
+    max_ = qMax(max_, us);
+}
+
+quint64 LatencyHistogram::count() const {
+    return count_;
+}
+
+qint64 LatencyHistogram::total() const {
+    return total_;
+}
+
+qint64 LatencyHistogram::max() const {
+    return max_;
+}
+
+qint64 LatencyHistogram::percentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto fraction = qBound(0.0, percentile, 100.0) / 100;
+    const auto rank = qMax<quint64>(1, quint64(std::ceil(double(count_) * fraction)));
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return qMin(upperBound(i), max_);
+        }
+    }
+    return max_; // LCOV_EXCL_LINE
+}
+
+void LatencyHistogram::clear() {
+    buckets_.fill(0);
+    count_ = 0;
+    total_ = 0;
+    max_ = 0;
+}
+
+QJsonObject LatencyHistogram::toJson() const {
+    QJsonObject buckets;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (buckets_[i]) {
+            buckets.insert(QString::number(upperBound(i)), qint64(buckets_[i]));
+        }
+    }
+    return {
+        {QStringLiteral("count"), qint64(count_)},
+        {QStringLiteral("totalUs"), total_},
+        {QStringLiteral("maxUs"), max_},
+        {QStringLiteral("p50Us"), percentile(50)},
+        {QStringLiteral("p90Us"), percentile(90)},
+        {QStringLiteral("p99Us"), percentile(99)},
+        {QStringLiteral("buckets"), buckets},
+    };
+}
+
+LatencyTimer::LatencyTimer(LatencyHistogram &histogram) : histogram_(histogram) {
+    timer_.start();
+}
+
+LatencyTimer::~LatencyTimer() {
+    histogram_.record(timer_.nsecsElapsed() / 1000);
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonObject>
+
+#include <array>
+
+/**
+ * Fixed-size histogram of durations in microseconds. Bucket boundaries are powers of two so
+ * recording is constant time and does not allocate. Percentiles are reported as the upper bound
+ * of the bucket they fall in.
+ */
+class LatencyHistogram {
+public:
+    /**
+     * Record a duration.
+     *
+     * @param us Duration in microseconds. Negative values are recorded as 0.
+     */
+    void record(qint64 us);
+    /**
+     * Get the number of recorded durations.
+     *
+     * @return Number of durations.
+     */
+    quint64 count() const;
+    /**
+     * Get the sum of all recorded durations.
+     *
+     * @return Total in microseconds.
+     */
+    qint64 total() const;
+    /**
+     * Get the longest recorded duration.
+     *
+     * @return Maximum in microseconds.
+     */
+    qint64 max() const;
+    /**
+     * Get an upper bound for a percentile.
+     *
+     * @param percentile Percentile between 0 and 100.
+     * @return Upper bound in microseconds, never more than max(). 0 if nothing was recorded.
+     */
+    qint64 percentile(double percentile) const;
+    /** Forget all recorded durations. */
+    void clear();
+    /**
+     * Get the histogram as JSON.
+     *
+     * @return Object with `count`, `totalUs`, `maxUs`, `p50Us`, `p90Us`, `p99Us` and `buckets`,
+     * which maps the upper bound of each non-empty bucket to its count.
+     */
+    QJsonObject toJson() const;
+
+private:
+    // Bucket 0 holds 0 µs, bucket n holds [2^(n-1), 2^n) µs. The last bucket holds everything
+    // from about 36 minutes.
+    static constexpr int kBuckets = 32;
+
+    std::array<quint64, kBuckets> buckets_{};
+    quint64 count_ = 0;
+    qint64 total_ = 0;
+    qint64 max_ = 0;
+};
+
+/** Records the time between construction and destruction into a LatencyHistogram. */
+class LatencyTimer {
+public:
+    /**
+     * Constructor. Starts timing.
+     *
+     * @param histogram Histogram to record into. Must outlive this object.
+     */
+    explicit LatencyTimer(LatencyHistogram &histogram);
+    /** Destructor. Records the elapsed time. */
+    ~LatencyTimer();
+
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+
+private:
+    LatencyHistogram &histogram_;
+    QElapsedTimer timer_;
+};
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QProcess>
+#include <QtCore/QTimer>
+
+#include <memory>
+#include <utility>
+
+#include "processrunner.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeProcessRunner, "wakatime-process-runner")
+
+ProcessRunner::ProcessRunner(int timeoutMs, int killTimeoutMs, QObject *parent)
+    : QObject(parent), timeoutMs_(timeoutMs), killTimeoutMs_(killTimeoutMs) {
+}
+
+ProcessRunner::~ProcessRunner() {
+    // The result handlers may refer to objects that are already gone.
+    for (auto process : std::exchange(running_, {})) {
+        process->disconnect(this);
+        delete process;
+    }
+}
+
+QProcess *ProcessRunner::start(const QString &program,
+                               const QStringList &arguments,
+                               const QByteArray &input,
+                               std::function<void(Result)> onFinished) {
+    auto process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::ForwardedChannels);
+    running_.insert(process);
+    auto timedOut = std::make_shared<bool>(false);
+    // Owned by the process so it cannot fire after the process is gone.
+    auto deadline = new QTimer(process);
+    deadline->setSingleShot(true);
+    connect(deadline, &QTimer::timeout, this, [this, process, program, timedOut]() {
+        qCWarning(gLogWakaTimeProcessRunner)
+            << program << "did not exit within" << timeoutMs_ << "ms, stopping it";
+        *timedOut = true;
+        stop(process);
+    });
+    const auto done = [this, process, deadline, onFinished](Result result) {
+        deadline->stop();
+        running_.remove(process);
+        process->deleteLater();
+        onFinished(result);
+    };
+    connect(process,
+            &QProcess::finished,
+            this,
+            [this, program, timedOut, done](int exitCode, QProcess::ExitStatus exitStatus) {
+                if (*timedOut) {
+                    done(TimedOut);
+                    return;
+                }
+                done(exitResult(program, exitStatus == QProcess::NormalExit, exitCode));
+            });
+    // finished() is not emitted if the process could not be started at all.
+    connect(process,
+            &QProcess::errorOccurred,
+            this,
+            [process, program, done](QProcess::ProcessError error) {
+                if (error != QProcess::FailedToStart) {
+                    return;
+                }
+                qCWarning(gLogWakaTimeProcessRunner)
+                    << "Failed to start" << program << process->errorString();
+                done(Failed);
+            });
+    qCDebug(gLogWakaTimeProcessRunner)
+        << "Starting:" << program << arguments.join(QStringLiteral(" "));
+    deadline->start(timeoutMs_);
+    process->start(program, arguments);
+    if (!input.isEmpty()) {
+        process->write(input);
+    }
+    process->closeWriteChannel();
+    return process;
+}
+
+ProcessRunner::Result ProcessRunner::run(const QString &program,
+                                         const QStringList &arguments,
+                                         const QByteArray &input) {
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedChannels);
+    qCDebug(gLogWakaTimeProcessRunner)
+        << "Running:" << program << arguments.join(QStringLiteral(" "));
+    process.start(program, arguments);
+    if (!input.isEmpty()) {
+        process.write(input);
+    }
+    process.closeWriteChannel();
+    if (process.waitForFinished(timeoutMs_)) {
+        return exitResult(
+            program, process.exitStatus() == QProcess::NormalExit, process.exitCode());
+    }
+    if (process.state() == QProcess::NotRunning) {
+        qCWarning(gLogWakaTimeProcessRunner)
+            << "Failed to run" << program << process.errorString();
+        return Failed;
+    }
+    qCWarning(gLogWakaTimeProcessRunner)
+        << program << "did not exit within" << timeoutMs_ << "ms, stopping it";
+    process.terminate();
+    if (!process.waitForFinished(killTimeoutMs_)) {
+        process.kill();
+        process.waitForFinished(killTimeoutMs_);
+    }
+    return TimedOut;
+}
+
+qsizetype ProcessRunner::running() const {
+    return running_.size();
+}
+
+void ProcessRunner::waitForFinished(QDeadlineTimer deadline) {
+    while (!running_.isEmpty() && !deadline.hasExpired()) {
+        // Reporting the result removes the process from running_.
+        if (!(*running_.cbegin())->waitForFinished(int(deadline.remainingTime()))) {
+            return;
+        }
+    }
+}
+
+int ProcessRunner::timeout() const {
+    return timeoutMs_;
+}
+
+void ProcessRunner::setTimeout(int ms) {
+    timeoutMs_ = ms;
+}
+
+void ProcessRunner::setKillTimeout(int ms) {
+    killTimeoutMs_ = ms;
+}
+
+QSet<int> ProcessRunner::deferredExitCodes() const {
+    return deferredExitCodes_;
+}
+
+void ProcessRunner::setDeferredExitCodes(const QSet<int> &codes) {
+    deferredExitCodes_ = codes;
+}
+
+void ProcessRunner::stop(QProcess *process) {
+    // Lets wakatime-cli exit cleanly. On Windows this only works for processes with a window, so
+    // the kill below is what stops it there.
+    process->terminate();
+    QTimer::singleShot(killTimeoutMs_, process, [process]() {
+        if (process->state() != QProcess::NotRunning) {
+            qCWarning(gLogWakaTimeProcessRunner) << "Killing" << process->program();
+            process->kill();
+        }
+    });
+}
+
+ProcessRunner::Result
+ProcessRunner::exitResult(const QString &program, bool normalExit, int exitCode) const {
+    if (normalExit && exitCode == 0) {
+        return Succeeded;
+    }
+    qCWarning(gLogWakaTimeProcessRunner) << program << "returned error code" << exitCode;
+    if (normalExit && deferredExitCodes_.contains(exitCode)) {
+        return Deferred;
+    }
+    return Failed;
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+
+#include <functional>
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeProcessRunner)
+
+class QProcess;
+
+/**
+ * Runs processes with a deadline. A process still running when its deadline passes is asked to
+ * terminate and is killed if it has not exited after a grace period, so a hung process cannot
+ * block the caller or stay around indefinitely.
+ */
+class ProcessRunner : public QObject {
+    Q_OBJECT
+
+public:
+    /** Result of running a process. */
+    enum Result {
+        Deferred,  /**< The process exited with one of deferredExitCodes(). */
+        Failed,    /**< The process could not be started, crashed or exited with non-zero. */
+        Succeeded, /**< The process exited with 0. */
+        TimedOut,  /**< The process was still running at the deadline and was stopped. */
+    };
+    Q_ENUM(Result)
+
+    /**
+     * Constructor.
+     *
+     * @param timeoutMs Deadline for each process in milliseconds.
+     * @param killTimeoutMs Time given to a process to exit after being asked to terminate.
+     * @param parent Parent object.
+     */
+    explicit ProcessRunner(int timeoutMs, int killTimeoutMs, QObject *parent = nullptr);
+    /** Destructor. Kills running processes without reporting their results. */
+    ~ProcessRunner() override;
+    /**
+     * Start a process without blocking. Output is forwarded to the caller's output channels.
+     *
+     * @param program Program to run.
+     * @param arguments Command line arguments.
+     * @param input Data written to standard input. May be empty.
+     * @param onFinished Called once with the result.
+     * @return The started process. It is deleted after @p onFinished is called.
+     */
+    QProcess *start(const QString &program,
+                    const QStringList &arguments,
+                    const QByteArray &input,
+                    std::function<void(Result)> onFinished);
+    /**
+     * Run a process and wait for it to exit, at most until the deadline plus the kill timeout.
+     *
+     * @param program Program to run.
+     * @param arguments Command line arguments.
+     * @param input Data written to standard input. May be empty.
+     * @return The result.
+     */
+    Result run(const QString &program,
+               const QStringList &arguments,
+               const QByteArray &input = QByteArray());
+    /**
+     * Get the number of processes started with start() that have not finished.
+     *
+     * @return Number of processes.
+     */
+    qsizetype running() const;
+    /**
+     * Wait for the processes started with start() to finish. Their results are reported before
+     * this returns.
+     *
+     * @param deadline When to stop waiting.
+     */
+    void waitForFinished(QDeadlineTimer deadline);
+    /**
+     * Get the deadline.
+     *
+     * @return Deadline in milliseconds.
+     */
+    int timeout() const;
+    /**
+     * Set the deadline for processes started from now on.
+     *
+     * @param ms Deadline in milliseconds.
+     */
+    void setTimeout(int ms);
+    /**
+     * Set the time given to a process to exit after being asked to terminate.
+     *
+     * @param ms Time in milliseconds.
+     */
+    void setKillTimeout(int ms);
+    /**
+     * Get the exit codes reported as Deferred rather than Failed.
+     *
+     * @return Exit codes.
+     */
+    QSet<int> deferredExitCodes() const;
+    /**
+     * Set the exit codes with which a program reports that it will finish its work later, such
+     * as `wakatime-cli` keeping heartbeats in its offline queue. They are reported as Deferred.
+     *
+     * @param codes Exit codes. Empty by default.
+     */
+    void setDeferredExitCodes(const QSet<int> &codes);
+
+private:
+    /** Ask @p process to terminate and schedule a kill. */
+    void stop(QProcess *process);
+    /** Result of a process that exited, or crashed if not @p normalExit. Logs any failure. */
+    Result exitResult(const QString &program, bool normalExit, int exitCode) const;
+
+    int timeoutMs_;
+    int killTimeoutMs_;
+    QSet<QProcess *> running_;
+    QSet<int> deferredExitCodes_;
+};
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStringList>
+
+#include "cachewatcher.h"
+#include "projectresolver.h"
+
+// Plenty for any sane number of open projects. The cache is dropped if exceeded.
+constexpr qsizetype kMaxEntries = 8192;
+// Longer than any sensible project or branch name.
+constexpr qint64 kMaxLineLength = 1024;
+const auto kProjectFileName = QStringLiteral(".wakatime-project");
+
+namespace {
+bool isSameOrDescendant(const QString &path, const QString &ancestor) {
+    return path == ancestor ||
+           (path.startsWith(ancestor) &&
+            (ancestor.endsWith(QLatin1Char('/')) || path.at(ancestor.size()) == QLatin1Char('/')));
+}
+} // namespace
+
+ProjectResolver::ProjectResolver(CacheWatcher *watcher) : watcher_(watcher) {
+}
+
+const QList<ProjectResolver::Marker> &ProjectResolver::markers() {
+    // Most common first to keep the number of probes per level down.
+    static const QList<Marker> kMarkers{
+        {QStringLiteral(".git"), Marker::DirectoryOrFile},
+        {QStringLiteral(".hg"), Marker::Directory},
+        {QStringLiteral(".svn"), Marker::Directory},
+        {QStringLiteral(".bzr"), Marker::Directory},
+        {kProjectFileName, Marker::File},
+    };
+    return kMarkers;
+}
+
+QString ProjectResolver::projectRoot(const QString &canonicalDirectory) {
+    if (canonicalDirectory.isEmpty()) {
+        return QString();
+    }
+    if (auto it = cache_.constFind(canonicalDirectory); it != cache_.cend()) {
+        stats_.hits++;
+        return it.value();
+    }
+    stats_.misses++;
+    QStringList visited;
+    QString root;
+    auto current = canonicalDirectory;
+    while (true) {
+        // An ancestor may already be known from a lookup in a sibling directory.
+        if (auto it = cache_.constFind(current); it != cache_.cend()) {
+            root = it.value();
+            break;
+        }
+        // The file system root is never considered a project.
+        if (QDir(current).isRoot()) {
+            break;
+        }
+        visited << current;
+        if (isProjectRoot(current)) {
+            root = current;
+            break;
+        }
+        // QFileInfo::path() only parses the string so this does not touch the file system.
+        auto parent = QFileInfo(current).path();
+        if (parent == current) {
+            break;
+        }
+        current = parent;
+    }
+    // Start over rather than stop caching once full. With a watcher every entry holds a watch, so
+    // the cache is also kept within its limit.
+    auto maxEntries = kMaxEntries;
+    if (watcher_) {
+        const auto available = watcher_->maxDirectories() - watcher_->size();
+        maxEntries = qMin(maxEntries, available + cache_.size());
+    }
+    if (cache_.size() + visited.size() > maxEntries) {
+        qCDebug(gLogWakaTimeCacheWatcher) << "Project cache full, clearing" << cache_.size()
+                                          << "entries";
+        clearCache();
+    }
+    // Cache from the top down. A directory below one that cannot be watched would not be
+    // invalidated if a VCS directory appeared there, so stop at the first failure.
+    for (auto it = visited.crbegin(); it != visited.crend(); ++it) {
+        if (watcher_ && !watcher_->watch(*it)) {
+            break;
+        }
+        cache_.insert(*it, root);
+    }
+    return root;
+}
+
+ProjectResolver::ProjectFile ProjectResolver::projectFile(const QString &root) {
+    if (root.isEmpty()) {
+        return ProjectFile();
+    }
+    auto it = projectFiles_.find(root);
+    // The file being created is reported by the watcher through invalidate().
+    if (it != projectFiles_.end() && !it->exists && watcher_) {
+        return ProjectFile();
+    }
+    const QFileInfo fileInfo(root + QLatin1Char('/') + kProjectFileName);
+    const auto exists = fileInfo.isFile();
+    if (it != projectFiles_.end() && it->exists == exists &&
+        (!exists || (fileInfo.lastModified() == it->modified && fileInfo.size() == it->size))) {
+        return it->names;
+    }
+    if (it == projectFiles_.end()) {
+        if (projectFiles_.size() >= kMaxEntries) {
+            projectFiles_.clear();
+        }
+        it = projectFiles_.insert(root, ProjectFileEntry());
+    }
+    it->exists = exists;
+    it->names = ProjectFile();
+    if (exists) {
+        it->modified = fileInfo.lastModified();
+        it->size = fileInfo.size();
+        // The same format as wakatime-cli reads: the project name, then optionally the branch.
+        QFile file(fileInfo.filePath());
+        if (file.open(QIODevice::ReadOnly)) {
+            it->names.project = QString::fromUtf8(file.readLine(kMaxLineLength).trimmed());
+            it->names.branch = QString::fromUtf8(file.readLine(kMaxLineLength).trimmed());
+        }
+    }
+    return it->names;
+}
+
+ProjectResolver::Stats ProjectResolver::stats() const {
+    auto stats = stats_;
+    stats.entries = cache_.size();
+    return stats;
+}
+
+void ProjectResolver::resetStats() {
+    stats_ = Stats();
+}
+
+void ProjectResolver::clear() {
+    clearCache();
+    projectFiles_.clear();
+    stats_ = Stats();
+}
+
+void ProjectResolver::invalidate(const QString &directory) {
+    projectFiles_.remove(directory);
+    // Saving a file changes its directory too, but the results only depend on whether the
+    // directory is a project root, so check that before dropping anything.
+    if (auto it = cache_.constFind(directory);
+        it != cache_.cend() && QFileInfo(directory).isDir() &&
+        (it.value() == directory) == isProjectRoot(directory)) {
+        return;
+    }
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        const auto &root = it.value();
+        if (isSameOrDescendant(it.key(), directory) &&
+            (root.isEmpty() || isSameOrDescendant(directory, root))) {
+            if (watcher_) {
+                watcher_->unwatch(it.key());
+            }
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ProjectResolver::clearCache() {
+    if (watcher_) {
+        for (auto it = cache_.cbegin(); it != cache_.cend(); ++it) {
+            watcher_->unwatch(it.key());
+        }
+    }
+    cache_.clear();
+}
+
+bool ProjectResolver::isProjectRoot(const QString &directory) {
+    for (const auto &marker : markers()) {
+        stats_.probes++;
+        // QFileInfo fetches all metadata with a single stat() and caches it.
+        const QFileInfo fileInfo(directory + QLatin1Char('/') + marker.name);
+        if ((marker.type != Marker::File && fileInfo.isDir()) ||
+            (marker.type != Marker::Directory && fileInfo.isFile())) {
+            return true;
+        }
+    }
+    return false;
+}
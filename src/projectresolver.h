@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+class CacheWatcher;
+
+/**
+ * Memoising lookup of the project root for a directory. Walks up from a directory until a
+ * directory containing one of the markers() is found. Every directory visited on the way is cached,
+ * including directories that are not in any project, so later lookups from the same tree cost a
+ * hash lookup. If a CacheWatcher is given, only directories it can watch are cached, so that
+ * invalidate() can be called whenever one of them changes. Each entry then holds a watch until it
+ * is dropped, and the cache is cleared rather than grown past the watcher's limit.
+ */
+class ProjectResolver {
+public:
+    /** An entry whose presence makes a directory a project root. */
+    struct Marker {
+        /** Kinds of entry that count. */
+        enum Type {
+            Directory,
+            File,
+            /** Either, such as `.git`, which is a file in worktrees and submodules. */
+            DirectoryOrFile,
+        };
+        /** File name of the entry. */
+        QString name;
+        /** Kind of entry. */
+        Type type;
+    };
+    /** Names set by a `.wakatime-project` file. */
+    struct ProjectFile {
+        /** Project name from the first line. Empty if not set. */
+        QString project;
+        /** Branch name from the second line. Empty if not set. */
+        QString branch;
+    };
+    /** Cache statistics. */
+    struct Stats {
+        /** Lookups answered from the cache. */
+        quint64 hits = 0;
+        /** Lookups that had to walk the file system. */
+        quint64 misses = 0;
+        /** File system probes made. */
+        quint64 probes = 0;
+        /** Directories in the cache. */
+        qsizetype entries = 0;
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param watcher Watcher to register cached directories with. May be `nullptr`.
+     */
+    explicit ProjectResolver(CacheWatcher *watcher = nullptr);
+    /**
+     * Get the project markers, in the order they are probed. Each costs one `stat()` per directory
+     * level.
+     *
+     * @return Markers.
+     */
+    static const QList<Marker> &markers();
+    /**
+     * Find the project root for a directory.
+     *
+     * @param canonicalDirectory Canonical path of the directory.
+     * @return Canonical path of the project root, or an empty string if not in a project.
+     */
+    QString projectRoot(const QString &canonicalDirectory);
+    /**
+     * Read the `.wakatime-project` file of a project root. The result is cached with the file's
+     * modification time and size. Without a CacheWatcher, roots without the file are probed again
+     * on each call.
+     *
+     * @param root Project root returned by projectRoot().
+     * @return The names in the file, empty if there is no file.
+     */
+    ProjectFile projectFile(const QString &root);
+    /**
+     * Get cache statistics.
+     *
+     * @return Statistics.
+     */
+    Stats stats() const;
+    /** Reset the statistics without clearing the cache. */
+    void resetStats();
+    /** Clear the cache and statistics. */
+    void clear();
+    /**
+     * Drop cached results that depend on the contents of a directory. These are the directory
+     * itself and its descendants, if the directory is between them and their project root. Nothing
+     * is dropped if a cached directory is still a project root, or still not one, as is the case
+     * after saving a file in it. That check costs one probe per marker.
+     *
+     * @param directory Canonical path of the directory that changed.
+     */
+    void invalidate(const QString &directory);
+
+private:
+    /** Check if @p directory directly contains one of the markers(). */
+    bool isProjectRoot(const QString &directory);
+    /** Drop every entry, releasing their watches. */
+    void clearCache();
+
+    struct ProjectFileEntry {
+        bool exists = false;
+        QDateTime modified;
+        qint64 size = 0;
+        ProjectFile names;
+    };
+
+    // Canonical directory to project root. Empty values are cached misses.
+    QHash<QString, QString> cache_;
+    // Project root to its .wakatime-project file.
+    QHash<QString, ProjectFileEntry> projectFiles_;
+    Stats stats_;
+    CacheWatcher *watcher_;
+};
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+
+#include <limits>
+
+#include "sessionrecorder.h"
+
+Q_LOGGING_CATEGORY(gLogWakaTimeSession, "wakatime-session")
+
+namespace {
+constexpr quint32 kMagic = 0x4b575352; // "KWSR"
+constexpr quint16 kVersion = 1;
+// Record tags. Event records use the EditorEvent::Type value.
+constexpr quint8 kDocumentTag = 0xff;
+constexpr auto kDataStreamVersion = QDataStream::Qt_6_5;
+
+QString documentKey(const DocumentState &document) {
+    return document.filePath + QLatin1Char('\n') + document.mode;
+}
+} // namespace
+
+SessionRecorder::SessionRecorder(const QString &path) : file_(path) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(gLogWakaTimeSession) << "Cannot record session" << path << file_.errorString();
+        return;
+    }
+    stream_.setDevice(&file_);
+    stream_.setVersion(kDataStreamVersion);
+    lastTimeMs_ = QDateTime::currentMSecsSinceEpoch();
+    stream_ << kMagic << kVersion << qint64(lastTimeMs_);
+    qCDebug(gLogWakaTimeSession) << "Recording session to" << path;
+}
+
+SessionRecorder::~SessionRecorder() {
+    flush();
+}
+
+bool SessionRecorder::isOpen() const {
+    return file_.isOpen();
+}
+
+QString SessionRecorder::path() const {
+    return file_.fileName();
+}
+
+void SessionRecorder::record(const EditorEvent &event) {
+    if (!isOpen()) {
+        return;
+    }
+    const auto key = documentKey(event.document);
+    auto it = documentIds_.constFind(key);
+    if (it == documentIds_.cend()) {
+        it = documentIds_.insert(key, quint32(documentIds_.size()));
+        stream_ << kDocumentTag << *it << event.document.filePath << event.document.mode;
+    }
+    // A pause of more than 49 days is shortened, which does not matter for a replay.
+    const auto deltaMs = qMin<qint64>(qMax<qint64>(event.timeMs - lastTimeMs_, 0),
+                                      std::numeric_limits<quint32>::max());
+    lastTimeMs_ += deltaMs;
+    stream_ << quint8(event.type) << quint32(deltaMs) << *it << qint32(event.document.line)
+            << qint32(event.document.column) << qint32(event.document.linesInFile);
+    ++size_;
+}
+
+qsizetype SessionRecorder::size() const {
+    return size_;
+}
+
+void SessionRecorder::flush() {
+    if (isOpen() && !file_.flush()) {
+        qCWarning(gLogWakaTimeSession) << "Cannot write session" << path() << file_.errorString();
+    }
+}
+
+std::optional<QList<EditorEvent>> SessionRecorder::read(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(kDataStreamVersion);
+    quint32 magic;
+    quint16 version;
+    qint64 timeMs;
+    stream >> magic >> version >> timeMs;
+    if (stream.status() != QDataStream::Ok || magic != kMagic || version != kVersion) {
+        qCWarning(gLogWakaTimeSession) << "Not a session recording" << path;
+        return std::nullopt;
+    }
+    QList<DocumentState> documents;
+    QList<EditorEvent> events;
+    while (!stream.atEnd()) {
+        quint8 tag;
+        stream >> tag;
+        if (tag == kDocumentTag) {
+            quint32 id;
+            DocumentState document;
+            stream >> id >> document.filePath >> document.mode;
+            if (stream.status() != QDataStream::Ok || id != quint32(documents.size())) {
+                break;
+            }
+            documents << document;
+            continue;
+        }
+        quint32 deltaMs;
+        quint32 id;
+        qint32 line, column, linesInFile;
+        stream >> deltaMs >> id >> line >> column >> linesInFile;
+        if (stream.status() != QDataStream::Ok || tag > EditorEvent::Saved ||
+            id >= quint32(documents.size())) {
+            break;
+        }
+        timeMs += deltaMs;
+        EditorEvent event;
+        event.type = EditorEvent::Type(tag);
+        event.timeMs = timeMs;
+        event.document = documents.at(id);
+        event.document.line = line;
+        event.document.column = column;
+        event.document.linesInFile = linesInFile;
+        events << event;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCDebug(gLogWakaTimeSession) << "Ignoring truncated event at the end of" << path;
+    }
+    return events;
+}
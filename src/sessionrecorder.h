@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QDataStream>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QString>
+
+#include <optional>
+
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeSession)
+
+/** What the editor knows about a document when one of its signals fires. */
+struct DocumentState {
+    /** Local file path. Empty for unsaved documents. */
+    QString filePath;
+    /** Mode (language) of the document. */
+    QString mode;
+    /** Line of the cursor, starting at 1. */
+    int line = 0;
+    /** Column of the cursor, starting at 1. */
+    int column = 0;
+    /** Number of lines in the document. */
+    int linesInFile = 0;
+
+    bool operator==(const DocumentState &) const = default;
+};
+
+/** A document signal handled by the view. */
+struct EditorEvent {
+    /** The signal. */
+    enum Type : quint8 {
+        TextChanged,     /**< `KTextEditor::Document::textChanged`. */
+        ModifiedChanged, /**< `KTextEditor::Document::modifiedChanged`. */
+        Saved,           /**< `KTextEditor::Document::documentSavedOrUploaded`. */
+    };
+
+    Type type = TextChanged;
+    /** Time of the signal in milliseconds since the epoch. */
+    qint64 timeMs = 0;
+    /** The document at the time of the signal. */
+    DocumentState document;
+
+    bool operator==(const EditorEvent &) const = default;
+};
+
+/**
+ * Writes editor events to a compact binary file so that an editing session can be replayed later
+ * with SessionPlayer. Each document path and mode pair is written once and then referred to by
+ * number, and times are stored as the difference to the previous event, so most events take 21
+ * bytes. Writes are buffered and flushed on destruction.
+ */
+class SessionRecorder {
+public:
+    /**
+     * Constructor. Replaces the file if it exists.
+     *
+     * @param path File path.
+     */
+    explicit SessionRecorder(const QString &path);
+    /** Destructor. Flushes pending writes. */
+    ~SessionRecorder();
+    SessionRecorder(const SessionRecorder &) = delete;
+    SessionRecorder &operator=(const SessionRecorder &) = delete;
+    /**
+     * Check if the file could be opened.
+     *
+     * @return `true` if events are being recorded.
+     */
+    bool isOpen() const;
+    /**
+     * Get the file path.
+     *
+     * @return File path.
+     */
+    QString path() const;
+    /**
+     * Append an event. Events with a time before the previous event, or before the recorder was
+     * created, are recorded at that time instead.
+     *
+     * @param event The event.
+     */
+    void record(const EditorEvent &event);
+    /**
+     * Get the number of events recorded.
+     *
+     * @return Number of events.
+     */
+    qsizetype size() const;
+    /** Write buffered events to the file. */
+    void flush();
+    /**
+     * Read a recording.
+     *
+     * @param path File path.
+     * @return The events in order, or `std::nullopt` if the file cannot be read or is not a
+     * recording. A truncated last event is ignored.
+     */
+    static std::optional<QList<EditorEvent>> read(const QString &path);
+
+private:
+    QFile file_;
+    QDataStream stream_;
+    QHash<QString, quint32> documentIds_;
+    qint64 lastTimeMs_ = 0;
+    qsizetype size_ = 0;
+};
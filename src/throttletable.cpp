@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+#include "throttletable.h"
+
+ThrottleTable::ThrottleTable(qint64 intervalMs, qsizetype capacity)
+    : intervalMs_(intervalMs), lastSent_(capacity) {
+}
+
+bool ThrottleTable::isThrottled(const QString &entity, qint64 nowMs) const {
+    const auto sentMs = lastSent_.object(entity);
+    return sentMs && nowMs - *sentMs <= intervalMs_;
+}
+
+void ThrottleTable::record(const QString &entity, qint64 nowMs) {
+    lastSent_.insert(entity, new qint64(nowMs));
+}
+
+bool ThrottleTable::contains(const QString &entity) const {
+    return lastSent_.contains(entity);
+}
+
+qsizetype ThrottleTable::size() const {
+    return lastSent_.size();
+}
+
+qint64 ThrottleTable::interval() const {
+    return intervalMs_;
+}
+
+void ThrottleTable::setInterval(qint64 intervalMs) {
+    intervalMs_ = intervalMs;
+}
+
+void ThrottleTable::setCapacity(qsizetype capacity) {
+    lastSent_.setMaxCost(capacity);
+}
+
+void ThrottleTable::clear() {
+    lastSent_.clear();
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <QtCore/QCache>
+#include <QtCore/QString>
+
+/**
+ * Per-entity rate limiter. Remembers when a heartbeat was last sent for each entity so that each
+ * file is throttled on its own. The least recently used entries are evicted once the capacity is
+ * reached.
+ */
+class ThrottleTable {
+public:
+    /**
+     * Constructor.
+     *
+     * @param intervalMs Minimum time in milliseconds between heartbeats for the same entity.
+     * @param capacity Maximum number of entities remembered.
+     */
+    explicit ThrottleTable(qint64 intervalMs, qsizetype capacity);
+    /**
+     * Check if a heartbeat for an entity should be suppressed.
+     *
+     * @param entity Canonical file path.
+     * @param nowMs Current time in milliseconds since the epoch.
+     * @return `true` if a heartbeat for @p entity was recorded less than interval() ago.
+     */
+    bool isThrottled(const QString &entity, qint64 nowMs) const;
+    /**
+     * Record a heartbeat for an entity.
+     *
+     * @param entity Canonical file path.
+     * @param nowMs Time of the heartbeat in milliseconds since the epoch.
+     */
+    void record(const QString &entity, qint64 nowMs);
+    /**
+     * Check if an entity has a recorded heartbeat.
+     *
+     * @param entity Canonical file path.
+     * @return `true` if a heartbeat is recorded, however long ago.
+     */
+    bool contains(const QString &entity) const;
+    /**
+     * Get the number of entities remembered.
+     *
+     * @return Number of entities.
+     */
+    qsizetype size() const;
+    /**
+     * Get the throttle interval.
+     *
+     * @return Interval in milliseconds.
+     */
+    qint64 interval() const;
+    /**
+     * Set the throttle interval.
+     *
+     * @param intervalMs Interval in milliseconds.
+     */
+    void setInterval(qint64 intervalMs);
+    /**
+     * Set the maximum number of entities remembered.
+     *
+     * @param capacity Number of entities.
+     */
+    void setCapacity(qsizetype capacity);
+    /** Forget all entities. */
+    void clear();
+
+private:
+    qint64 intervalMs_;
+    // Entity to time of last heartbeat. QCache keeps the least recently used order.
+    QCache<QString, qint64> lastSent_;
+};
@@ -1,24 +1,155 @@
 // SPDX-License-Identifier: MIT
+#include <QtCore/QDeadlineTimer>
 #include <QtCore/QDir>
-#include <QtCore/QProcess>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QMetaEnum>
+#include <QtCore/QSaveFile>
+
+#include <utility>
 
 #include "wakatime.h"
 
 Q_LOGGING_CATEGORY(gLogWakaTime, "wakatime")
+Q_LOGGING_CATEGORY(gLogWakaTimeMetrics, "wakatime-metrics")
 
-const auto kStringLiteralSlash = QStringLiteral("/");
 const auto kWakaTimeCli = QStringLiteral("wakatime-cli");
+constexpr qsizetype kDefaultBatchSize = 25;
+// Beyond this heartbeats wait in the queue instead of starting more processes.
+constexpr qsizetype kDefaultMaxProcesses = 2;
+constexpr qsizetype kDefaultQueueCapacity = 100;
+constexpr int kDefaultFlushIntervalMs = 10000;
+constexpr int kShutdownFlushTimeoutMs = 5000;
+constexpr qsizetype kMaxReplayBatch = 1000;
+constexpr qint64 kDefaultThrottleIntervalMs = 120000;
+constexpr qsizetype kThrottleCapacity = 1000;
+constexpr qsizetype kMaxCanonicalPaths = 8192;
+constexpr qint64 kDefaultSessionTimeoutMs = 15 * 60 * 1000;
+constexpr int kTotalsSaveIntervalMs = 60000;
+constexpr int kDefaultMetricsDumpIntervalMs = 60000;
+constexpr int kDefaultProcessTimeoutMs = 30000;
+constexpr int kProcessKillTimeoutMs = 2000;
+constexpr int kBreakerFailureThreshold = 3;
+constexpr qint64 kBreakerBaseDelayMs = 30000;
+constexpr qint64 kBreakerMaxDelayMs = 1800000;
+// wakatime-cli exit codes after it saved the heartbeats to its offline queue: API error, backoff.
+constexpr int kCliApiErrorExitCode = 102;
+constexpr int kCliBackoffExitCode = 112;
+
+namespace {
+WakaTime::State stateFor(HeartbeatTransport::Result result) {
+    switch (result) {
+    case HeartbeatTransport::Sent:
+        return WakaTime::SentSuccessfully;
+    case HeartbeatTransport::Queued:
+        return WakaTime::SentOffline;
+    case HeartbeatTransport::TimedOut:
+        return WakaTime::TimedOut;
+    case HeartbeatTransport::Failed:
+        break;
+    }
+    return WakaTime::ErrorSending;
+}
+
+/** Check if wakatime-cli has the heartbeats, whether or not it could send them on yet. */
+bool isDelivered(WakaTime::State state) {
+    return state == WakaTime::SentSuccessfully || state == WakaTime::SentOffline;
+}
+
+QJsonObject cacheJson(quint64 hits, quint64 misses) {
+    const auto lookups = hits + misses;
+    return {
+        {QStringLiteral("hits"), qint64(hits)},
+        {QStringLiteral("misses"), qint64(misses)},
+        {QStringLiteral("hitRate"), lookups ? double(hits) / double(lookups) : 0.0},
+    };
+}
+
+QJsonObject breakerJson(const CircuitBreaker &breaker) {
+    QString state;
+    switch (breaker.state()) {
+    case CircuitBreaker::Closed:
+        state = QStringLiteral("closed");
+        break;
+    case CircuitBreaker::HalfOpen:
+        state = QStringLiteral("half-open");
+        break;
+    case CircuitBreaker::Open:
+        state = QStringLiteral("open");
+        break;
+    }
+    return {
+        {QStringLiteral("state"), state},
+        {QStringLiteral("consecutiveFailures"), breaker.consecutiveFailures()},
+    };
+}
+} // namespace
 
-WakaTime::WakaTime(QObject *parent) : lastTimeSent(QDateTime::fromMSecsSinceEpoch(0)) {
+WakaTime::WakaTime(QObject *parent)
+    : projectResolver(&cacheWatcher), throttle(kDefaultThrottleIntervalMs, kThrottleCapacity),
+      scheduler(kDefaultQueueCapacity), batchSize(kDefaultBatchSize),
+      maxProcesses(kDefaultMaxProcesses),
+      journal(HeartbeatJournal::defaultPath()), totals(kDefaultSessionTimeoutMs),
+      breaker(kBreakerFailureThreshold, kBreakerBaseDelayMs, kBreakerMaxDelayMs),
+      processRunner(kDefaultProcessTimeoutMs, kProcessKillTimeoutMs) {
     Q_UNUSED(parent);
+    // Replaying those from the journal would count them twice.
+    processRunner.setDeferredExitCodes({kCliApiErrorExitCode, kCliBackoffExitCode});
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(kDefaultFlushIntervalMs);
+    connect(&flushTimer, &QTimer::timeout, this, &WakaTime::flush);
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, &WakaTime::replayJournal);
+    connect(&cacheWatcher, &CacheWatcher::directoryChanged, this, &WakaTime::invalidateCaches);
+    // Every asynchronous result goes through sendFinished().
+    connect(this, &WakaTime::sendFinished, this, &WakaTime::counted);
+    metricsDumpTimer.setInterval(kDefaultMetricsDumpIntervalMs);
+    connect(&metricsDumpTimer, &QTimer::timeout, this, &WakaTime::dumpMetrics);
+    metricsDumpPath = qEnvironmentVariable("KATE_WAKATIME_METRICS_FILE");
+    if (!metricsDumpPath.isEmpty() || gLogWakaTimeMetrics().isDebugEnabled()) {
+        metricsDumpTimer.start();
+    }
+    totals.load(ActivityTotals::defaultPath());
+    totalsSaveTimer.setSingleShot(true);
+    totalsSaveTimer.setInterval(kTotalsSaveIntervalMs);
+    connect(&totalsSaveTimer, &QTimer::timeout, this, &WakaTime::saveTotals);
+    transport = createTransport(qEnvironmentVariable("KATE_WAKATIME_TRANSPORT"));
+}
+
+WakaTime::~WakaTime() {
+    // Do not start a replay or more batches that would be killed straight away.
+    shuttingDown = true;
+    // Give running and queued heartbeats a chance to be sent before Kate exits. Failures are
+    // journalled as usual.
+    const QDeadlineTimer deadline(kShutdownFlushTimeoutMs);
+    while (!deadline.hasExpired()) {
+        transport->waitForFinished(deadline);
+        if (!startBatch()) {
+            break;
+        }
+    }
+    // Processes still running are killed without a result, so keep their heartbeats and the rest
+    // of the queue for the next session.
+    auto unsent = scheduler.takeAll();
+    for (const auto &batch : std::as_const(runningBatches)) {
+        unsent << batch;
+    }
+    runningBatches.clear();
+    if (!unsent.isEmpty()) {
+        qCWarning(gLogWakaTime) << "Journalling" << unsent.size() << "heartbeats not sent in time";
+        journal.append(unsent);
+    }
+    saveTotals();
 }
 
 QString WakaTime::getBinPath(const QStringList &binNames) {
     for (auto &name : binNames) {
         if (binPathCache.contains(name)) {
+            binPathHits++;
             return binPathCache.value(name);
         }
     }
+    binPathMisses++;
     auto dotWakaTime = QStringLiteral("%1/.wakatime").arg(QDir::homePath());
 #ifndef Q_OS_WIN
     static const auto pathSeparator = QStringLiteral(":");
@@ -31,12 +162,23 @@ QString WakaTime::getBinPath(const QStringList &binNames) {
     const auto path = qEnvironmentVariable("PATH", kDefaultPath);
     auto paths = path.split(pathSeparator, Qt::SkipEmptyParts);
     paths.insert(0, dotWakaTime);
+    QStringList searched;
     for (auto path : paths) {
+        searched << path;
         for (auto &name : binNames) {
             auto lookFor = path + QDir::separator() + name;
             auto fi = QFileInfo(lookFor);
             if (fi.exists(lookFor) && fi.isExecutable()) {
                 binPathCache[name] = lookFor;
+                // The binary being moved or removed, or a new one appearing earlier in PATH,
+                // changes the result. The watches are released when the entry is dropped.
+                QStringList watched;
+                for (const auto &directory : std::as_const(searched)) {
+                    if (cacheWatcher.watch(directory)) {
+                        watched << directory;
+                    }
+                }
+                binPathDirectories.insert(name, watched);
                 return lookFor;
             }
         }
@@ -45,114 +187,557 @@ QString WakaTime::getBinPath(const QStringList &binNames) {
 }
 
 QString WakaTime::getProjectDirectory(const QFileInfo &fileInfo) {
-    QDir currentDirectory(fileInfo.canonicalPath());
-    static QStringList filters;
-    static const auto gitStr = QStringLiteral(".git");
-    static const auto svnStr = QStringLiteral(".svn");
-    filters << gitStr << svnStr;
-    bool vcDirFound = false;
-    while (!vcDirFound) {
-        if (!currentDirectory.canonicalPath().compare(kStringLiteralSlash)) {
-            break;
-        }
-        auto entries =
-            currentDirectory.entryInfoList(QDir::AllDirs | QDir::NoDotAndDotDot | QDir::Hidden);
-        for (const auto &entry : entries) {
-            auto name = entry.fileName();
-            if ((name == gitStr || name == svnStr) && entry.isDir()) {
-                vcDirFound = true;
-                return currentDirectory.dirName();
-            }
+    return projectName(fileInfo.canonicalPath());
+}
+
+QString WakaTime::getProjectBranch(const QFileInfo &fileInfo) {
+    const auto root = projectResolver.projectRoot(fileInfo.canonicalPath());
+    auto branch = projectResolver.projectFile(root).branch;
+    return branch.isEmpty() ? branchResolver.branch(root) : branch;
+}
+
+QString WakaTime::projectName(const QString &canonicalDirectory) {
+    const auto root = projectResolver.projectRoot(canonicalDirectory);
+    if (root.isEmpty()) {
+        return QString();
+    }
+    auto project = projectResolver.projectFile(root).project;
+    return project.isEmpty() ? QDir(root).dirName() : project;
+}
+
+QString WakaTime::canonicalFilePath(const QString &filePath) {
+    const auto it = canonicalPaths.constFind(filePath);
+    if (it != canonicalPaths.cend()) {
+        canonicalPathHits++;
+        return it.value();
+    }
+    canonicalPathMisses++;
+    auto canonical = QFileInfo(filePath).canonicalFilePath();
+    // Files that do not exist yet are resolved again once they are saved.
+    if (!canonical.isEmpty()) {
+        if (canonicalPaths.size() >= kMaxCanonicalPaths) {
+            canonicalPaths.clear();
         }
-        currentDirectory.cdUp();
+        canonicalPaths.insert(filePath, canonical);
     }
-    return QString();
+    return canonical;
 }
 
-WakaTime::State WakaTime::send(const QString &filePath,
-                               const QString &mode,
-                               int lineNumber,
-                               int cursorPosition,
-                               int linesInFile,
-                               bool isWrite) {
+void WakaTime::forgetCanonicalPath(const QString &filePath) {
+    canonicalPaths.remove(filePath);
+}
+
+QString WakaTime::wakatimeCliPath() {
 #ifdef Q_OS_WIN
 #ifdef Q_PROCESSOR_X86_64
-    auto wakatimeCliPath = getBinPath({QStringLiteral("wakatime-cli-windows-amd64.exe"),
-                                       QStringLiteral("wakatime-cli.exe"),
-                                       QStringLiteral("wakatime.exe")});
+    return getBinPath({QStringLiteral("wakatime-cli-windows-amd64.exe"),
+                       QStringLiteral("wakatime-cli.exe"),
+                       QStringLiteral("wakatime.exe")});
 #elif defined(Q_PROCESSOR_ARM)
-    auto wakatimeCliPath = getBinPath({QStringLiteral("wakatime-cli-windows-arm64.exe"),
-                                       QStringLiteral("wakatime-cli.exe"),
-                                       QStringLiteral("wakatime.exe")});
+    return getBinPath({QStringLiteral("wakatime-cli-windows-arm64.exe"),
+                       QStringLiteral("wakatime-cli.exe"),
+                       QStringLiteral("wakatime.exe")});
 #else
-    auto wakatimeCliPath = getBinPath({QStringLiteral("wakatime-cli-windows-386.exe"),
-                                       QStringLiteral("wakatime-cli.exe"),
-                                       QStringLiteral("wakatime.exe")});
+    return getBinPath({QStringLiteral("wakatime-cli-windows-386.exe"),
+                       QStringLiteral("wakatime-cli.exe"),
+                       QStringLiteral("wakatime.exe")});
 #endif // Q_PROCESSOR_X86_64
 #elif defined(Q_OS_APPLE)
-    auto wakatimeCliPath = getBinPath({QStringLiteral("wakatime-cli-darwin-arm64"),
-                                       QStringLiteral("wakatime-cli-darwin-amd64"),
-                                       kWakaTimeCli,
-                                       QStringLiteral("wakatime")});
+    return getBinPath({QStringLiteral("wakatime-cli-darwin-arm64"),
+                       QStringLiteral("wakatime-cli-darwin-amd64"),
+                       kWakaTimeCli,
+                       QStringLiteral("wakatime")});
 #else
-    auto wakatimeCliPath = getBinPath({kWakaTimeCli, QStringLiteral("wakatime")});
+    return getBinPath({kWakaTimeCli, QStringLiteral("wakatime")});
 #endif // Q_OS_WIN
-    if (wakatimeCliPath.isEmpty()) {
-        qCWarning(gLogWakaTime) << "wakatime-cli not found in PATH.";
-        return WakaTimeCliNotInPath;
-    }
+}
+
+std::optional<WakaTime::State> WakaTime::prepare(const QString &filePath,
+                                                 const QString &mode,
+                                                 int lineNumber,
+                                                 int cursorPosition,
+                                                 int linesInFile,
+                                                 bool isWrite,
+                                                 Heartbeat &heartbeat) {
     // Could be untitled, or a URI (including HTTP). Only local files are handled for now.
     if (filePath.isEmpty()) {
         qCDebug(gLogWakaTime) << "Nothing to send about";
         return NothingToSend;
     }
-    QStringList arguments;
-    const QFileInfo fileInfo(filePath);
-    // They have it sending the real file path, maybe not respecting symlinks, etc.
-    auto canonicalFilePath = fileInfo.canonicalFilePath();
+    // They have it sending the real file path, maybe not respecting symlinks, etc. This is cached
+    // so a throttled heartbeat does not touch the file system.
+    const auto canonicalFilePath = this->canonicalFilePath(filePath);
     qCDebug(gLogWakaTime) << "File path:" << canonicalFilePath;
-    // Compare date and make sure it has been at least 15 minutes.
     const auto currentMs = QDateTime::currentMSecsSinceEpoch();
-    const auto deltaMs = currentMs - lastTimeSent.toMSecsSinceEpoch();
-    static const auto intervalMs = 120000; // ms
-    // If the current file has not changed and it has not been 2 minutes since the last heartbeat
-    // was sent, do NOT send this heartbeat. This does not apply to write events as they are always
-    // sent.
-    if (!isWrite) {
-        if (hasSent && deltaMs <= intervalMs && lastFileSent == canonicalFilePath) {
-            qCDebug(gLogWakaTime) << "Not enough time has passed since last send";
-            qCDebug(gLogWakaTime) << "Delta:" << deltaMs / 1000 / 60 << "/ 2 minutes";
-            return TooSoon;
+    // If a heartbeat for this file was sent less than the throttle interval (2 minutes by default)
+    // ago, do NOT send this heartbeat. Each file is throttled separately. This does not apply to
+    // write events as they are always sent.
+    if (!isWrite && throttle.isThrottled(canonicalFilePath, currentMs)) {
+        qCDebug(gLogWakaTime) << "Not enough time has passed since last send for this file";
+        return TooSoon;
+    }
+    heartbeat.entity = canonicalFilePath;
+    heartbeat.language = mode;
+    if (!canonicalFilePath.isEmpty()) {
+        const auto root = projectResolver.projectRoot(QFileInfo(canonicalFilePath).path());
+        if (!root.isEmpty()) {
+            // A .wakatime-project file may name the project and branch.
+            auto names = projectResolver.projectFile(root);
+            heartbeat.project =
+                names.project.isEmpty() ? QDir(root).dirName() : std::move(names.project);
+            // Passed on so wakatime-cli does not have to run git for every heartbeat.
+            heartbeat.branch =
+                names.branch.isEmpty() ? branchResolver.branch(root) : std::move(names.branch);
         }
     }
-    arguments << QStringLiteral("--entity") << canonicalFilePath;
-    arguments << QStringLiteral("--plugin")
-              << QStringLiteral("ktexteditor-wakatime/%1").arg(VERSION);
-    auto projectName = getProjectDirectory(fileInfo);
-    if (!projectName.isEmpty()) {
-        arguments << QStringLiteral("--alternate-project") << projectName;
-    } else {
+    if (heartbeat.project.isEmpty()) {
         // LCOV_EXCL_START
         qCDebug(gLogWakaTime) << "Warning: No project name found";
         // LCOV_EXCL_STOP
     }
-    if (isWrite) {
-        arguments << QStringLiteral("--write");
-    }
-    if (!mode.isEmpty()) {
-        arguments << QStringLiteral("--language") << mode;
-    }
-    arguments << QStringLiteral("--lineno") << QString::number(lineNumber);
-    arguments << QStringLiteral("--cursorpos") << QString::number(cursorPosition);
-    arguments << QStringLiteral("--lines-in-file") << QString::number(linesInFile);
-    qCDebug(gLogWakaTime) << "Running:" << wakatimeCliPath << arguments.join(QStringLiteral(" "));
-    auto ret = QProcess::execute(wakatimeCliPath, arguments);
-    if (ret != 0) {
-        qCWarning(gLogWakaTime) << "wakatime-cli returned error code" << ret;
-        return ErrorSending;
-    }
-    lastTimeSent = QDateTime::currentDateTime();
-    lastFileSent = canonicalFilePath;
-    hasSent = true;
-    return SentSuccessfully;
+    heartbeat.lineNumber = lineNumber;
+    heartbeat.cursorPosition = cursorPosition;
+    heartbeat.linesInFile = linesInFile;
+    heartbeat.isWrite = isWrite;
+    heartbeat.timeMs = currentMs;
+    if (!transport->isAvailable()) {
+        qCWarning(gLogWakaTime) << "wakatime-cli not found in PATH.";
+        // Keep the heartbeat so it can be sent once wakatime-cli is installed.
+        if (!heartbeat.entity.isEmpty()) {
+            recordActivity(heartbeat);
+            journal.append({heartbeat});
+            markSent(heartbeat.entity);
+        }
+        return WakaTimeCliNotInPath;
+    }
+    return std::nullopt;
+}
+
+void WakaTime::markSent(const QString &canonicalFilePath) {
+    throttle.record(canonicalFilePath, QDateTime::currentMSecsSinceEpoch());
+}
+
+void WakaTime::recordActivity(const Heartbeat &heartbeat) {
+    // Counted locally even if it cannot be sent.
+    totals.record(heartbeat);
+    if (!totalsSaveTimer.isActive()) {
+        totalsSaveTimer.start();
+    }
+    Q_EMIT activityTotalsChanged();
+}
+
+void WakaTime::saveTotals() {
+    totalsSaveTimer.stop();
+    if (totals.isModified()) {
+        totals.save(ActivityTotals::defaultPath());
+    }
+}
+
+WakaTime::State WakaTime::send(const QString &filePath,
+                               const QString &mode,
+                               int lineNumber,
+                               int cursorPosition,
+                               int linesInFile,
+                               bool isWrite) {
+    const LatencyTimer timer(sendTime);
+    Heartbeat heartbeat;
+    if (auto state =
+            prepare(filePath, mode, lineNumber, cursorPosition, linesInFile, isWrite, heartbeat)) {
+        return counted(*state);
+    }
+    recordActivity(heartbeat);
+    if (!breaker.allowRequest(heartbeat.timeMs)) {
+        qCDebug(gLogWakaTime) << "Backing off, journalling heartbeat";
+        journal.append({heartbeat});
+        markSent(heartbeat.entity);
+        return counted(BackingOff);
+    }
+    State state;
+    {
+        const LatencyTimer processTimer(processTime);
+        state = stateFor(transport->run({heartbeat}));
+    }
+    recordResult(state);
+    if (!isDelivered(state)) {
+        journal.append({heartbeat});
+        return counted(state);
+    }
+    markSent(heartbeat.entity);
+    if (state == SentSuccessfully) {
+        replayJournal();
+    }
+    return counted(state);
+}
+
+void WakaTime::sendAsync(const QString &filePath,
+                         const QString &mode,
+                         int lineNumber,
+                         int cursorPosition,
+                         int linesInFile,
+                         bool isWrite) {
+    const LatencyTimer timer(sendTime);
+    Heartbeat heartbeat;
+    if (auto state =
+            prepare(filePath, mode, lineNumber, cursorPosition, linesInFile, isWrite, heartbeat)) {
+        Q_EMIT sendFinished(*state, heartbeat.entity);
+        return;
+    }
+    // The throttle state is only updated on completion, so do not start a second process for a
+    // file that is still being sent.
+    const auto queued = scheduler.contains(heartbeat.entity);
+    if (!isWrite && inFlight.contains(heartbeat.entity) && !queued) {
+        qCDebug(gLogWakaTime) << "Send already in progress for" << heartbeat.entity;
+        Q_EMIT sendFinished(TooSoon, heartbeat.entity);
+        return;
+    }
+    // Queued heartbeats go through the breaker when their batch is started.
+    if (queued || transport->running() >= maxProcesses) {
+        qCDebug(gLogWakaTime) << "Queueing" << heartbeat.entity;
+        schedule(std::move(heartbeat));
+        return;
+    }
+    recordActivity(heartbeat);
+    // Checked right before dispatching, as this may let the heartbeat through as the probe.
+    if (!breaker.allowRequest(heartbeat.timeMs)) {
+        qCDebug(gLogWakaTime) << "Backing off, journalling heartbeat";
+        finishHeartbeats({heartbeat}, BackingOff);
+        return;
+    }
+    inFlight.insert(heartbeat.entity);
+    dispatchBatch({std::move(heartbeat)});
+}
+
+void WakaTime::queueHeartbeat(const QString &filePath,
+                              const QString &mode,
+                              int lineNumber,
+                              int cursorPosition,
+                              int linesInFile,
+                              bool isWrite) {
+    const LatencyTimer timer(sendTime);
+    Heartbeat heartbeat;
+    if (auto state =
+            prepare(filePath, mode, lineNumber, cursorPosition, linesInFile, isWrite, heartbeat)) {
+        Q_EMIT sendFinished(*state, heartbeat.entity);
+        return;
+    }
+    // Heartbeats still waiting in the queue are coalesced instead.
+    if (!isWrite && inFlight.contains(heartbeat.entity) &&
+        !scheduler.contains(heartbeat.entity)) {
+        qCDebug(gLogWakaTime) << "Send already in progress for" << heartbeat.entity;
+        Q_EMIT sendFinished(TooSoon, heartbeat.entity);
+        return;
+    }
+    schedule(std::move(heartbeat));
+}
+
+void WakaTime::schedule(Heartbeat heartbeat) {
+    // Kept as the heartbeat is moved into the queue. It is only counted if the queue takes it.
+    const auto activity = heartbeat;
+    const auto &entity = activity.entity;
+    std::optional<Heartbeat> removed;
+    const auto result = scheduler.enqueue(std::move(heartbeat), removed);
+    if (result != HeartbeatScheduler::Dropped) {
+        inFlight.insert(entity);
+        recordActivity(activity);
+    }
+    if (removed) {
+        if (result == HeartbeatScheduler::Coalesced) {
+            qCDebug(gLogWakaTime) << "Coalesced heartbeats for" << entity;
+            Q_EMIT sendFinished(TooSoon, removed->entity);
+        } else {
+            qCDebug(gLogWakaTime) << "Queue full, dropping heartbeat for" << removed->entity;
+            if (removed->entity != entity && !scheduler.contains(removed->entity)) {
+                inFlight.remove(removed->entity);
+            }
+            Q_EMIT sendFinished(Dropped, removed->entity);
+        }
+    }
+    if (result == HeartbeatScheduler::Dropped) {
+        return;
+    }
+    // Writes are sent straight away along with anything already queued.
+    if (activity.isWrite || scheduler.size() >= batchSize) {
+        flush();
+    } else if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void WakaTime::flush() {
+    flushTimer.stop();
+    flushDeferred = false;
+    while (!scheduler.isEmpty()) {
+        if (transport->running() >= maxProcesses) {
+            qCDebug(gLogWakaTime) << "Too many wakatime-cli processes, keeping" << scheduler.size()
+                                  << "heartbeats queued";
+            flushDeferred = true;
+            return;
+        }
+        startBatch();
+    }
+}
+
+bool WakaTime::startBatch() {
+    flushTimer.stop();
+    if (scheduler.isEmpty()) {
+        return false;
+    }
+    if (!breaker.allowRequest(QDateTime::currentMSecsSinceEpoch())) {
+        const auto batch = scheduler.takeAll();
+        qCDebug(gLogWakaTime) << "Backing off, journalling" << batch.size() << "heartbeats";
+        finishHeartbeats(batch, BackingOff);
+        return false;
+    }
+    const auto probing = breaker.state() == CircuitBreaker::HalfOpen;
+    const auto batch =
+        scheduler.take(probing ? 1 : qMin(batchSize, transport->maxBatchSize()));
+    if (probing && !scheduler.isEmpty()) {
+        // Probe with a single heartbeat. The rest are replayed from the journal if it succeeds.
+        finishHeartbeats(scheduler.takeAll(), BackingOff);
+    }
+    qCDebug(gLogWakaTime) << "Flushing" << batch.size() << "heartbeats";
+    dispatchBatch(batch);
+    return true;
+}
+
+void WakaTime::dispatchPending() {
+    if (shuttingDown || scheduler.isEmpty()) {
+        return;
+    }
+    if (flushDeferred || scheduler.hasWrites()) {
+        flush();
+    } else if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void WakaTime::setBatchSize(qsizetype size) {
+    batchSize = qMax<qsizetype>(size, 1);
+}
+
+void WakaTime::setMaxProcesses(qsizetype count) {
+    maxProcesses = qMax<qsizetype>(count, 1);
+    dispatchPending();
+}
+
+void WakaTime::setQueueCapacity(qsizetype capacity) {
+    scheduler.setCapacity(qMax<qsizetype>(capacity, 1));
+}
+
+void WakaTime::setFlushInterval(int ms) {
+    flushTimer.setInterval(ms);
+}
+
+void WakaTime::setThrottleInterval(qint64 ms) {
+    throttle.setInterval(ms);
+}
+
+const ActivityTotals &WakaTime::activityTotals() const {
+    return totals;
+}
+
+void WakaTime::setSessionTimeout(qint64 ms) {
+    totals.setTimeout(ms);
+}
+
+void WakaTime::setProcessTimeout(int ms) {
+    processRunner.setTimeout(ms);
+}
+
+void WakaTime::setTransport(std::unique_ptr<HeartbeatTransport> transport) {
+    this->transport = std::move(transport);
+}
+
+std::unique_ptr<HeartbeatTransport> WakaTime::createTransport(const QString &name) {
+    const auto locateProgram = [this]() { return wakatimeCliPath(); };
+    if (name == QStringLiteral("cli")) {
+        return std::make_unique<CliTransport>(processRunner, locateProgram);
+    }
+    static const auto journalPrefix = QStringLiteral("journal:");
+    if (name.startsWith(journalPrefix) && name.size() > journalPrefix.size()) {
+        auto result = std::make_unique<JournalTransport>(name.mid(journalPrefix.size()));
+        if (result->isAvailable()) {
+            return result;
+        }
+    } else if (!name.isEmpty() && name != QStringLiteral("batched")) {
+        qCWarning(gLogWakaTime) << "Unknown transport" << name;
+    }
+    return std::make_unique<BatchedCliTransport>(processRunner, locateProgram);
+}
+
+QJsonObject WakaTime::metrics() const {
+    QJsonObject states;
+    const auto stateEnum = QMetaEnum::fromType<State>();
+    for (int i = 0; i < stateEnum.keyCount(); ++i) {
+        const auto state = static_cast<State>(stateEnum.value(i));
+        states.insert(QString::fromLatin1(stateEnum.key(i)), qint64(stateCounts.value(state)));
+    }
+    const auto projectStats = projectResolver.stats();
+    const auto branchStats = branchResolver.stats();
+    return {
+        {QStringLiteral("states"), states},
+        {QStringLiteral("sendTime"), sendTime.toJson()},
+        {QStringLiteral("processTime"), processTime.toJson()},
+        {QStringLiteral("queued"), scheduler.size()},
+        {QStringLiteral("queueCapacity"), scheduler.capacity()},
+        {QStringLiteral("processes"), transport->running()},
+        {QStringLiteral("maxProcesses"), maxProcesses},
+        {QStringLiteral("inFlight"), inFlight.size()},
+        {QStringLiteral("journalled"), journal.size()},
+        {QStringLiteral("binPathCache"), cacheJson(binPathHits, binPathMisses)},
+        {QStringLiteral("canonicalPathCache"), cacheJson(canonicalPathHits, canonicalPathMisses)},
+        {QStringLiteral("projectCache"), cacheJson(projectStats.hits, projectStats.misses)},
+        {QStringLiteral("branchCache"), cacheJson(branchStats.hits, branchStats.misses)},
+        {QStringLiteral("circuitBreaker"), breakerJson(breaker)},
+    };
+}
+
+void WakaTime::resetMetrics() {
+    stateCounts.clear();
+    sendTime.clear();
+    processTime.clear();
+    binPathHits = 0;
+    binPathMisses = 0;
+    canonicalPathHits = 0;
+    canonicalPathMisses = 0;
+    projectResolver.resetStats();
+    branchResolver.resetStats();
+}
+
+void WakaTime::setMetricsDumpInterval(int ms) {
+    if (ms <= 0) {
+        metricsDumpTimer.stop();
+        return;
+    }
+    metricsDumpTimer.start(ms);
+}
+
+void WakaTime::setMetricsDumpPath(const QString &path) {
+    metricsDumpPath = path;
+}
+
+void WakaTime::dumpMetrics() {
+    const auto json = QJsonDocument(metrics()).toJson(QJsonDocument::Compact);
+    if (metricsDumpPath.isEmpty()) {
+        qCDebug(gLogWakaTimeMetrics).noquote() << QString::fromUtf8(json);
+        return;
+    }
+    QSaveFile file(metricsDumpPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json + '\n') < 0 || !file.commit()) {
+        qCWarning(gLogWakaTimeMetrics)
+            << "Failed to write metrics to" << metricsDumpPath << file.errorString();
+    }
+}
+
+WakaTime::State WakaTime::counted(State state) {
+    stateCounts[state]++;
+    return state;
+}
+
+void WakaTime::recordResult(State state) {
+    if (state == SentSuccessfully) {
+        breaker.recordSuccess();
+        retryTimer.stop();
+        return;
+    }
+    const auto nowMs = QDateTime::currentMSecsSinceEpoch();
+    breaker.recordFailure(nowMs);
+    if (breaker.state() == CircuitBreaker::Open && !retryTimer.isActive()) {
+        qCWarning(gLogWakaTime) << "wakatime-cli failed" << breaker.consecutiveFailures()
+                                << "times in a row, retrying in" << breaker.retryAt() - nowMs
+                                << "ms";
+        retryTimer.start(int(qMax<qint64>(breaker.retryAt() - nowMs, 0)));
+    }
+}
+
+void WakaTime::finishHeartbeats(const QList<Heartbeat> &heartbeats, State state) {
+    if (!isDelivered(state)) {
+        // Keep them so they can be replayed once wakatime-cli works again.
+        journal.append(heartbeats);
+    }
+    for (const auto &heartbeat : heartbeats) {
+        inFlight.remove(heartbeat.entity);
+        // Journalled heartbeats count for throttling too, otherwise every keystroke would be
+        // journalled while wakatime-cli is failing.
+        markSent(heartbeat.entity);
+        Q_EMIT sendFinished(state, heartbeat.entity);
+    }
+    if (state == SentSuccessfully) {
+        replayJournal();
+    }
+}
+
+void WakaTime::replayJournal() {
+    // A replay finishing during shutdown must not start another process.
+    if (shuttingDown || replaying || journal.isEmpty()) {
+        return;
+    }
+    auto batch = journal.read(qMin(kMaxReplayBatch, transport->maxBatchSize()));
+    if (!transport->isAvailable() || batch.heartbeats.isEmpty() ||
+        !breaker.allowRequest(QDateTime::currentMSecsSinceEpoch())) {
+        return;
+    }
+    if (breaker.state() == CircuitBreaker::HalfOpen) {
+        batch = journal.read(1);
+    }
+    qCDebug(gLogWakaTime) << "Replaying" << batch.heartbeats.size() << "journalled heartbeats";
+    replaying = true;
+    dispatch(batch.heartbeats, [this, batch](State state) {
+        replaying = false;
+        if (!isDelivered(state)) {
+            return;
+        }
+        // Heartbeats appended or compacted away during the replay are taken into account.
+        journal.discard(batch);
+        if (state == SentSuccessfully) {
+            replayJournal();
+        }
+    });
+}
+
+bool WakaTime::binPathStale(const QString &name, const QString &directory) const {
+    // ~/.wakatime is written to constantly, so only the entry named after the binary matters.
+    const QFileInfo candidate(directory + QDir::separator() + name);
+    const bool found = candidate.exists() && candidate.isExecutable();
+    if (candidate.filePath() == binPathCache.value(name)) {
+        return !found;
+    }
+    return found;
+}
+
+void WakaTime::invalidateCaches(const QString &directory) {
+    for (auto it = binPathDirectories.begin(); it != binPathDirectories.end();) {
+        if (it.value().contains(directory) && binPathStale(it.key(), directory)) {
+            qCDebug(gLogWakaTime) << "Dropping cached path for" << it.key();
+            binPathCache.remove(it.key());
+            for (const auto &watched : std::as_const(it.value())) {
+                cacheWatcher.unwatch(watched);
+            }
+            it = binPathDirectories.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    projectResolver.invalidate(directory);
+    branchResolver.invalidate(directory);
+}
+
+void WakaTime::dispatchBatch(const QList<Heartbeat> &batch) {
+    const auto id = nextBatchId++;
+    runningBatches.insert(id, batch);
+    dispatch(batch, [this, id](State state) { finishHeartbeats(runningBatches.take(id), state); });
+}
+
+void WakaTime::dispatch(const QList<Heartbeat> &heartbeats, std::function<void(State)> onFinished) {
+    QElapsedTimer timer;
+    timer.start();
+    transport->start(heartbeats,
+                     [this, onFinished, timer](HeartbeatTransport::Result result) {
+                         processTime.record(timer.nsecsElapsed() / 1000);
+                         const auto state = stateFor(result);
+                         recordResult(state);
+                         onFinished(state);
+                         // A process slot is free.
+                         dispatchPending();
+                     });
 }
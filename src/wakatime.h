@@ -2,11 +2,34 @@
 #pragma once
 
 #include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QJsonObject>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QMap>
 #include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "activitytotals.h"
+#include "branchresolver.h"
+#include "cachewatcher.h"
+#include "circuitbreaker.h"
+#include "heartbeat.h"
+#include "heartbeatjournal.h"
+#include "heartbeatscheduler.h"
+#include "heartbeattransport.h"
+#include "latencyhistogram.h"
+#include "processrunner.h"
+#include "projectresolver.h"
+#include "throttletable.h"
 
 Q_DECLARE_LOGGING_CATEGORY(gLogWakaTime)
+Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeMetrics)
 
 class QFileInfo;
 
@@ -14,35 +37,73 @@ class QFileInfo;
 class WakaTime : public QObject {
     Q_OBJECT
 #ifdef TESTING
+    friend class WakaTimeClientBenchmark;
     friend class WakaTimeClientTest;
 #endif
 
 public:
     /** State returned by send(). */
     enum State {
+        BackingOff,           /**< `wakatime-cli` keeps failing. Journalled without running it. */
+        Dropped,              /**< Too many heartbeats were waiting to be sent. */
         ErrorSending,         /**< `wakatime-cli` exited with non-zero. */
         NothingToSend,        /**< Filename was empty. */
+        SentOffline,          /**< `wakatime-cli` could not reach the API and kept the
+                                   heartbeats in its own offline queue. Not journalled. */
         SentSuccessfully,     /**< Successful request. */
+        TimedOut,             /**< `wakatime-cli` did not exit in time and was stopped. */
         TooSoon,              /**< send() called too soon since last time. */
-        WakaTimeCliNotInPath, /**< `wakatime` or `wakatime-cli` not in `PATH`. */
+        WakaTimeCliNotInPath, /**< `wakatime` or `wakatime-cli` not in `PATH`, or the transport
+                                   is otherwise unavailable. */
     };
+    Q_ENUM(State)
 
     /** Constructor. */
     WakaTime(QObject *parent = nullptr);
+    /** Destructor. Flushes any queued heartbeats. */
+    ~WakaTime() override;
     /** Find the full path to a file based on the `PATH` environment variable. Equivalent to
-     * `command -v` or `which`. Does not check if the file is executable.
+     * `command -v` or `which`. Does not check if the file is executable. Results are cached until
+     * one of the directories searched changes.
      *
      * @param binNames The names of the binary to find.
      * @return The full path to the binary if found, otherwise an empty string.
      */
     QString getBinPath(const QStringList &binNames);
     /**
-     * Get the project name by traversing up until `.git` or `.svn` is found.
+     * Get the project name by traversing up until a VCS directory such as `.git` or a
+     * `.wakatime-project` file is found. See ProjectResolver::markers(). Results are cached
+     * per directory until one of the directories involved changes. The first line of a
+     * `.wakatime-project` file in the project root overrides the directory name.
      *
      * @param fileInfo The QFileInfo of the file to get the project directory for.
-     * @return The project directory name if found, otherwise an empty string.
+     * @return The project name if found, otherwise an empty string.
      */
     QString getProjectDirectory(const QFileInfo &fileInfo);
+    /**
+     * Get the current Git branch of the project a file is in. See BranchResolver. The branch is
+     * cached per project and only read again when the repository's `HEAD` file changes. The second
+     * line of a `.wakatime-project` file in the project root takes precedence.
+     *
+     * @param fileInfo The QFileInfo of the file to get the branch for.
+     * @return The branch name if found, otherwise an empty string.
+     */
+    QString getProjectBranch(const QFileInfo &fileInfo);
+    /**
+     * Get the canonical path of a file, resolving symbolic links. Results are cached until
+     * forgetCanonicalPath() is called for @p filePath, so call this when a document is opened to
+     * resolve its path ahead of the first heartbeat.
+     *
+     * @param filePath The file path.
+     * @return The canonical path, or an empty string if the file does not exist.
+     */
+    QString canonicalFilePath(const QString &filePath);
+    /**
+     * Drop the cached canonical path of a file. Call this when a document's URL changes.
+     *
+     * @param filePath The file path as passed to canonicalFilePath().
+     */
+    void forgetCanonicalPath(const QString &filePath);
     /**
      * Send statistics to WakaTime.
      *
@@ -60,10 +121,282 @@ public:
                          int cursorPosition,
                          int linesInFile,
                          bool isWrite);
+    /**
+     * Send statistics to WakaTime without blocking the caller. `wakatime-cli` is started in the
+     * background and this method returns immediately. The result is reported with the
+     * sendFinished() signal. If setMaxProcesses() `wakatime-cli` processes are running, or a
+     * heartbeat for the same file is already queued, the heartbeat is queued as with
+     * queueHeartbeat() instead.
+     *
+     * @param filePath The file path to send statistics for.
+     * @param mode The language mode of the file.
+     * @param lineNumber The line number of the cursor position.
+     * @param cursorPosition The column number of the cursor position.
+     * @param linesInFile The total number of lines in the file.
+     * @param isWrite Whether this is a write event (`true`) or just a heartbeat (`false`).
+     */
+    void sendAsync(const QString &filePath,
+                   const QString &mode,
+                   int lineNumber,
+                   int cursorPosition,
+                   int linesInFile,
+                   bool isWrite);
+
+    /**
+     * Queue statistics to be sent to WakaTime in a batch. Queued heartbeats are sent with a single
+     * `wakatime-cli` invocation once the batch size is reached, once the flush interval elapses, or
+     * immediately for write events. Write events are sent before other heartbeats and are never
+     * dropped. While setMaxProcesses() `wakatime-cli` processes are running heartbeats stay
+     * queued. A heartbeat for a file that already has one queued is coalesced with it, and the
+     * oldest non-write heartbeat is dropped once the queue is full. See setQueueCapacity().
+     * Results are reported with the sendFinished() signal.
+     *
+     * @param filePath The file path to send statistics for.
+     * @param mode The language mode of the file.
+     * @param lineNumber The line number of the cursor position.
+     * @param cursorPosition The column number of the cursor position.
+     * @param linesInFile The total number of lines in the file.
+     * @param isWrite Whether this is a write event (`true`) or just a heartbeat (`false`).
+     */
+    void queueHeartbeat(const QString &filePath,
+                        const QString &mode,
+                        int lineNumber,
+                        int cursorPosition,
+                        int linesInFile,
+                        bool isWrite);
+    /**
+     * Send all queued heartbeats now, as long as not too many `wakatime-cli` processes are running.
+     * Does nothing if the queue is empty.
+     */
+    void flush();
+    /**
+     * Set the number of queued heartbeats that triggers a flush.
+     *
+     * @param size Batch size. Values less than 1 are treated as 1.
+     */
+    void setBatchSize(qsizetype size);
+    /**
+     * Set the maximum number of `wakatime-cli` processes running at once. Further heartbeats wait
+     * in the queue.
+     *
+     * @param count Number of processes. Values less than 1 are treated as 1. Defaults to 2.
+     */
+    void setMaxProcesses(qsizetype count);
+    /**
+     * Set the number of queued heartbeats beyond which the oldest non-write heartbeat is dropped.
+     *
+     * @param capacity Number of heartbeats. Values less than 1 are treated as 1. Defaults to 100.
+     */
+    void setQueueCapacity(qsizetype capacity);
+    /**
+     * Set the maximum time a heartbeat stays queued before it is flushed.
+     *
+     * @param ms Interval in milliseconds.
+     */
+    void setFlushInterval(int ms);
+    /**
+     * Set the minimum time between non-write heartbeats for the same file.
+     *
+     * @param ms Interval in milliseconds. Defaults to 2 minutes.
+     */
+    void setThrottleInterval(qint64 ms);
+    /**
+     * Set how long `wakatime-cli` may run before it is terminated, and killed if it does not exit
+     * shortly after. Heartbeats sent by a stopped process are reported as TimedOut and journalled.
+     *
+     * @param ms Deadline in milliseconds. Defaults to 30 seconds.
+     */
+    void setProcessTimeout(int ms);
+    /**
+     * Replace how heartbeats are delivered. The default runs `wakatime-cli` once per batch (see
+     * BatchedCliTransport), unless another transport is chosen with `KATE_WAKATIME_TRANSPORT`.
+     * Should be called before anything is sent.
+     *
+     * @param transport The transport.
+     */
+    void setTransport(std::unique_ptr<HeartbeatTransport> transport);
+    /**
+     * Get the counters and timings collected since construction or the last resetMetrics().
+     *
+     * @return JSON object with:
+     * - `states`: number of results per WakaTime::State.
+     * - `sendTime`: histogram of time spent in send(), sendAsync() and queueHeartbeat(). This is
+     *   the time the editor is blocked by the plugin. See LatencyHistogram::toJson().
+     * - `processTime`: histogram of `wakatime-cli` run time.
+     * - `queued`, `inFlight` and `journalled`: current number of heartbeats in each state.
+     * - `processes`: number of `wakatime-cli` processes running.
+     * - `queueCapacity` and `maxProcesses`: see setQueueCapacity() and setMaxProcesses().
+     * - `binPathCache`, `canonicalPathCache`, `projectCache` and `branchCache`: `hits`, `misses`
+     *   and `hitRate`.
+     * - `circuitBreaker`: `state` and `consecutiveFailures`.
+     */
+    QJsonObject metrics() const;
+    /** Reset the counters and timings returned by metrics(). */
+    void resetMetrics();
+    /**
+     * Write metrics() periodically. The dump is written to the file set with setMetricsDumpPath(),
+     * or to the `wakatime-metrics` logging category if there is none. Dumping is enabled at start
+     * if that category is enabled or `KATE_WAKATIME_METRICS_FILE` is set.
+     *
+     * @param ms Interval in milliseconds. 0 disables dumping.
+     */
+    void setMetricsDumpInterval(int ms);
+    /**
+     * Set the file metrics are dumped to. The file is replaced with each dump.
+     *
+     * @param path File path. Empty to dump to the logging category.
+     */
+    void setMetricsDumpPath(const QString &path);
+    /** Write metrics() now. See setMetricsDumpInterval(). */
+    void dumpMetrics();
+    /**
+     * Get the coding time recorded locally from every heartbeat accepted for sending, whether or
+     * not it could be sent. Throttled heartbeats, heartbeats for a file still being sent and
+     * heartbeats dropped from a full queue are not counted. The totals are saved to
+     * ActivityTotals::defaultPath() every minute while they change and on exit, added to those
+     * saved by other Kate instances.
+     *
+     * @return The totals.
+     */
+    const ActivityTotals &activityTotals() const;
+    /**
+     * Set the longest gap between heartbeats counted as coding time in activityTotals().
+     *
+     * @param ms Timeout in milliseconds. Defaults to 15 minutes, as used by WakaTime.
+     */
+    void setSessionTimeout(qint64 ms);
+
+Q_SIGNALS:
+    /**
+     * Emitted when a heartbeat passed to sendAsync() or queueHeartbeat() has been handled.
+     *
+     * @param state The result of the send operation.
+     * @param filePath The canonical file path the heartbeat was for.
+     */
+    void sendFinished(WakaTime::State state, const QString &filePath);
+    /** Emitted when a heartbeat has been added to activityTotals(). */
+    void activityTotalsChanged();
 
 private:
-    QDateTime lastTimeSent;
+    /**
+     * Find `wakatime-cli` for the current platform.
+     *
+     * @return The full path, or an empty string if not found.
+     */
+    QString wakatimeCliPath();
+    /**
+     * Create the transport named by `KATE_WAKATIME_TRANSPORT`.
+     *
+     * @param name `batched` or empty for BatchedCliTransport, `cli` for CliTransport, or
+     * `journal:` followed by a file path for JournalTransport. Anything else, or a journal the
+     * transport refuses, falls back to BatchedCliTransport with a warning.
+     * @return The transport.
+     */
+    std::unique_ptr<HeartbeatTransport> createTransport(const QString &name);
+    /**
+     * Checks shared by all send methods. Fills @p heartbeat if it should be sent. If the transport
+     * is unavailable the heartbeat is journalled.
+     *
+     * @return The state to report if nothing should be run, otherwise `std::nullopt`.
+     */
+    std::optional<State> prepare(const QString &filePath,
+                                 const QString &mode,
+                                 int lineNumber,
+                                 int cursorPosition,
+                                 int linesInFile,
+                                 bool isWrite,
+                                 Heartbeat &heartbeat);
+    /** Record a sent or journalled heartbeat for @p canonicalFilePath for throttling. */
+    void markSent(const QString &canonicalFilePath);
+    /** Add a heartbeat that was accepted for sending to the activity totals. */
+    void recordActivity(const Heartbeat &heartbeat);
+    /** Save the activity totals if they have changed, adding to what is already saved. */
+    void saveTotals();
+    /**
+     * Deliver heartbeats with the transport in the background.
+     *
+     * @param heartbeats Heartbeats, at most the transport's maximum batch size.
+     * @param onFinished Called with SentSuccessfully, SentOffline, ErrorSending or TimedOut.
+     */
+    void dispatch(const QList<Heartbeat> &heartbeats, std::function<void(State)> onFinished);
+    /**
+     * Dispatch a batch of new heartbeats and finish them with finishHeartbeats(). The batch is
+     * kept in runningBatches until then, so it can be journalled if Kate exits first.
+     */
+    void dispatchBatch(const QList<Heartbeat> &batch);
+    /** Update the circuit breaker with the result of running `wakatime-cli`. */
+    void recordResult(State state);
+    /** Report @p state for @p heartbeats and journal them if sending failed. */
+    void finishHeartbeats(const QList<Heartbeat> &heartbeats, State state);
+    /**
+     * Queue @p heartbeat and flush if it is due. Heartbeats coalesced away are reported as TooSoon
+     * and heartbeats dropped from a full queue as Dropped.
+     */
+    void schedule(Heartbeat heartbeat);
+    /**
+     * Send up to a batch of queued heartbeats, writes first.
+     *
+     * @return `true` if a batch was dispatched.
+     */
+    bool startBatch();
+    /** Send queued heartbeats that are due now that a process has finished. */
+    void dispatchPending();
+    /** Send journalled heartbeats in bulk if there are any. */
+    void replayJournal();
+    /** Project name for files in @p canonicalDirectory. Empty if not in a project. */
+    QString projectName(const QString &canonicalDirectory);
+    /**
+     * Check if a change in @p directory affects the cached path of binary @p name: the cached
+     * binary is gone from it, or another one appeared in it earlier in the search order.
+     */
+    bool binPathStale(const QString &name, const QString &directory) const;
+    /** Drop cached binary paths, project roots and branches that depend on @p directory. */
+    void invalidateCaches(const QString &directory);
+    /** Count @p state in metrics(). @return @p state. */
+    State counted(State state);
+
     QMap<QString, QString> binPathCache;
-    QString lastFileSent;
-    bool hasSent = false;
+    // Directories searched to find each cached binary.
+    QHash<QString, QStringList> binPathDirectories;
+    CacheWatcher cacheWatcher;
+    ProjectResolver projectResolver;
+    BranchResolver branchResolver;
+    // File path to canonical file path.
+    QHash<QString, QString> canonicalPaths;
+    ThrottleTable throttle;
+    // Files with a queued heartbeat or an asynchronous send still running.
+    QSet<QString> inFlight;
+    HeartbeatScheduler scheduler;
+    QTimer flushTimer;
+    qsizetype batchSize;
+    qsizetype maxProcesses;
+    // A flush was held back because too many processes were running.
+    bool flushDeferred = false;
+    bool shuttingDown = false;
+    // Batches dispatched with dispatchBatch() that have not finished, by ID.
+    QHash<quint64, QList<Heartbeat>> runningBatches;
+    quint64 nextBatchId = 0;
+    // Heartbeats that could not be sent.
+    HeartbeatJournal journal;
+    ActivityTotals totals;
+    // Saves the totals a while after they change, so a crash loses little.
+    QTimer totalsSaveTimer;
+    bool replaying = false;
+    // Stops running wakatime-cli while it keeps failing.
+    CircuitBreaker breaker;
+    // Probes once the breaker's delay has passed.
+    QTimer retryTimer;
+    // Metrics.
+    QMap<State, quint64> stateCounts;
+    LatencyHistogram sendTime;
+    LatencyHistogram processTime;
+    quint64 binPathHits = 0;
+    quint64 binPathMisses = 0;
+    quint64 canonicalPathHits = 0;
+    quint64 canonicalPathMisses = 0;
+    QTimer metricsDumpTimer;
+    QString metricsDumpPath;
+    std::unique_ptr<HeartbeatTransport> transport;
+    // Last so that running processes are stopped before anything their handlers use is destroyed.
+    ProcessRunner processRunner;
 };
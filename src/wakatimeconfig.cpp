@@ -1,12 +1,73 @@
 // SPDX-License-Identifier: MIT
+#include <QtCore/QFileInfo>
+
 #include "wakatimeconfig.h"
 
 Q_LOGGING_CATEGORY(gLogWakaTimeConfig, "wakatime-config")
 
+void WakaTimeConfig::slotFileChanged() {
+    qCDebug(gLogWakaTimeConfig) << "Configuration changed:" << config_->fileName();
+    // Picks up the new contents. QSettings only reads the file again when its time stamp changes.
+    config_->sync();
+    updateSnapshot();
+    watch();
+}
+
+void WakaTimeConfig::slotDirectoryChanged() {
+    if (!QFileInfo::exists(config_->fileName())) {
+        return;
+    }
+    slotFileChanged();
+}
+
+void WakaTimeConfig::refreshDialog() {
+    if (!dialog_) {
+        return;
+    }
+    const auto settings = snapshot();
+    ui_.lineEdit_apiKey->setText(settings->apiKey);
+    ui_.lineEdit_apiUrl->setText(settings->apiUrl);
+    ui_.checkBox_hideFilenames->setChecked(settings->hideFilenames);
+}
+
+void WakaTimeConfig::updateSnapshot() {
+    auto settings = std::make_shared<WakaTimeSettings>();
+    settings->apiKey = config_->value(kSettingsKeyApiKey).toString();
+    settings->apiUrl =
+        config_->value(kSettingsKeyApiUrl, QStringLiteral("https://wakatime.com/api/v1/"))
+            .toString();
+    settings->hideFilenames = config_->value(kSettingsKeyHideFilenames, false).toBool();
+    if (snapshot_ && *snapshot_ == *settings) {
+        return;
+    }
+    const auto initial = !snapshot_;
+    snapshot_ = std::move(settings);
+    if (!initial) {
+        Q_EMIT settingsChanged();
+    }
+}
+
+void WakaTimeConfig::watch() {
+    const auto fileName = config_->fileName();
+    const auto directory = QFileInfo(fileName).absolutePath();
+    // Saving replaces the file, which drops the watch on it, so it is added again each time.
+    const auto path = QFileInfo::exists(fileName) ? fileName : directory;
+    const auto watched = watcher_.files() + watcher_.directories();
+    if (watched.size() == 1 && watched.first() == path) {
+        return;
+    }
+    if (!watched.isEmpty()) {
+        watcher_.removePaths(watched);
+    }
+    if (!watcher_.addPath(path)) {
+        qCDebug(gLogWakaTimeConfig) << "Cannot watch" << path;
+    }
+}
+
 void WakaTimeConfig::configureDialog(QWidget *parent, Qt::WindowFlags flags) {
     if (dialog_) {
-        dialog_->setParent(parent);
-        dialog_->setWindowFlags(flags);
+        // Keep Qt::Dialog, otherwise the dialog would become a child widget of the new parent.
+        dialog_->setParent(parent, dialog_->windowFlags() | flags);
         return;
     }
     dialog_ = new QDialog(parent, flags);
@@ -17,9 +78,7 @@ void WakaTimeConfig::configureDialog(QWidget *parent, Qt::WindowFlags flags) {
     ui_.lineEdit_apiKey->setFocus();
     ui_.lineEdit_apiUrl->setPlaceholderText(i18n("Enter your WakaTime API URL."));
     dialog_->setWindowTitle(i18n("Configure WakaTime"));
-    ui_.lineEdit_apiKey->setText(apiKey());
-    ui_.lineEdit_apiUrl->setText(apiUrl());
-    ui_.checkBox_hideFilenames->setChecked(hideFilenames());
+    refreshDialog();
 };
 
 void WakaTimeConfig::showDialog() {
@@ -27,10 +86,16 @@ void WakaTimeConfig::showDialog() {
         qCWarning(gLogWakaTimeConfig) << "Dialog not configured. Call configureDialog() first.";
         return;
     }
+    // Edits from a dialog that was cancelled are not shown again.
+    refreshDialog();
     if (dialog_->exec() == QDialog::Accepted) {
-        setApiKey(ui_.lineEdit_apiKey->text());
-        setApiUrl(ui_.lineEdit_apiUrl->text());
-        setHideFilenames(ui_.checkBox_hideFilenames->isChecked());
+        // Read first, as each setter refreshes the dialog.
+        const auto key = ui_.lineEdit_apiKey->text();
+        const auto url = ui_.lineEdit_apiUrl->text();
+        const auto hide = ui_.checkBox_hideFilenames->isChecked();
+        setApiKey(key);
+        setApiUrl(url);
+        setHideFilenames(hide);
         save();
     }
 }
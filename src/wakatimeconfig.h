@@ -2,13 +2,17 @@
 #pragma once
 
 #include <QtCore/QDir>
+#include <QtCore/QFileSystemWatcher>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QObject>
+#include <QtCore/QPointer>
 #include <QtCore/QSettings>
 #include <QtWidgets/QDialog>
 
 #include <KLocalizedString>
 
+#include <memory>
+
 #include "ui_configdialog.h"
 
 Q_DECLARE_LOGGING_CATEGORY(gLogWakaTimeConfig)
@@ -17,9 +21,27 @@ const auto kSettingsKeyApiKey = QStringLiteral("settings/api_key");
 const auto kSettingsKeyApiUrl = QStringLiteral("settings/api_url");
 const auto kSettingsKeyHideFilenames = QStringLiteral("settings/hidefilenames");
 
+/**
+ * Settings read from `~/.wakatime.cfg` at one point in time. Never modified once created, so a
+ * snapshot can be kept or handed to another thread without locking.
+ */
+struct WakaTimeSettings {
+    /** API key. */
+    QString apiKey;
+    /** API URL. */
+    QString apiUrl;
+    /** If filenames should be hidden. */
+    bool hideFilenames = false;
+
+    bool operator==(const WakaTimeSettings &) const = default;
+};
+
 /**
  * Basic wrapper around QSettings to use WakaTime settings. Note that the save() method must be
  * called to persist changes.
+ *
+ * The getters read an in-memory snapshot of the file. It is replaced when a setter is called or
+ * when the file is changed on disk, for example by `wakatime-cli` or a text editor.
  */
 class WakaTimeConfig : public QObject {
     Q_OBJECT
@@ -34,6 +56,17 @@ public:
             new QSettings(QDir::homePath() + QDir::separator() + QStringLiteral(".wakatime.cfg"),
                           QSettings::IniFormat,
                           this);
+        connect(&watcher_,
+                &QFileSystemWatcher::fileChanged,
+                this,
+                &WakaTimeConfig::slotFileChanged);
+        connect(&watcher_,
+                &QFileSystemWatcher::directoryChanged,
+                this,
+                &WakaTimeConfig::slotDirectoryChanged);
+        connect(this, &WakaTimeConfig::settingsChanged, this, &WakaTimeConfig::refreshDialog);
+        updateSnapshot();
+        watch();
     };
     ~WakaTimeConfig() override {
         delete config_;
@@ -43,7 +76,7 @@ public:
      * @return The API key.
      */
     QString apiKey() const {
-        return config_->value(kSettingsKeyApiKey).toString();
+        return snapshot_->apiKey;
     };
     /**
      * Set the API key.
@@ -52,6 +85,7 @@ public:
      */
     void setApiKey(const QString &key) {
         config_->setValue(kSettingsKeyApiKey, key);
+        updateSnapshot();
     };
     /**
      * Get the API URL from the configuration.
@@ -59,8 +93,7 @@ public:
      * @return The API URL.
      */
     QString apiUrl() const {
-        return config_->value(kSettingsKeyApiUrl, QStringLiteral("https://wakatime.com/api/v1/"))
-            .toString();
+        return snapshot_->apiUrl;
     };
     /**
      * Set the API URL.
@@ -69,6 +102,7 @@ public:
      */
     void setApiUrl(const QString &url) {
         config_->setValue(kSettingsKeyApiUrl, url);
+        updateSnapshot();
     };
     /**
      * Check if filenames should be hidden.
@@ -76,7 +110,7 @@ public:
      * @return `true` if filenames should be hidden, `false` otherwise.
      */
     bool hideFilenames() const {
-        return config_->value(kSettingsKeyHideFilenames, false).toBool();
+        return snapshot_->hideFilenames;
     };
     /**
      * Set whether filenames should be hidden.
@@ -85,6 +119,15 @@ public:
      */
     void setHideFilenames(bool hide) {
         config_->setValue(kSettingsKeyHideFilenames, hide);
+        updateSnapshot();
+    };
+    /**
+     * Get the current settings. The returned snapshot does not change, later changes replace it.
+     *
+     * @return The settings.
+     */
+    std::shared_ptr<const WakaTimeSettings> snapshot() const {
+        return snapshot_;
     };
     /** Save the configuration settings to disk. */
     void save() const {
@@ -100,8 +143,32 @@ public:
     /** Show configuration dialog. */
     void showDialog();
 
+Q_SIGNALS:
+    /** Emitted when the settings have changed, whether by a setter or on disk. */
+    void settingsChanged();
+
 private:
+    /** Re-read the file after it has changed on disk. */
+    void slotFileChanged();
+    /**
+     * Handle a change in the directory watched while the file does not exist. Anything else
+     * created or removed there is ignored without touching the file.
+     */
+    void slotDirectoryChanged();
+    /** Show the current snapshot in the dialog, if it has been built. */
+    void refreshDialog();
+    /** Replace the snapshot with the current settings. Emits settingsChanged() if different. */
+    void updateSnapshot();
+    /**
+     * Watch the file, or its directory until the file is created. The directory is usually the
+     * home directory, so it is only watched while it has to be.
+     */
+    void watch();
+
     QSettings *config_ = nullptr;
-    QDialog *dialog_ = nullptr;
+    std::shared_ptr<const WakaTimeSettings> snapshot_;
+    QFileSystemWatcher watcher_;
+    // Guarded as the dialog is deleted along with the main window it was last parented to.
+    QPointer<QDialog> dialog_;
     Ui::ConfigureWakaTimeDialog ui_;
 };
@@ -36,21 +36,100 @@ K_PLUGIN_FACTORY_WITH_JSON(WakaTimePluginFactory,
 WakaTimePlugin::WakaTimePlugin(QObject *parent, const QVariantList &args)
     : KTextEditor::Plugin(parent) {
     Q_UNUSED(args);
+    const auto recordPath = qEnvironmentVariable("KATE_WAKATIME_RECORD_FILE");
+    if (!recordPath.isEmpty()) {
+        m_recorder = std::make_unique<SessionRecorder>(recordPath);
+    }
 }
 
 WakaTimePlugin::~WakaTimePlugin() {
 }
 
+WakaTime &WakaTimePlugin::client() {
+    return m_client;
+}
+
+WakaTimeConfig &WakaTimePlugin::config() {
+    return m_config;
+}
+
+SessionRecorder *WakaTimePlugin::recorder() {
+    return m_recorder.get();
+}
+
+void WakaTimePlugin::retainCanonicalPath(const QString &filePath) {
+    if (filePath.isEmpty()) {
+        return;
+    }
+    // Resolve it now rather than on the first keystroke.
+    if (m_pathUsers[filePath]++ == 0) {
+        m_client.canonicalFilePath(filePath);
+    }
+}
+
+void WakaTimePlugin::releaseCanonicalPath(const QString &filePath) {
+    auto it = m_pathUsers.find(filePath);
+    if (it == m_pathUsers.end()) {
+        return;
+    }
+    // The same document may still be open in another main window.
+    if (--*it == 0) {
+        m_pathUsers.erase(it);
+        m_client.forgetCanonicalPath(filePath);
+    }
+}
+
+void WakaTimeView::viewChanged(KTextEditor::View *view) {
+    if (!view) {
+        return;
+    }
+    auto it = documentViews.find(view->document());
+    if (it == documentViews.end()) {
+        return;
+    }
+    // Heartbeats use the cursor of the view last worked in.
+    it->removeOne(view);
+    it->append(view);
+}
+
 void WakaTimeView::viewCreated(KTextEditor::View *view) {
-    connectDocumentSignals(view->document());
+    if (viewDocuments.contains(view)) {
+        return;
+    }
+    auto document = view->document();
+    auto &views = documentViews[document];
+    if (views.isEmpty()) {
+        connectDocumentSignals(document);
+    }
+    views.append(view);
+    viewDocuments.insert(view, document);
+    connect(view, &QObject::destroyed, this, &WakaTimeView::viewDestroyed);
 }
 
 void WakaTimeView::viewDestroyed(QObject *view) {
-    disconnectDocumentSignals(static_cast<KTextEditor::View *>(view)->document());
+    // Only the address can be used here, the view is partly destroyed.
+    auto document = viewDocuments.take(view);
+    auto it = documentViews.find(document);
+    if (it == documentViews.end()) {
+        return;
+    }
+    it->removeIf([view](KTextEditor::View *other) { return other == view; });
+    if (it->isEmpty()) {
+        documentViews.erase(it);
+        disconnectDocumentSignals(document);
+    }
 }
 
-WakaTimeView::WakaTimeView(KTextEditor::MainWindow *mainWindow)
-    : QObject(mainWindow), m_mainWindow(mainWindow) {
+WakaTimeView::WakaTimeView(KTextEditor::MainWindow *mainWindow, WakaTimePlugin *plugin)
+    : QObject(mainWindow), m_mainWindow(mainWindow), m_plugin(plugin), client(plugin->client()),
+      config(plugin->config()),
+      activity(
+          client,
+          [this](QObject *document) {
+              return documentState(static_cast<KTextEditor::Document *>(document));
+          },
+          kTextChangedDelayMs,
+          kTextChangedMaxWaitMs) {
     KXMLGUIClient::setComponentName(QStringLiteral("katewakatime"), i18n("WakaTime"));
     setXMLFile(QStringLiteral("ui.rc"));
     auto a = actionCollection()->addAction(QStringLiteral("configure_wakatime"));
@@ -58,45 +137,52 @@ WakaTimeView::WakaTimeView(KTextEditor::MainWindow *mainWindow)
     a->setIcon(QIcon::fromTheme(QStringLiteral("wakatime")));
     connect(a, &QAction::triggered, this, &WakaTimeView::slotConfigureWakaTime);
     mainWindow->guiFactory()->addClient(this);
-    config.configureDialog(m_mainWindow->window());
     // Connections
     connect(m_mainWindow, &KTextEditor::MainWindow::viewCreated, this, &WakaTimeView::viewCreated);
+    connect(m_mainWindow, &KTextEditor::MainWindow::viewChanged, this, &WakaTimeView::viewChanged);
+    activity.setRecorder(plugin->recorder());
     for (const auto &view : m_mainWindow->views()) {
-        connectDocumentSignals(view->document());
+        viewCreated(view);
     }
+    viewChanged(m_mainWindow->activeView());
 }
 
 WakaTimeView::~WakaTimeView() {
     m_mainWindow->guiFactory()->removeClient(this);
+    // Kate deletes plugin views before the views of a closing main window, so viewDestroyed()
+    // is not called for them.
+    for (auto it = documentPaths.cbegin(); it != documentPaths.cend(); ++it) {
+        activity.cancel(it.key());
+        m_plugin->releaseCanonicalPath(it.value());
+    }
 }
 
 QObject *WakaTimePlugin::createView(KTextEditor::MainWindow *mainWindow) {
-    return new WakaTimeView(mainWindow);
+    return new WakaTimeView(mainWindow, this);
 }
 
 void WakaTimeView::slotConfigureWakaTime() {
+    // The dialog is built the first time it is requested. It is shared, so show it over the window
+    // it was requested from.
+    config.configureDialog(m_mainWindow->window());
     config.showDialog();
 }
 
-void WakaTimeView::sendAction(KTextEditor::Document *doc, bool isWrite) {
-    // The view is necessary here to get the cursor position and line count.
-    for (const auto &view : m_mainWindow->views()) {
-        if (view->document() == doc) {
-            client.send(doc->url().toLocalFile(),
-                        doc->mode(),
-                        view->cursorPosition().line() + 1,
-                        view->cursorPosition().column() + 1,
-                        view->document()->lines(),
-                        isWrite);
-            break;
-        }
+std::optional<DocumentState> WakaTimeView::documentState(KTextEditor::Document *doc) const {
+    // The view is necessary here to get the cursor position.
+    const auto it = documentViews.constFind(doc);
+    if (it == documentViews.cend() || it->isEmpty()) {
+        return std::nullopt;
     }
+    const auto cursor = it->last()->cursorPosition();
+    return DocumentState{documentPaths.value(doc),
+                         doc->mode(),
+                         cursor.line() + 1,
+                         cursor.column() + 1,
+                         doc->lines()};
 }
 
 void WakaTimeView::connectDocumentSignals(KTextEditor::Document *document) {
-    if (connectedDocuments.contains(document)) {
-        return;
-    }
     // When document goes from saved state to changed state (not yet saved on disk).
     connect(document,
             &KTextEditor::Document::modifiedChanged,
@@ -109,31 +195,46 @@ void WakaTimeView::connectDocumentSignals(KTextEditor::Document *document) {
             &WakaTimeView::slotDocumentWrittenToDisk);
     // Text changes (might be heavy).
     // This event unfortunately is emitted twice in separate threads for every key stroke (maybe key
-    // up and down is the reason).
+    // up and down is the reason). It is debounced so a burst of typing results in one heartbeat.
     connect(document,
             &KTextEditor::Document::textChanged,
             this,
-            &WakaTimeView::slotDocumentModifiedChanged);
-    connectedDocuments << document;
+            &WakaTimeView::slotDocumentTextChanged);
+    // Renamed or saved under a new name.
+    connect(document,
+            &KTextEditor::Document::documentUrlChanged,
+            this,
+            &WakaTimeView::slotDocumentUrlChanged);
+    slotDocumentUrlChanged(document);
 }
 
 void WakaTimeView::disconnectDocumentSignals(KTextEditor::Document *document) {
-    if (!connectedDocuments.contains(document)) {
-        return;
-    }
     disconnect(document, &KTextEditor::Document::modifiedChanged, this, nullptr);
     disconnect(document, &KTextEditor::Document::documentSavedOrUploaded, this, nullptr);
     disconnect(document, &KTextEditor::Document::textChanged, this, nullptr);
-    connectedDocuments.removeOne(document);
+    disconnect(document, &KTextEditor::Document::documentUrlChanged, this, nullptr);
+    activity.cancel(document);
+    m_plugin->releaseCanonicalPath(documentPaths.take(document));
 }
 
 // Slots
 void WakaTimeView::slotDocumentModifiedChanged(KTextEditor::Document *doc) {
-    sendAction(doc, false);
+    activity.handle(doc, EditorEvent::ModifiedChanged);
+}
+
+void WakaTimeView::slotDocumentTextChanged(KTextEditor::Document *doc) {
+    activity.handle(doc, EditorEvent::TextChanged);
+}
+
+void WakaTimeView::slotDocumentUrlChanged(KTextEditor::Document *doc) {
+    m_plugin->releaseCanonicalPath(documentPaths.value(doc));
+    const auto filePath = doc->url().toLocalFile();
+    documentPaths.insert(doc, filePath);
+    m_plugin->retainCanonicalPath(filePath);
 }
 
 void WakaTimeView::slotDocumentWrittenToDisk(KTextEditor::Document *doc) {
-    sendAction(doc, true);
+    activity.handle(doc, EditorEvent::Saved);
 }
 
 #include "wakatimeplugin.moc"
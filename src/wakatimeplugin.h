@@ -5,9 +5,15 @@
 #include <KTextEditor/View>
 
 #include <QtCore/QDateTime>
+#include <QtCore/QHash>
 #include <QtCore/QLoggingCategory>
 #include <QtCore/QSettings>
 
+#include <memory>
+#include <optional>
+
+#include "editoractivity.h"
+#include "sessionrecorder.h"
 #include "wakatime.h"
 #include "wakatimeconfig.h"
 
@@ -19,46 +25,105 @@ class MainWindow;
 class View;
 } // namespace KTextEditor
 
-class WakaTimeView;
-
-/** Plugin for initialisation by KTextEditor. */
+/**
+ * Plugin for initialisation by KTextEditor. Owns the client and configuration shared by the views
+ * of every main window, so there is one heartbeat queue, one throttle state and one set of caches
+ * per process.
+ */
 class WakaTimePlugin : public KTextEditor::Plugin {
+#ifdef TESTING
+    friend class WakaTimePluginTest;
+#endif
+
 public:
     /** Constructor. */
     explicit WakaTimePlugin(QObject *parent = nullptr, const QList<QVariant> & = QList<QVariant>());
     /** Destructor. */
     virtual ~WakaTimePlugin();
     QObject *createView(KTextEditor::MainWindow *mainWindow) override;
+    /**
+     * Get the shared client.
+     *
+     * @return The client.
+     */
+    WakaTime &client();
+    /**
+     * Get the shared configuration.
+     *
+     * @return The configuration.
+     */
+    WakaTimeConfig &config();
+    /**
+     * Get the recorder for document events. Recording is enabled by setting
+     * `KATE_WAKATIME_RECORD_FILE` to the file to write.
+     *
+     * @return The recorder, or `nullptr` if not recording.
+     */
+    SessionRecorder *recorder();
+    /**
+     * Resolve the canonical path of a document that was opened or renamed, and keep it cached by
+     * the client until every view that retained it has released it.
+     *
+     * @param filePath Local file path of the document. Ignored if empty.
+     */
+    void retainCanonicalPath(const QString &filePath);
+    /**
+     * Release a path retained with retainCanonicalPath(). The client forgets its canonical path
+     * once no view of any main window retains it.
+     *
+     * @param filePath Local file path of the document. Ignored if empty.
+     */
+    void releaseCanonicalPath(const QString &filePath);
 
 private:
-    QList<WakaTimeView *> m_views;
+    WakaTime m_client;
+    // Number of connected documents in all main windows with each local file path.
+    QHash<QString, int> m_pathUsers;
+    WakaTimeConfig m_config;
+    std::unique_ptr<SessionRecorder> m_recorder;
 };
 
 /** The plugin view. */
 class WakaTimeView : public QObject, public KXMLGUIClient {
     Q_OBJECT
+#ifdef TESTING
+    friend class WakaTimePluginTest;
+#endif
 
 public:
     /** Constructor. */
-    WakaTimeView(KTextEditor::MainWindow *);
+    WakaTimeView(KTextEditor::MainWindow *, WakaTimePlugin *);
     ~WakaTimeView() override;
 
 private Q_SLOTS:
     void slotConfigureWakaTime();
     void slotDocumentModifiedChanged(KTextEditor::Document *);
+    void slotDocumentTextChanged(KTextEditor::Document *);
+    void slotDocumentUrlChanged(KTextEditor::Document *);
     void slotDocumentWrittenToDisk(KTextEditor::Document *);
+    void viewChanged(KTextEditor::View *);
     void viewCreated(KTextEditor::View *);
     void viewDestroyed(QObject *);
 
 private:
     void connectDocumentSignals(KTextEditor::Document *);
     void disconnectDocumentSignals(KTextEditor::Document *);
-    void sendAction(KTextEditor::Document *, bool);
+    std::optional<DocumentState> documentState(KTextEditor::Document *) const;
 
 private:
     KTextEditor::MainWindow *m_mainWindow;
-    WakaTime client;
-    WakaTimeConfig config;
-    // Initialised in constructor definition.
-    QList<KTextEditor::Document *> connectedDocuments;
+    WakaTimePlugin *m_plugin;
+    // Shared with the views of other main windows. Owned by WakaTimePlugin.
+    WakaTime &client;
+    WakaTimeConfig &config;
+    // Sends heartbeats for document signals.
+    EditorActivity activity;
+    // Views of each document in this main window, the active one last. A document's signals are
+    // connected while it has a view here.
+    QHash<KTextEditor::Document *, QList<KTextEditor::View *>> documentViews;
+    // Document of each view, as a view cannot be asked once it is being destroyed.
+    QHash<QObject *, KTextEditor::Document *> viewDocuments;
+    // Local file path of each connected document, retained with the plugin while the document is
+    // connected.
+    QHash<KTextEditor::Document *, QString> documentPaths;
 };